@@ -0,0 +1,145 @@
+// Controlo de admissão
+
+// no fim de cada intervalo o event loop lê o menor tempo de espera na fila:
+// se ficou acima do alvo durante todo o intervalo há fila permanente e entra
+// no estado de descarte do CoDel (descartes cada vez mais próximos, interval/sqrt(n))
+// fila cheia rejeita sempre; p99 acima do limite com trabalho em fila também descarta
+// o histograma de cada intervalo fechado entra numa janela circular; o p99 é tirado
+// da janela inteira, e só com amostras suficientes
+
+#include <string.h>
+#include "admission.h"
+
+// Integer square root (for the CoDel control law)
+static unsigned isqrt(unsigned n) {
+    unsigned root = 0;
+    while ((root + 1) * (root + 1) <= n) root++;
+    return root;
+}
+
+// Start a new measurement interval
+static void admission_reset_interval(admission_t *adm, uint64_t now_ms) {
+    __atomic_store_n(&adm->min_sojourn_us, UINT64_MAX, __ATOMIC_RELAXED);
+    __atomic_store_n(&adm->dequeued, 0, __ATOMIC_RELAXED);
+    for (int i = 0; i < ADMISSION_LATENCY_BUCKETS; i++) {
+        __atomic_store_n(&adm->latency[i], 0, __ATOMIC_RELAXED);
+    }
+    adm->interval_end_ms = now_ms + ADMISSION_INTERVAL_MS;
+}
+
+// Move the interval's histogram into the window, after empty_before intervals without samples
+static void admission_close_window(admission_t *adm, uint64_t empty_before) {
+    for (uint64_t i = 0; i < empty_before && i < ADMISSION_WINDOW_INTERVALS; i++) {
+        memset(adm->window[adm->window_next], 0, sizeof(adm->window[0]));
+        adm->window_next = (adm->window_next + 1) % ADMISSION_WINDOW_INTERVALS;
+    }
+    for (int i = 0; i < ADMISSION_LATENCY_BUCKETS; i++) {
+        adm->window[adm->window_next][i] = __atomic_load_n(&adm->latency[i], __ATOMIC_RELAXED);
+    }
+    adm->window_next = (adm->window_next + 1) % ADMISSION_WINDOW_INTERVALS;
+}
+
+// p99 of the window's histograms (upper bound of the bucket holding it), 0 with too few samples
+static unsigned admission_p99(admission_t *adm) {
+    uint64_t counts[ADMISSION_LATENCY_BUCKETS] = {0};
+    uint64_t total = 0;
+    for (int w = 0; w < ADMISSION_WINDOW_INTERVALS; w++) {
+        for (int i = 0; i < ADMISSION_LATENCY_BUCKETS; i++) {
+            counts[i] += adm->window[w][i];
+            total += adm->window[w][i];
+        }
+    }
+    if (total < ADMISSION_MIN_SAMPLES) return 0;
+
+    uint64_t rank = total - total / 100;
+    uint64_t seen = 0;
+    for (int i = 0; i < ADMISSION_LATENCY_BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= rank) return 1u << i;
+    }
+    return 1u << (ADMISSION_LATENCY_BUCKETS - 1);
+}
+
+// Close the interval: was there a standing queue the whole time?
+static void admission_end_interval(admission_t *adm, int queue_depth, uint64_t now_ms) {
+    uint64_t min_sojourn = __atomic_load_n(&adm->min_sojourn_us, __ATOMIC_RELAXED);
+    uint32_t dequeued = __atomic_load_n(&adm->dequeued, __ATOMIC_RELAXED);
+
+    if (dequeued == 0) {
+        // Nothing left the queue: stuck if work is waiting, idle otherwise
+        adm->overloaded = queue_depth > 0;
+    } else {
+        adm->overloaded = min_sojourn > (uint64_t)ADMISSION_TARGET_MS * 1000;
+    }
+    admission_close_window(adm, (now_ms - adm->interval_end_ms) / ADMISSION_INTERVAL_MS);
+    adm->p99_ms = admission_p99(adm);
+
+    if (!adm->overloaded) {
+        adm->dropping = 0;
+        adm->drop_count = 0;
+    }
+    admission_reset_interval(adm, now_ms);
+}
+
+// Initialize the controller
+void admission_init(admission_t *adm, int queue_limit, uint64_t now_ms) {
+    adm->queue_limit = queue_limit;
+    adm->overloaded = 0;
+    adm->dropping = 0;
+    adm->drop_count = 0;
+    adm->drop_next_ms = 0;
+    memset(adm->window, 0, sizeof(adm->window));
+    adm->window_next = 0;
+    adm->p99_ms = 0;
+    adm->shed = 0;
+    admission_reset_interval(adm, now_ms);
+}
+
+// Record how long a connection waited in the queue (lock-free minimum)
+void admission_record_sojourn(admission_t *adm, uint64_t sojourn_us) {
+    __atomic_fetch_add(&adm->dequeued, 1, __ATOMIC_RELAXED);
+    uint64_t current = __atomic_load_n(&adm->min_sojourn_us, __ATOMIC_RELAXED);
+    while (sojourn_us < current &&
+           !__atomic_compare_exchange_n(&adm->min_sojourn_us, &current, sojourn_us, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+// Record the service time of a request
+void admission_record_latency(admission_t *adm, long elapsed_ms) {
+    int bucket = 0;
+    while (bucket < ADMISSION_LATENCY_BUCKETS - 1 && (1L << bucket) < elapsed_ms) bucket++;
+    __atomic_fetch_add(&adm->latency[bucket], 1, __ATOMIC_RELAXED);
+}
+
+// Close the interval if it is over
+void admission_tick(admission_t *adm, int queue_depth, uint64_t now_ms) {
+    if (now_ms >= adm->interval_end_ms) admission_end_interval(adm, queue_depth, now_ms);
+}
+
+// Decide whether to reject a request about to be queued
+int admission_should_shed(admission_t *adm, int queue_depth, uint64_t now_ms) {
+    admission_tick(adm, queue_depth, now_ms);
+
+    int shed = 0;
+    if (queue_depth >= adm->queue_limit) {
+        // No room at all
+        shed = 1;
+    } else if (adm->overloaded ||
+               (adm->p99_ms > ADMISSION_LATENCY_LIMIT_MS && queue_depth > 0)) {
+        if (!adm->dropping) {
+            adm->dropping = 1;
+            adm->drop_count = 1;
+            adm->drop_next_ms = now_ms + ADMISSION_INTERVAL_MS;
+            shed = 1;
+        } else if (now_ms >= adm->drop_next_ms) {
+            // CoDel control law: drop faster while the queue stays above target
+            adm->drop_count++;
+            adm->drop_next_ms = now_ms + ADMISSION_INTERVAL_MS / isqrt(adm->drop_count);
+            shed = 1;
+        }
+    }
+
+    if (shed) adm->shed++;
+    return shed;
+}
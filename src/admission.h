@@ -0,0 +1,73 @@
+// Interface controlo de admissão
+
+// decide no event loop se um pedido entra na fila ou é rejeitado com 503
+// usa o tempo de espera na fila (estilo CoDel), a profundidade da fila
+// e o p99 recente do tempo de serviço (espera na fila até ao header da resposta,
+// sem a transferência), numa janela de vários intervalos com um mínimo de amostras;
+// as threads só fazem operações atómicas
+
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <stdint.h>
+
+// CoDel parameters: acceptable standing queue delay and the window it is measured over
+#define ADMISSION_TARGET_MS 5
+#define ADMISSION_INTERVAL_MS 100
+
+// Recent p99 service time above which requests are shed while work is queued
+#define ADMISSION_LATENCY_LIMIT_MS 1000
+
+// The p99 covers the last ADMISSION_WINDOW_INTERVALS intervals and needs at least
+// ADMISSION_MIN_SAMPLES requests in them (fewer would make it the maximum)
+#define ADMISSION_WINDOW_INTERVALS 10
+#define ADMISSION_MIN_SAMPLES 100
+
+// Seconds sent in Retry-After with the 503
+#define ADMISSION_RETRY_AFTER 1
+
+// log2(ms) service time buckets for the p99 estimate
+#define ADMISSION_LATENCY_BUCKETS 16
+
+// Admission controller of one worker. The counters are updated by the serving
+// threads with atomics, the rest is owned by the event loop thread.
+typedef struct {
+    // Written by the serving threads
+    uint64_t min_sojourn_us;        // Smallest queue wait seen this interval
+    uint32_t dequeued;              // Connections popped this interval
+    uint32_t latency[ADMISSION_LATENCY_BUCKETS];  // Service time histogram this interval
+
+    // Event loop only
+    int queue_limit;                // Queue depth that always sheds
+    uint64_t interval_end_ms;       // End of the current measurement interval
+    int overloaded;                 // Last interval stayed above target
+    int dropping;                   // CoDel dropping state
+    unsigned drop_count;            // Drops since entering the dropping state
+    uint64_t drop_next_ms;          // Time of the next drop while dropping
+    uint32_t window[ADMISSION_WINDOW_INTERVALS][ADMISSION_LATENCY_BUCKETS];  // Closed intervals
+    unsigned window_next;           // Slot the next closed interval goes to
+    unsigned p99_ms;                // Service time p99 over the window (0 = too few samples)
+    unsigned long shed;             // Requests rejected so far
+} admission_t;
+
+
+//ADMISSION API
+// Initialize the controller; queue_limit is the connection queue capacity
+void admission_init(admission_t *adm, int queue_limit, uint64_t now_ms);
+
+// Record how long a connection waited in the queue (serving threads)
+void admission_record_sojourn(admission_t *adm, uint64_t sojourn_us);
+
+// Record the service time of a request (serving threads): its queue wait plus the
+// time to the response header
+void admission_record_latency(admission_t *adm, long elapsed_ms);
+
+// Close the measurement intervals that ended by now_ms (event loop housekeeping,
+// so they advance while nothing is dispatched)
+void admission_tick(admission_t *adm, int queue_depth, uint64_t now_ms);
+
+// Decide whether to reject a request about to be queued (event loop).
+// Returns 1 to shed it, 0 to admit it.
+int admission_should_shed(admission_t *adm, int queue_depth, uint64_t now_ms);
+
+#endif
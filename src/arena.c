@@ -0,0 +1,147 @@
+// Arena de memória por pedido
+
+// cada arena tem um bloco inicial pré-alocado; alocações avançam um ponteiro
+// se o bloco encher é criado um bloco extra, libertado no próximo reset
+// o pool guarda arenas livres numa lista ligada (sem malloc/free por pedido)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+// Round size up to the allocation alignment
+static size_t align_up(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+// Allocate a block with size usable bytes
+static arena_block_t* block_create(size_t size) {
+    arena_block_t *block = malloc(sizeof(arena_block_t) + size);
+    if (!block) return NULL;
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+// Create an arena whose first block holds size bytes
+arena_t* arena_create(size_t size) {
+    arena_t *arena = malloc(sizeof(arena_t));
+    if (!arena) return NULL;
+
+    arena->first = block_create(size ? size : ARENA_DEFAULT_SIZE);
+    if (!arena->first) {
+        free(arena);
+        return NULL;
+    }
+    arena->current = arena->first;
+    arena->next_free = NULL;
+    return arena;
+}
+
+// Free the arena and all its blocks
+void arena_destroy(arena_t *arena) {
+    if (!arena) return;
+    arena_reset(arena);
+    free(arena->first);
+    free(arena);
+}
+
+// Allocate size bytes (aligned)
+void* arena_alloc(arena_t *arena, size_t size) {
+    if (!arena) return NULL;
+    size = align_up(size ? size : 1);
+
+    arena_block_t *block = arena->current;
+    if (block->size - block->used < size) {
+        // Overflow block: at least as large as the first one
+        size_t block_size = size > arena->first->size ? size : arena->first->size;
+        block = block_create(block_size);
+        if (!block) return NULL;
+        block->next = arena->current;
+        arena->current = block;
+    }
+
+    void *ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+// Copy the first n bytes of a string into the arena
+char* arena_strndup(arena_t *arena, const char *str, size_t n) {
+    if (!str) return NULL;
+    char *copy = arena_alloc(arena, n + 1);
+    if (!copy) return NULL;
+    memcpy(copy, str, n);
+    copy[n] = '\0';
+    return copy;
+}
+
+// Copy a string into the arena
+char* arena_strdup(arena_t *arena, const char *str) {
+    if (!str) return NULL;
+    return arena_strndup(arena, str, strlen(str));
+}
+
+// Release every allocation, keeping only the first block
+void arena_reset(arena_t *arena) {
+    if (!arena) return;
+
+    arena_block_t *block = arena->current;
+    while (block != arena->first) {
+        arena_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->first->used = 0;
+    arena->current = arena->first;
+}
+
+// Create a pool with count arenas of arena_size bytes
+arena_pool_t* arena_pool_create(int count, size_t arena_size) {
+    arena_pool_t *pool = malloc(sizeof(arena_pool_t));
+    if (!pool) {
+        perror("Failed to allocate arena pool");
+        return NULL;
+    }
+    pool->free_list = NULL;
+    pool->arena_size = arena_size ? arena_size : ARENA_DEFAULT_SIZE;
+
+    for (int i = 0; i < count; i++) {
+        arena_t *arena = arena_create(pool->arena_size);
+        if (!arena) break;
+        arena->next_free = pool->free_list;
+        pool->free_list = arena;
+    }
+    return pool;
+}
+
+// Free the pool and every arena in it
+void arena_pool_destroy(arena_pool_t *pool) {
+    if (!pool) return;
+    arena_t *arena = pool->free_list;
+    while (arena) {
+        arena_t *next = arena->next_free;
+        arena_destroy(arena);
+        arena = next;
+    }
+    free(pool);
+}
+
+// Take an arena from the pool
+arena_t* arena_pool_get(arena_pool_t *pool) {
+    if (!pool) return NULL;
+    arena_t *arena = pool->free_list;
+    if (!arena) return arena_create(pool->arena_size);
+    pool->free_list = arena->next_free;
+    arena->next_free = NULL;
+    return arena;
+}
+
+// Reset an arena and give it back to the pool
+void arena_pool_put(arena_pool_t *pool, arena_t *arena) {
+    if (!pool || !arena) return;
+    arena_reset(arena);
+    arena->next_free = pool->free_list;
+    pool->free_list = arena;
+}
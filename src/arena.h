@@ -0,0 +1,71 @@
+// Interface arena
+
+// alocador "bump" para objetos que vivem apenas durante um pedido
+// (pedido HTTP analisado, cabeçalhos de resposta, ...)
+// tudo é libertado de uma vez com arena_reset; cada thread tem o seu pool de arenas
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Default capacity of the first block of an arena
+#define ARENA_DEFAULT_SIZE (16 * 1024)
+
+// Alignment of every allocation
+#define ARENA_ALIGNMENT 16
+
+// Memory block owned by an arena (the first one is kept across resets)
+typedef struct arena_block {
+    struct arena_block *next;   // Previous (older) block
+    size_t size;                // Usable bytes in data
+    size_t used;                // Bytes handed out
+    _Alignas(ARENA_ALIGNMENT) char data[];   // Block storage
+} arena_block_t;
+
+// Bump allocator, released as a whole with arena_reset
+typedef struct arena {
+    arena_block_t *current;     // Block allocations come from
+    arena_block_t *first;       // Preallocated block kept across resets
+    struct arena *next_free;    // Link in the owning pool's free list
+} arena_t;
+
+// Free list of preallocated arenas (one pool per thread, no locking)
+typedef struct {
+    arena_t *free_list;         // Arenas ready to be used
+    size_t arena_size;          // Size of arenas created on demand
+} arena_pool_t;
+
+
+//ARENA API
+// Create an arena whose first block holds size bytes
+arena_t* arena_create(size_t size);
+
+// Free the arena and all its blocks
+void arena_destroy(arena_t *arena);
+
+// Allocate size bytes (aligned), grows with overflow blocks when needed
+void* arena_alloc(arena_t *arena, size_t size);
+
+// Copy a string (or its first n bytes) into the arena
+char* arena_strdup(arena_t *arena, const char *str);
+char* arena_strndup(arena_t *arena, const char *str, size_t n);
+
+// Release every allocation, keeping only the first block
+void arena_reset(arena_t *arena);
+
+
+//ARENA POOL API
+// Create a pool with count arenas of arena_size bytes
+arena_pool_t* arena_pool_create(int count, size_t arena_size);
+
+// Free the pool and every arena in it
+void arena_pool_destroy(arena_pool_t *pool);
+
+// Take an arena from the pool (creates one if the pool is empty)
+arena_t* arena_pool_get(arena_pool_t *pool);
+
+// Reset an arena and give it back to the pool
+void arena_pool_put(arena_pool_t *pool, arena_t *arena);
+
+#endif
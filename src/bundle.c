@@ -0,0 +1,443 @@
+// Bundle estático
+
+// bundle_build percorre a raiz de documentos e escreve um ficheiro com:
+//   cabeçalho | índice ordenado por (hash, caminho) | corpos alinhados | caminhos e cabeçalhos
+// os corpos com uma página ou mais começam numa fronteira de página (sendfile direto da page cache)
+// "x.gz" ao lado de "x" é guardado também como variante gzip de "x"
+// bundle_open faz mmap do ficheiro e valida todos os offsets uma vez, os pedidos
+// fazem só uma pesquisa binária no índice
+
+#define _GNU_SOURCE
+#include "bundle.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "http.h"
+
+// Copy buffer used while packing
+#define BUNDLE_COPY_CHUNK (64 * 1024)
+
+// A file found while walking the tree
+typedef struct {
+    char *path;             // Canonical request path
+    char *source;           // Filesystem path
+    uint64_t size;
+    uint32_t hash;
+    uint64_t body_offset;   // Where its bytes went in the bundle
+    char etag[20];
+    const char *gzip_path;  // Path of "path.gz" while pairing
+    int gzip;               // Index of "path.gz" in the final order, -1 if none
+} build_file_t;
+
+typedef struct {
+    build_file_t *files;
+    int count;
+    int capacity;
+} build_list_t;
+
+static uint64_t align_up(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Add a regular file to the list
+static int build_list_add(build_list_t *list, const char *path, const char *source, uint64_t size) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 64;
+        build_file_t *files = realloc(list->files, capacity * sizeof(build_file_t));
+        if (!files) return -1;
+        list->files = files;
+        list->capacity = capacity;
+    }
+    build_file_t *file = &list->files[list->count];
+    memset(file, 0, sizeof(*file));
+    file->path = strdup(path);
+    file->source = strdup(source);
+    if (!file->path || !file->source) {
+        free(file->path);
+        free(file->source);
+        return -1;
+    }
+    file->size = size;
+    file->hash = http_path_hash(path);
+    file->gzip = -1;
+    list->count++;
+    return 0;
+}
+
+static void build_list_free(build_list_t *list) {
+    for (int i = 0; i < list->count; i++) {
+        free(list->files[i].path);
+        free(list->files[i].source);
+    }
+    free(list->files);
+}
+
+// Walk source recursively, path is the request path of source ("" for the root).
+// Symbolic links are skipped, so the bundle never reaches outside the tree.
+static int collect_files(build_list_t *list, const char *source, const char *path) {
+    DIR *dir = opendir(source);
+    if (!dir) {
+        perror(source);
+        return -1;
+    }
+
+    int ret = 0;
+    struct dirent *entry;
+    while (ret == 0 && (entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+
+        char child_source[MAX_PATH_LENGTH * 2];
+        char child_path[MAX_PATH_LENGTH];
+        if (snprintf(child_source, sizeof(child_source), "%s/%s", source, entry->d_name) >= (int)sizeof(child_source) ||
+            snprintf(child_path, sizeof(child_path), "%s/%s", path, entry->d_name) >= (int)sizeof(child_path)) {
+            fprintf(stderr, "Bundle: path too long, skipped: %s/%s\n", source, entry->d_name);
+            continue;
+        }
+
+        struct stat st;
+        if (lstat(child_source, &st) != 0) {
+            perror(child_source);
+            ret = -1;
+        } else if (S_ISDIR(st.st_mode)) {
+            ret = collect_files(list, child_source, child_path);
+        } else if (S_ISREG(st.st_mode)) {
+            ret = build_list_add(list, child_path, child_source, st.st_size);
+        }
+    }
+
+    closedir(dir);
+    return ret;
+}
+
+static int compare_by_path(const void *a, const void *b) {
+    return strcmp(((const build_file_t *)a)->path, ((const build_file_t *)b)->path);
+}
+
+// Index order: hash first, path to break ties
+static int compare_by_hash(const void *a, const void *b) {
+    const build_file_t *x = a, *y = b;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    return strcmp(x->path, y->path);
+}
+
+// Write all of buf at offset
+static int write_at(int fd, const void *buf, size_t len, uint64_t offset) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= n;
+        offset += n;
+    }
+    return 0;
+}
+
+// Copy a file into the bundle at its body offset and derive its ETag from the content
+static int copy_body(int out_fd, build_file_t *file, char *buffer) {
+    int in_fd = open(file->source, O_RDONLY | O_CLOEXEC);
+    if (in_fd < 0) {
+        perror(file->source);
+        return -1;
+    }
+
+    uint64_t hash = 0xcbf29ce484222325ULL;  // FNV-1a 64
+    uint64_t copied = 0;
+    int ret = 0;
+    while (ret == 0) {
+        ssize_t n = read(in_fd, buffer, BUNDLE_COPY_CHUNK);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            perror(file->source);
+            ret = -1;
+        } else if (n == 0) {
+            break;
+        } else if (copied + n > file->size ||
+                   write_at(out_fd, buffer, n, file->body_offset + copied) != 0) {
+            ret = -1;
+        } else {
+            for (ssize_t i = 0; i < n; i++) hash = (hash ^ (unsigned char)buffer[i]) * 0x100000001b3ULL;
+            copied += n;
+        }
+    }
+    close(in_fd);
+
+    if (ret == 0 && copied != file->size) ret = -1;
+    if (ret != 0) {
+        fprintf(stderr, "Bundle: %s changed while packing\n", file->source);
+        return -1;
+    }
+    snprintf(file->etag, sizeof(file->etag), "\"%016llx\"", (unsigned long long)hash);
+    return 0;
+}
+
+// Precomputed entity headers of one variant, returns the length or -1
+static int format_headers(char *buf, const build_file_t *file, const char *type, int encoded, int vary) {
+    int len = snprintf(buf, BUNDLE_MAX_HEADERS,
+                       "Content-Type: %s\r\n"
+                       "Content-Length: %llu\r\n"
+                       "ETag: %s\r\n"
+                       "%s%s\r\n",
+                       type, (unsigned long long)file->size, file->etag,
+                       encoded ? "Content-Encoding: gzip\r\n" : "",
+                       vary ? "Vary: Accept-Encoding\r\n" : "");
+    return len < BUNDLE_MAX_HEADERS ? len : -1;
+}
+
+// Lay out and write the bundle into fd
+static int write_bundle(int fd, build_list_t *list, const server_config_t *config) {
+    char *buffer = malloc(BUNDLE_COPY_CHUNK);
+    bundle_entry_t *entries = calloc(list->count ? list->count : 1, sizeof(bundle_entry_t));
+    int ret = -1;
+    if (!buffer || !entries) goto out;
+
+    // Bodies after the index, each file copied once (a .gz file is both an entry
+    // of its own and the variant of its original)
+    uint64_t index_offset = align_up(sizeof(bundle_header_t), BUNDLE_ALIGN);
+    uint64_t pos = index_offset + (uint64_t)list->count * sizeof(bundle_entry_t);
+    for (int i = 0; i < list->count; i++) {
+        build_file_t *file = &list->files[i];
+        pos = align_up(pos, file->size >= BUNDLE_PAGE_SIZE ? BUNDLE_PAGE_SIZE : BUNDLE_ALIGN);
+        file->body_offset = pos;
+        if (copy_body(fd, file, buffer) != 0) goto out;
+        pos += file->size;
+    }
+
+    // Paths and header blocks follow the bodies
+    for (int i = 0; i < list->count; i++) {
+        build_file_t *file = &list->files[i];
+        bundle_entry_t *entry = &entries[i];
+        entry->hash = file->hash;
+        entry->path_len = strlen(file->path);
+        entry->path_offset = pos;
+        if (write_at(fd, file->path, entry->path_len + 1, pos) != 0) goto out;
+        pos += entry->path_len + 1;
+
+        const char *type = config ? config_get_mime_type(config, file->path) : NULL;
+        if (!type) type = http_get_mime_type(file->path);
+
+        for (int e = 0; e < BUNDLE_ENCODINGS; e++) {
+            const build_file_t *source = e == BUNDLE_GZIP ? NULL : file;
+            if (e == BUNDLE_GZIP && file->gzip >= 0) source = &list->files[file->gzip];
+            if (!source) continue;
+
+            char headers[BUNDLE_MAX_HEADERS];
+            int len = format_headers(headers, source, type, e == BUNDLE_GZIP, file->gzip >= 0);
+            if (len < 0 || write_at(fd, headers, len, pos) != 0) goto out;
+
+            bundle_variant_t *variant = &entry->variants[e];
+            variant->body_offset = source->body_offset;
+            variant->body_size = source->size;
+            variant->headers_offset = pos;
+            variant->headers_len = len;
+            memcpy(variant->etag, source->etag, sizeof(variant->etag));
+            pos += len;
+        }
+    }
+
+    bundle_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BUNDLE_MAGIC, sizeof(header.magic));
+    header.version = BUNDLE_VERSION;
+    header.num_entries = list->count;
+    header.index_offset = index_offset;
+    header.file_size = pos;
+    if (write_at(fd, entries, (size_t)list->count * sizeof(bundle_entry_t), index_offset) != 0 ||
+        write_at(fd, &header, sizeof(header), 0) != 0 ||
+        ftruncate(fd, pos) != 0) {
+        goto out;
+    }
+    ret = 0;
+
+out:
+    free(entries);
+    free(buffer);
+    return ret;
+}
+
+// Pack dir into output
+int bundle_build(const char *dir, const char *output, const server_config_t *config) {
+    if (!dir || !output) return -1;
+
+    build_list_t list = { NULL, 0, 0 };
+    if (collect_files(&list, dir, "") != 0) {
+        build_list_free(&list);
+        return -1;
+    }
+
+    // Pair "x.gz" with "x" while sorted by path, then put the list in index order
+    // and turn the pairs into indices
+    qsort(list.files, list.count, sizeof(build_file_t), compare_by_path);
+    for (int i = 0; i < list.count; i++) {
+        size_t len = strlen(list.files[i].path);
+        if (len <= 3 || strcmp(list.files[i].path + len - 3, ".gz") != 0) continue;
+        build_file_t key = { .path = strndup(list.files[i].path, len - 3) };
+        if (!key.path) continue;
+        build_file_t *original = bsearch(&key, list.files, list.count, sizeof(build_file_t), compare_by_path);
+        if (original) original->gzip_path = list.files[i].path;
+        free(key.path);
+    }
+    qsort(list.files, list.count, sizeof(build_file_t), compare_by_hash);
+    for (int i = 0; i < list.count; i++) {
+        if (!list.files[i].gzip_path) continue;
+        build_file_t key = { .path = (char *)list.files[i].gzip_path,
+                             .hash = http_path_hash(list.files[i].gzip_path) };
+        build_file_t *gzip = bsearch(&key, list.files, list.count, sizeof(build_file_t), compare_by_hash);
+        list.files[i].gzip = gzip ? (int)(gzip - list.files) : -1;
+    }
+
+    char tmp[MAX_PATH_LENGTH + 32];
+    snprintf(tmp, sizeof(tmp), "%s.tmp.%d", output, getpid());
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        perror(tmp);
+        build_list_free(&list);
+        return -1;
+    }
+
+    int ret = write_bundle(fd, &list, config);
+    if (ret == 0 && fsync(fd) != 0) ret = -1;
+    if (close(fd) != 0) ret = -1;
+    if (ret == 0 && rename(tmp, output) != 0) {
+        perror(output);
+        ret = -1;
+    }
+    if (ret != 0) {
+        fprintf(stderr, "Bundle: failed to write %s\n", output);
+        unlink(tmp);
+    }
+
+    int count = list.count;
+    build_list_free(&list);
+    return ret == 0 ? count : -1;
+}
+
+// Whether path starts with the bundle magic
+int bundle_is_bundle(const char *path) {
+    char magic[sizeof(((bundle_header_t *)0)->magic)];
+    int fd = path ? open(path, O_RDONLY | O_CLOEXEC) : -1;
+    if (fd < 0) return 0;
+    ssize_t n = read(fd, magic, sizeof(magic));
+    close(fd);
+    return n == (ssize_t)sizeof(magic) && memcmp(magic, BUNDLE_MAGIC, sizeof(magic)) == 0;
+}
+
+// Whether [offset, offset + len) lies inside a mapping of size bytes
+static int in_bounds(uint64_t offset, uint64_t len, size_t size) {
+    return offset <= size && len <= size - offset;
+}
+
+// Check every offset of the index once so lookups can trust it
+static int validate_bundle(const bundle_t *bundle) {
+    const bundle_header_t *header = (const bundle_header_t *)bundle->map;
+    if (memcmp(header->magic, BUNDLE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != BUNDLE_VERSION || header->file_size != bundle->size ||
+        header->index_offset % _Alignof(bundle_entry_t) != 0 ||
+        !in_bounds(header->index_offset, (uint64_t)header->num_entries * sizeof(bundle_entry_t), bundle->size)) {
+        return -1;
+    }
+
+    const bundle_entry_t *entries = (const bundle_entry_t *)(bundle->map + header->index_offset);
+    for (uint32_t i = 0; i < header->num_entries; i++) {
+        const bundle_entry_t *entry = &entries[i];
+        if (!in_bounds(entry->path_offset, (uint64_t)entry->path_len + 1, bundle->size) ||
+            bundle->map[entry->path_offset + entry->path_len] != '\0' ||
+            entry->variants[BUNDLE_IDENTITY].headers_len == 0) {
+            return -1;
+        }
+        for (int e = 0; e < BUNDLE_ENCODINGS; e++) {
+            const bundle_variant_t *variant = &entry->variants[e];
+            if (variant->headers_len == 0) continue;
+            if (!in_bounds(variant->headers_offset, variant->headers_len, bundle->size) ||
+                !in_bounds(variant->body_offset, variant->body_size, bundle->size) ||
+                memchr(variant->etag, '\0', sizeof(variant->etag)) == NULL) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Map a bundle read-only
+bundle_t* bundle_open(const char *path) {
+    if (!path) return NULL;
+    bundle_t *bundle = calloc(1, sizeof(bundle_t));
+    if (!bundle) return NULL;
+
+    bundle->fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (bundle->fd < 0 || fstat(bundle->fd, &st) != 0 || (size_t)st.st_size < sizeof(bundle_header_t)) {
+        fprintf(stderr, "Bundle: cannot open %s\n", path);
+        goto fail;
+    }
+
+    // Shared file mapping: every worker maps the same page cache pages
+    bundle->size = st.st_size;
+    void *map = mmap(NULL, bundle->size, PROT_READ, MAP_SHARED, bundle->fd, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        goto fail;
+    }
+    bundle->map = map;
+
+    if (validate_bundle(bundle) != 0) {
+        fprintf(stderr, "Bundle: %s is not a valid version %d bundle\n", path, BUNDLE_VERSION);
+        goto fail;
+    }
+    const bundle_header_t *header = (const bundle_header_t *)bundle->map;
+    bundle->entries = (const bundle_entry_t *)(bundle->map + header->index_offset);
+    bundle->num_entries = header->num_entries;
+
+    // The index is touched on every request, fault it in now
+    madvise((void *)bundle->map, header->index_offset + (size_t)bundle->num_entries * sizeof(bundle_entry_t),
+            MADV_WILLNEED);
+    return bundle;
+
+fail:
+    bundle_close(bundle);
+    return NULL;
+}
+
+// Unmap and close
+void bundle_close(bundle_t *bundle) {
+    if (!bundle) return;
+    if (bundle->map) munmap((void *)bundle->map, bundle->size);
+    if (bundle->fd >= 0) close(bundle->fd);
+    free(bundle);
+}
+
+// Binary search for the first entry with this hash, then compare paths
+const bundle_entry_t* bundle_lookup(const bundle_t *bundle, const char *path, uint32_t hash) {
+    if (!bundle || !path) return NULL;
+    uint32_t low = 0, high = bundle->num_entries;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (bundle->entries[mid].hash < hash) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    for (uint32_t i = low; i < bundle->num_entries && bundle->entries[i].hash == hash; i++) {
+        const bundle_entry_t *entry = &bundle->entries[i];
+        if (strcmp((const char *)bundle->map + entry->path_offset, path) == 0) return entry;
+    }
+    return NULL;
+}
+
+// Whether an entry has a representation in this encoding
+int bundle_has_variant(const bundle_entry_t *entry, bundle_encoding_t encoding) {
+    return entry && encoding < BUNDLE_ENCODINGS && entry->variants[encoding].headers_len > 0;
+}
+
+// Pointer into the mapping
+const void* bundle_data(const bundle_t *bundle, uint64_t offset) {
+    return bundle->map + offset;
+}
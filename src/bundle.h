@@ -0,0 +1,93 @@
+// Interface bundle estático
+
+// empacota uma árvore de documentos imutável num único ficheiro só de leitura
+// o ficheiro tem um índice ordenado por hash do caminho, os cabeçalhos de cada
+// resposta já calculados (MIME, Content-Length, ETag) e variantes gzip opcionais
+// o servidor faz mmap do ficheiro: os workers partilham a page cache e servem
+// sem open/stat por pedido
+
+#ifndef BUNDLE_H
+#define BUNDLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+
+#define BUNDLE_MAGIC "HTTPBNDL"
+#define BUNDLE_VERSION 1
+
+// Bodies start on BUNDLE_ALIGN boundaries, bodies of a page or more on page boundaries
+#define BUNDLE_ALIGN 64
+#define BUNDLE_PAGE_SIZE 4096
+
+// Longest precomputed header block of one variant
+#define BUNDLE_MAX_HEADERS 512
+
+// Encodings stored per path ("x.gz" next to "x" becomes its gzip variant)
+typedef enum {
+    BUNDLE_IDENTITY,
+    BUNDLE_GZIP,
+    BUNDLE_ENCODINGS
+} bundle_encoding_t;
+
+// File header at offset 0
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_entries;
+    uint64_t index_offset;      // bundle_entry_t[num_entries], sorted by (hash, path)
+    uint64_t file_size;
+} bundle_header_t;
+
+// One stored representation of a path
+typedef struct {
+    uint64_t body_offset;
+    uint64_t body_size;
+    uint64_t headers_offset;    // Content-Type ... up to and including the blank line
+    uint32_t headers_len;       // 0 = variant absent
+    char etag[20];              // Quoted strong ETag, NUL-terminated
+} bundle_variant_t;
+
+// Index entry
+typedef struct {
+    uint32_t hash;              // http_path_hash of the path
+    uint32_t path_len;
+    uint64_t path_offset;       // Canonical path, NUL-terminated
+    bundle_variant_t variants[BUNDLE_ENCODINGS];
+} bundle_entry_t;
+
+// Bundle mapped for serving (read-only, shared by every thread)
+typedef struct {
+    int fd;                     // Kept open for sendfile of large bodies
+    const uint8_t *map;
+    size_t size;
+    const bundle_entry_t *entries;
+    uint32_t num_entries;
+} bundle_t;
+
+
+//BUNDLE API
+// Pack every regular file below dir into output (written to a temporary file and
+// renamed, so running servers keep their mapping). MIME overrides come from config
+// (may be NULL). Returns the number of paths stored or -1.
+int bundle_build(const char *dir, const char *output, const server_config_t *config);
+
+// Whether path names a bundle file (checks the magic)
+int bundle_is_bundle(const char *path);
+
+// Map a bundle and validate its index, returns NULL on error
+bundle_t* bundle_open(const char *path);
+
+// Unmap and close
+void bundle_close(bundle_t *bundle);
+
+// Entry for a canonical path with its http_path_hash, NULL if absent
+const bundle_entry_t* bundle_lookup(const bundle_t *bundle, const char *path, uint32_t hash);
+
+// Whether an entry has a stored representation in this encoding
+int bundle_has_variant(const bundle_entry_t *entry, bundle_encoding_t encoding);
+
+// Pointer into the mapping at offset (offsets of a validated entry are in bounds)
+const void* bundle_data(const bundle_t *bundle, uint64_t offset);
+
+#endif
@@ -0,0 +1,34 @@
+// Empacotador de bundles (ponto de entrada)
+
+// empacota uma raiz de documentos num bundle que o servidor serve com mmap:
+//   ./bundle <diretoria> <ficheiro> [config]
+// o ficheiro de configuração opcional fornece os MIME_TYPE extra
+// aponte DOCUMENT_ROOT (global ou de um [vhost]) para o ficheiro gerado
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "config.h"
+#include "bundle.h"
+
+int main(int argc, char *argv[]) {
+    if (argc < 3 || argc > 4) {
+        fprintf(stderr, "Usage: %s <directory> <output> [config file]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    server_config_t *config = NULL;
+    if (argc == 4) {
+        config = config_create(argv[3]);
+        if (!config) {
+            fprintf(stderr, "Failed to load configuration from %s\n", argv[3]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    int count = bundle_build(argv[1], argv[2], config);
+    config_destroy(config);
+    if (count < 0) return EXIT_FAILURE;
+
+    printf("Packed %d files from %s into %s\n", count, argv[1], argv[2]);
+    return EXIT_SUCCESS;
+}
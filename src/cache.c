@@ -1 +1,637 @@
-// Cache LRU de ficheiros
\ No newline at end of file
+// Cache LRU de ficheiros
+
+// tabela de hash com listas encadeadas + listas LRU por região, tudo sob um mutex
+// LRU: uma só lista com a capacidade toda, sai sempre a entrada mais antiga
+// W-TinyLFU: uma entrada nova entra na janela (1%); quem sai da janela passa a
+// candidato no probation e só fica se o sketch lhe der mais acessos que à vítima
+// (a entrada mais antiga do probation), senão sai o candidato
+// um acerto no probation promove a entrada ao protected (80% da região principal);
+// o excesso do protected volta ao probation
+// cargas em curso ficam numa pequena tabela de voos: quem falha no mesmo caminho
+// espera na variável de condição do cache até a entrada ser inserida
+// cada classe de tamanho é uma partição com as suas regiões: uma entrada só
+// disputa lugar com entradas da mesma classe; a classe grande sai também pelo número
+// de entradas, já que cada uma prende um descritor aberto
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "cache.h"
+#include "stats.h"
+
+// Odd multipliers giving each sketch row its own index for the same hash
+static const uint32_t sketch_seeds[CACHE_SKETCH_ROWS] = {
+    0x9E3779B1u, 0x85EBCA77u, 0xC2B2AE3Du, 0x27D4EB2Fu
+};
+
+// Take the mutex, timing the wait when another thread holds it
+static void cache_lock(cache_t *cache) {
+    if (pthread_mutex_trylock(&cache->lock) == 0) return;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_mutex_lock(&cache->lock);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    cache->lock_waits++;
+    cache->lock_wait_ns += (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec;
+}
+
+// Smallest power of two >= n, clamped to the table limits
+static uint32_t cache_slots(size_t capacity) {
+    size_t wanted = capacity / CACHE_OBJECT_SIZE_ESTIMATE;
+    uint32_t slots = CACHE_MIN_SLOTS;
+    while (slots < wanted && slots < CACHE_MAX_SLOTS) slots <<= 1;
+    return slots;
+}
+
+// Counter of a hash in one sketch row
+static uint8_t* sketch_counter(cache_sketch_t *sketch, int row, uint32_t hash) {
+    uint32_t x = hash * sketch_seeds[row];
+    x ^= x >> 15;
+    return &sketch->counters[(size_t)row * sketch->width + (x & (sketch->width - 1))];
+}
+
+// Halve every counter: popularity decays so a formerly hot file can be replaced
+static void sketch_age(cache_sketch_t *sketch) {
+    size_t total = (size_t)CACHE_SKETCH_ROWS * sketch->width;
+    for (size_t i = 0; i < total; i++) sketch->counters[i] >>= 1;
+    sketch->additions /= 2;
+}
+
+// Count one access of hash
+static void sketch_increment(cache_sketch_t *sketch, uint32_t hash) {
+    if (!sketch->counters) return;
+    for (int row = 0; row < CACHE_SKETCH_ROWS; row++) {
+        uint8_t *counter = sketch_counter(sketch, row, hash);
+        if (*counter < CACHE_SKETCH_MAX_COUNT) (*counter)++;
+    }
+    if (++sketch->additions >= sketch->sample_size) sketch_age(sketch);
+}
+
+// Estimated accesses of hash (smallest of its counters)
+static unsigned sketch_estimate(cache_sketch_t *sketch, uint32_t hash) {
+    if (!sketch->counters) return 0;
+    unsigned estimate = CACHE_SKETCH_MAX_COUNT;
+    for (int row = 0; row < CACHE_SKETCH_ROWS; row++) {
+        uint8_t counter = *sketch_counter(sketch, row, hash);
+        if (counter < estimate) estimate = counter;
+    }
+    return estimate;
+}
+
+// Split the capacity between the classes, and each class between the regions of the policy
+static void cache_set_limits(cache_t *cache) {
+    size_t large = cache->capacity / 100 * cache->large_percent +
+                   cache->capacity % 100 * cache->large_percent / 100;
+    cache->parts[CACHE_LARGE].capacity = large;
+    cache->parts[CACHE_SMALL].capacity = cache->capacity - large;
+
+    for (cache_class_t size_class = CACHE_SMALL; size_class < CACHE_CLASSES; size_class++) {
+        cache_partition_t *part = &cache->parts[size_class];
+        if (cache->policy == CACHE_POLICY_LRU) {
+            part->limit[CACHE_WINDOW] = part->capacity;
+            part->limit[CACHE_PROBATION] = 0;
+            part->limit[CACHE_PROTECTED] = 0;
+            continue;
+        }
+        size_t window = part->capacity * CACHE_WINDOW_PERCENT / 100;
+        size_t main = part->capacity - window;
+        part->limit[CACHE_WINDOW] = window;
+        part->limit[CACHE_PROTECTED] = main * CACHE_PROTECTED_PERCENT / 100;
+        part->limit[CACHE_PROBATION] = main - part->limit[CACHE_PROTECTED];
+    }
+}
+
+// Bytes held by probation and protected together
+static size_t main_bytes(const cache_partition_t *part) {
+    return part->lists[CACHE_PROBATION].bytes + part->lists[CACHE_PROTECTED].bytes;
+}
+
+// Budget of probation and protected together
+static size_t main_limit(const cache_partition_t *part) {
+    return part->limit[CACHE_PROBATION] + part->limit[CACHE_PROTECTED];
+}
+
+// Partition of an entry
+static cache_partition_t* entry_part(cache_t *cache, const cache_entry_t *entry) {
+    return &cache->parts[entry->size_class];
+}
+
+// Add the entry at the head (most recent) of a region of its class
+static void list_push(cache_t *cache, cache_entry_t *entry, cache_region_t region) {
+    cache_list_t *list = &entry_part(cache, entry)->lists[region];
+    entry->region = region;
+    entry->prev = NULL;
+    entry->next = list->head;
+    if (list->head) list->head->prev = entry;
+    list->head = entry;
+    if (!list->tail) list->tail = entry;
+    list->bytes += entry->size;
+    entry_part(cache, entry)->count++;
+}
+
+// Take the entry out of its region
+static void list_unlink(cache_t *cache, cache_entry_t *entry) {
+    cache_list_t *list = &entry_part(cache, entry)->lists[entry->region];
+    if (entry->prev) entry->prev->next = entry->next;
+    else list->head = entry->next;
+    if (entry->next) entry->next->prev = entry->prev;
+    else list->tail = entry->prev;
+    list->bytes -= entry->size;
+    entry_part(cache, entry)->count--;
+    entry->prev = entry->next = NULL;
+}
+
+// Move the entry to the head of a region
+static void list_move(cache_t *cache, cache_entry_t *entry, cache_region_t region) {
+    list_unlink(cache, entry);
+    list_push(cache, entry, region);
+}
+
+// Bucket slot holding entry in its chain
+static cache_entry_t** bucket_slot(cache_t *cache, cache_entry_t *entry) {
+    cache_entry_t **slot = &cache->buckets[entry->hash & (cache->num_buckets - 1)];
+    while (*slot && *slot != entry) slot = &(*slot)->hash_next;
+    return slot;
+}
+
+// Find the entry for path
+static cache_entry_t* cache_find(cache_t *cache, const char *path, uint32_t hash) {
+    cache_entry_t *entry = cache->buckets[hash & (cache->num_buckets - 1)];
+    while (entry && (entry->hash != hash || strcmp(entry->path, path) != 0)) entry = entry->hash_next;
+    return entry;
+}
+
+// Take the entry out of the table and its region, dropping the table's reference
+static void cache_unlink(cache_t *cache, cache_entry_t *entry) {
+    cache_entry_t **slot = bucket_slot(cache, entry);
+    if (*slot) *slot = entry->hash_next;
+    entry->hash_next = NULL;
+    list_unlink(cache, entry);
+    entry->linked = 0;
+    cache->entries--;
+    cache_release(entry);
+}
+
+// Drop an entry to make room (rejected = TinyLFU refused it as a candidate)
+static void cache_evict(cache_t *cache, cache_entry_t *entry, int rejected) {
+    if (rejected) {
+        cache->rejections++;
+    } else {
+        cache->evictions++;
+    }
+    stats_record_cache_eviction(cache->policy, rejected);
+    cache_unlink(cache, entry);
+}
+
+// Oldest main region entry of a class other than the candidate (probation first)
+static cache_entry_t* main_victim(cache_partition_t *part, cache_entry_t *candidate) {
+    for (cache_region_t region = CACHE_PROBATION; region <= CACHE_PROTECTED; region++) {
+        for (cache_entry_t *entry = part->lists[region].tail; entry; entry = entry->prev) {
+            if (entry != candidate) return entry;
+        }
+    }
+    return NULL;
+}
+
+// TinyLFU admission: the candidate that left the window stays only while it is
+// more popular than each victim evicted to make room for it
+static void cache_admit(cache_t *cache, cache_partition_t *part, cache_entry_t *candidate) {
+    list_move(cache, candidate, CACHE_PROBATION);
+    unsigned candidate_freq = sketch_estimate(&cache->sketch, candidate->hash);
+    while (main_bytes(part) > main_limit(part)) {
+        cache_entry_t *victim = main_victim(part, candidate);
+        if (!victim || sketch_estimate(&cache->sketch, victim->hash) >= candidate_freq) {
+            cache_evict(cache, candidate, 1);
+            return;
+        }
+        cache_evict(cache, victim, 0);
+    }
+}
+
+// Bring every region of a class back within its budget
+static void cache_balance(cache_t *cache, cache_partition_t *part) {
+    while (part->lists[CACHE_WINDOW].bytes > part->limit[CACHE_WINDOW]) {
+        cache_entry_t *oldest = part->lists[CACHE_WINDOW].tail;
+        if (cache->policy == CACHE_POLICY_LRU) {
+            cache_evict(cache, oldest, 0);
+        } else {
+            cache_admit(cache, part, oldest);
+        }
+    }
+
+    // Protected overflow goes back to probation for another chance
+    while (part->lists[CACHE_PROTECTED].bytes > part->limit[CACHE_PROTECTED]) {
+        list_move(cache, part->lists[CACHE_PROTECTED].tail, CACHE_PROBATION);
+    }
+
+    // The capacity shrank
+    while (main_bytes(part) > main_limit(part)) {
+        cache_evict(cache, main_victim(part, NULL), 0);
+    }
+
+    // Too many open descriptors: the main region's oldest go first, the window last
+    while (part == &cache->parts[CACHE_LARGE] && cache->max_files > 0 && part->count > cache->max_files) {
+        cache_entry_t *victim = main_victim(part, NULL);
+        cache_evict(cache, victim ? victim : part->lists[CACHE_WINDOW].tail, 0);
+    }
+}
+
+// Largest body a class takes
+static size_t class_max_object(const cache_t *cache, cache_class_t size_class) {
+    size_t max = cache->parts[size_class].capacity / CACHE_MAX_OBJECT_FRACTION;
+    if (size_class == CACHE_SMALL && max > CACHE_INLINE_MAX) max = CACHE_INLINE_MAX;
+    return max;
+}
+
+// Create a cache of capacity bytes
+cache_t* cache_create(size_t capacity, int large_percent, cache_policy_t policy) {
+    if (capacity == 0 || large_percent < 0 || large_percent > 100) return NULL;
+
+    cache_t *cache = calloc(1, sizeof(cache_t));
+    if (!cache) {
+        perror("Failed to allocate cache");
+        return NULL;
+    }
+    cache->policy = policy;
+    cache->capacity = capacity;
+    cache->large_percent = large_percent;
+    cache->num_buckets = cache_slots(capacity);
+    cache->buckets = calloc(cache->num_buckets, sizeof(cache_entry_t *));
+    if (policy == CACHE_POLICY_TINYLFU) {
+        cache->sketch.width = cache->num_buckets;
+        cache->sketch.sample_size = CACHE_SKETCH_SAMPLE_FACTOR * cache->sketch.width;
+        cache->sketch.counters = calloc((size_t)CACHE_SKETCH_ROWS * cache->sketch.width, 1);
+    }
+    if (!cache->buckets || (policy == CACHE_POLICY_TINYLFU && !cache->sketch.counters)) {
+        perror("Failed to allocate cache table");
+        free(cache->buckets);
+        free(cache->sketch.counters);
+        free(cache);
+        return NULL;
+    }
+    cache_set_limits(cache);
+    pthread_mutex_init(&cache->lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cache->flight_done, &attr);
+    pthread_condattr_destroy(&attr);
+    return cache;
+}
+
+// Unlink every entry of both classes
+static void cache_unlink_all(cache_t *cache) {
+    for (cache_class_t size_class = CACHE_SMALL; size_class < CACHE_CLASSES; size_class++) {
+        cache_partition_t *part = &cache->parts[size_class];
+        for (cache_region_t region = CACHE_WINDOW; region < CACHE_REGIONS; region++) {
+            while (part->lists[region].head) cache_unlink(cache, part->lists[region].head);
+        }
+    }
+}
+
+// Free the cache
+void cache_destroy(cache_t *cache) {
+    if (!cache) return;
+    cache_unlink_all(cache);
+    pthread_mutex_destroy(&cache->lock);
+    pthread_cond_destroy(&cache->flight_done);
+    free(cache->buckets);
+    free(cache->sketch.counters);
+    free(cache);
+}
+
+// Drop every entry (MIME table reload: the stored headers name the old types)
+void cache_clear(cache_t *cache) {
+    if (!cache) return;
+    cache_lock(cache);
+    cache_unlink_all(cache);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// Size the table (and the sketch) for a larger capacity, rehashing the entries.
+// The sketch starts over at its new width. On allocation failure the old ones stay.
+static void cache_grow_table(cache_t *cache, uint32_t num_buckets) {
+    cache_entry_t **buckets = calloc(num_buckets, sizeof(cache_entry_t *));
+    uint8_t *counters = cache->policy == CACHE_POLICY_TINYLFU ?
+                        calloc((size_t)CACHE_SKETCH_ROWS * num_buckets, 1) : NULL;
+    if (!buckets || (cache->policy == CACHE_POLICY_TINYLFU && !counters)) {
+        free(buckets);
+        free(counters);
+        return;
+    }
+
+    for (uint32_t i = 0; i < cache->num_buckets; i++) {
+        cache_entry_t *entry = cache->buckets[i];
+        while (entry) {
+            cache_entry_t *next = entry->hash_next;
+            cache_entry_t **bucket = &buckets[entry->hash & (num_buckets - 1)];
+            entry->hash_next = *bucket;
+            *bucket = entry;
+            entry = next;
+        }
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->num_buckets = num_buckets;
+
+    if (counters) {
+        free(cache->sketch.counters);
+        cache->sketch.counters = counters;
+        cache->sketch.width = num_buckets;
+        cache->sketch.additions = 0;
+        cache->sketch.sample_size = CACHE_SKETCH_SAMPLE_FACTOR * num_buckets;
+    }
+}
+
+// Change the capacity and class shares (CACHE_SIZE_MB / CACHE_LARGE_SHARE reload)
+void cache_set_capacity(cache_t *cache, size_t capacity, int large_percent) {
+    if (!cache || large_percent < 0 || large_percent > 100) return;
+    cache_lock(cache);
+    if (cache_slots(capacity) > cache->num_buckets) cache_grow_table(cache, cache_slots(capacity));
+    cache->capacity = capacity;
+    cache->large_percent = large_percent;
+    cache_set_limits(cache);
+    for (cache_class_t size_class = CACHE_SMALL; size_class < CACHE_CLASSES; size_class++) {
+        cache_partition_t *part = &cache->parts[size_class];
+
+        // Entries over the new object limit of their class go first
+        for (cache_region_t region = CACHE_WINDOW; region < CACHE_REGIONS; region++) {
+            cache_entry_t *entry = part->lists[region].head;
+            while (entry) {
+                cache_entry_t *next = entry->next;
+                if (entry->size > class_max_object(cache, size_class)) cache_evict(cache, entry, 0);
+                entry = next;
+            }
+        }
+        cache_balance(cache, part);
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// Limit the open descriptors of the large class
+void cache_set_max_files(cache_t *cache, unsigned long max_files) {
+    if (!cache) return;
+    cache_lock(cache);
+    cache->max_files = max_files;
+    cache_balance(cache, &cache->parts[CACHE_LARGE]);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// Small files are inlined while the small class has room for them, the rest keep their file open
+int cache_size_class(cache_t *cache, size_t size) {
+    if (!cache) return -1;
+    cache_lock(cache);
+    int size_class = -1;
+    if (size <= class_max_object(cache, CACHE_SMALL)) {
+        size_class = CACHE_SMALL;
+    } else if (size <= class_max_object(cache, CACHE_LARGE)) {
+        size_class = CACHE_LARGE;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return size_class;
+}
+
+// Find path, record the access and refresh its position
+cache_entry_t* cache_lookup(cache_t *cache, const char *path, uint32_t hash) {
+    if (!cache || !path) return NULL;
+
+    cache_lock(cache);
+    sketch_increment(&cache->sketch, hash);
+    cache_entry_t *entry = cache_find(cache, path, hash);
+    if (entry) {
+        cache->hits++;
+        __atomic_fetch_add(&entry->refs, 1, __ATOMIC_RELAXED);
+        if (entry->region == CACHE_PROBATION) {
+            // Second hit while on probation: promote, demoting protected's oldest if full
+            list_move(cache, entry, CACHE_PROTECTED);
+            cache_balance(cache, entry_part(cache, entry));
+        } else {
+            list_move(cache, entry, entry->region);
+        }
+    } else {
+        cache->misses++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    stats_record_cache_lookup(cache->policy, entry != NULL);
+    return entry;
+}
+
+// Allocate an unlinked entry: headers, inline body (small class) and path in one block
+cache_entry_t* cache_entry_create(const char *path, uint32_t hash, const char *headers,
+                                  size_t headers_len, size_t size, int fd) {
+    if (!path || (!headers && headers_len > 0)) return NULL;
+    size_t path_len = strlen(path);
+    size_t inline_size = fd < 0 ? size : 0;
+    cache_entry_t *entry = malloc(sizeof(cache_entry_t) + headers_len + inline_size + path_len + 1);
+    if (!entry) return NULL;
+
+    memset(entry, 0, sizeof(cache_entry_t));
+    entry->hash = hash;
+    entry->size_class = fd < 0 ? CACHE_SMALL : CACHE_LARGE;
+    entry->refs = 1;
+    entry->fd = fd;
+    entry->headers_len = headers_len;
+    entry->size = size;
+    if (headers_len > 0) memcpy(entry->data, headers, headers_len);
+    entry->body = fd < 0 ? entry->data + headers_len : NULL;
+    entry->path = entry->data + headers_len + inline_size;
+    memcpy(entry->path, path, path_len + 1);
+    return entry;
+}
+
+// Load in progress for a path (finished ones no longer match)
+static cache_flight_t* flight_find(cache_t *cache, const char *path, uint32_t hash) {
+    for (int i = 0; i < CACHE_MAX_FLIGHTS; i++) {
+        cache_flight_t *flight = &cache->flights[i];
+        if (flight->users > 0 && !flight->done && flight->hash == hash && strcmp(flight->path, path) == 0) {
+            return flight;
+        }
+    }
+    return NULL;
+}
+
+// Mark a flight finished with its entry (or NULL) and wake its waiters
+static void flight_finish(cache_t *cache, cache_flight_t *flight, cache_entry_t *entry) {
+    if (entry) __atomic_fetch_add(&entry->refs, 1, __ATOMIC_RELAXED);
+    flight->entry = entry;
+    flight->done = 1;
+    flight->path = NULL;
+    pthread_cond_broadcast(&cache->flight_done);
+}
+
+// One user leaves the flight, the last one frees the slot
+static void flight_leave(cache_flight_t *flight) {
+    if (--flight->users > 0) return;
+    cache_release(flight->entry);
+    memset(flight, 0, sizeof(cache_flight_t));
+}
+
+// Join the load in progress or become the loader
+cache_entry_t* cache_begin_load(cache_t *cache, const char *path, uint32_t hash, cache_flight_t **flight) {
+    *flight = NULL;
+    if (!cache || !path) return NULL;
+
+    cache_lock(cache);
+    cache_entry_t *entry = cache_find(cache, path, hash);
+    if (entry) {
+        __atomic_fetch_add(&entry->refs, 1, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&cache->lock);
+        return entry;
+    }
+
+    cache_flight_t *loading = flight_find(cache, path, hash);
+    if (!loading) {
+        // Become the loader (without a free slot, load uncoordinated)
+        for (int i = 0; i < CACHE_MAX_FLIGHTS; i++) {
+            if (cache->flights[i].users == 0) {
+                cache->flights[i].path = path;
+                cache->flights[i].hash = hash;
+                cache->flights[i].users = 1;
+                *flight = &cache->flights[i];
+                break;
+            }
+        }
+        pthread_mutex_unlock(&cache->lock);
+        return NULL;
+    }
+
+    loading->users++;
+    cache->coalesced++;
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_nsec += (long)CACHE_FLIGHT_WAIT_MS * 1000000;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000;
+    deadline.tv_nsec %= 1000000000;
+    while (!loading->done) {
+        if (pthread_cond_timedwait(&cache->flight_done, &cache->lock, &deadline) != 0) break;
+    }
+    entry = loading->done ? loading->entry : NULL;
+    if (entry) __atomic_fetch_add(&entry->refs, 1, __ATOMIC_RELAXED);
+    flight_leave(loading);
+    pthread_mutex_unlock(&cache->lock);
+    return entry;
+}
+
+// The loader is done, inserted or not
+void cache_end_load(cache_t *cache, cache_flight_t **flight) {
+    if (!cache || !flight || !*flight) return;
+    cache_lock(cache);
+    if (!(*flight)->done) flight_finish(cache, *flight, NULL);
+    flight_leave(*flight);
+    pthread_mutex_unlock(&cache->lock);
+    *flight = NULL;
+}
+
+// Link the entry as the newest in the window and rebalance (which may evict it)
+void cache_insert(cache_t *cache, cache_entry_t *entry) {
+    if (!cache || !entry || entry->linked) return;
+
+    cache_lock(cache);
+    if (entry->size > class_max_object(cache, entry->size_class)) {
+        pthread_mutex_unlock(&cache->lock);
+        return;
+    }
+    cache_entry_t *old = cache_find(cache, entry->path, entry->hash);
+    if (old) cache_unlink(cache, old);
+
+    __atomic_fetch_add(&entry->refs, 1, __ATOMIC_RELAXED);
+    entry->linked = 1;
+    cache_entry_t **bucket = &cache->buckets[entry->hash & (cache->num_buckets - 1)];
+    entry->hash_next = *bucket;
+    *bucket = entry;
+    cache->entries++;
+    list_push(cache, entry, CACHE_WINDOW);
+    cache_balance(cache, entry_part(cache, entry));
+    cache_flight_t *flight = flight_find(cache, entry->path, entry->hash);
+    if (flight) flight_finish(cache, flight, entry);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// Drop a stale entry
+void cache_remove(cache_t *cache, cache_entry_t *entry) {
+    if (!cache || !entry) return;
+    cache_lock(cache);
+    if (entry->linked) cache_unlink(cache, entry);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// Drop a reference, the last one frees the entry
+void cache_release(cache_entry_t *entry) {
+    if (entry && __atomic_sub_fetch(&entry->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        if (entry->fd >= 0) close(entry->fd);
+        free(entry);
+    }
+}
+
+// Estimated recent accesses of a path hash
+unsigned cache_frequency(cache_t *cache, uint32_t hash) {
+    if (!cache) return 0;
+    cache_lock(cache);
+    unsigned estimate = sketch_estimate(&cache->sketch, hash);
+    pthread_mutex_unlock(&cache->lock);
+    return estimate;
+}
+
+// Replay count accesses into the sketch (at most what a counter holds)
+void cache_add_frequency(cache_t *cache, uint32_t hash, unsigned count) {
+    if (!cache) return;
+    if (count > CACHE_SKETCH_MAX_COUNT) count = CACHE_SKETCH_MAX_COUNT;
+    cache_lock(cache);
+    for (unsigned i = 0; i < count; i++) sketch_increment(&cache->sketch, hash);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// Free bytes of the class a size falls in
+int cache_has_room(cache_t *cache, size_t size) {
+    if (!cache) return 0;
+    cache_lock(cache);
+    int room = 0;
+    cache_class_t size_class = size <= class_max_object(cache, CACHE_SMALL) ? CACHE_SMALL : CACHE_LARGE;
+    if (size <= class_max_object(cache, size_class)) {
+        const cache_partition_t *part = &cache->parts[size_class];
+        room = part->lists[CACHE_WINDOW].bytes + main_bytes(part) + size <= part->capacity &&
+               (size_class == CACHE_SMALL || cache->max_files == 0 || part->count < cache->max_files);
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return room;
+}
+
+// Walk the regions from the most to the least valuable
+void cache_for_each(cache_t *cache, cache_visit_fn visit, void *arg) {
+    static const cache_region_t order[CACHE_REGIONS] = { CACHE_PROTECTED, CACHE_PROBATION, CACHE_WINDOW };
+    if (!cache || !visit) return;
+    cache_lock(cache);
+    for (int i = 0; i < CACHE_REGIONS; i++) {
+        for (cache_class_t size_class = CACHE_SMALL; size_class < CACHE_CLASSES; size_class++) {
+            for (cache_entry_t *entry = cache->parts[size_class].lists[order[i]].head; entry; entry = entry->next) {
+                visit(arg, entry->path, sketch_estimate(&cache->sketch, entry->hash));
+            }
+        }
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// Bytes currently cached
+size_t cache_bytes(cache_t *cache) {
+    if (!cache) return 0;
+    cache_lock(cache);
+    size_t bytes = 0;
+    for (cache_class_t size_class = CACHE_SMALL; size_class < CACHE_CLASSES; size_class++) {
+        bytes += cache->parts[size_class].lists[CACHE_WINDOW].bytes + main_bytes(&cache->parts[size_class]);
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return bytes;
+}
+
+// Lock contention counters
+void cache_lock_stats(cache_t *cache, unsigned long *waits, uint64_t *wait_ns) {
+    if (!cache) return;
+    cache_lock(cache);
+    if (waits) *waits = cache->lock_waits;
+    if (wait_ns) *wait_ns = cache->lock_wait_ns;
+    pthread_mutex_unlock(&cache->lock);
+}
@@ -1 +1,224 @@
-// # Interface do cache
\ No newline at end of file
+// # Interface do cache
+
+// cache em memória dos ficheiros servidos de um diretório, um por raiz em cada worker
+// partilhado pelas threads do worker (mutex); as entradas contam referências para
+// serem enviadas fora do lock e sobreviverem a uma remoção entretanto
+// duas políticas (CACHE_POLICY): LRU simples, ou W-TinyLFU com uma janela LRU pequena
+// à frente de um SLRU principal (probation + protected); um count-min sketch com
+// envelhecimento periódico decide se o candidato que sai da janela vale mais que a
+// vítima do SLRU, para que uma passagem de um crawler não expulse os ficheiros quentes
+// duas classes de tamanho com a sua parte da capacidade (CACHE_LARGE_SHARE) e listas próprias:
+// os pequenos guardam o corpo logo a seguir aos headers pré-calculados (um só buffer),
+// os grandes guardam o descritor aberto e saem com sendfile, sem expulsar os pequenos;
+// quantos ficam abertos tem um limite próprio (cache_set_max_files, tirado do RLIMIT_NOFILE)
+// falhas simultâneas no mesmo ficheiro juntam-se (single-flight): a primeira carrega-o,
+// as outras esperam pela inserção e são servidas da mesma entrada
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "config.h"
+
+// W-TinyLFU regions: window share of the capacity, protected share of the main region
+#define CACHE_WINDOW_PERCENT 1
+#define CACHE_PROTECTED_PERCENT 80
+
+// Files larger than their class capacity / CACHE_MAX_OBJECT_FRACTION are served without caching
+#define CACHE_MAX_OBJECT_FRACTION 8
+
+// Bodies up to this size are stored inline after their headers (small class)
+#define CACHE_INLINE_MAX (16 * 1024)
+
+// A cached file is compared with the one on disk at most this often
+#define CACHE_REVALIDATE_MS 1000
+
+// Loads in progress other threads can wait for, and the longest they wait
+// before reading the file themselves
+#define CACHE_MAX_FLIGHTS 32
+#define CACHE_FLIGHT_WAIT_MS 100
+
+// Expected object size, sizes the hash table and the sketch from the capacity
+#define CACHE_OBJECT_SIZE_ESTIMATE 4096
+#define CACHE_MIN_SLOTS 1024
+#define CACHE_MAX_SLOTS (1 << 20)
+
+// Count-min sketch: rows of 4-bit counters (saturate at 15), halved every
+// CACHE_SKETCH_SAMPLE_FACTOR * width increments so old popularity fades
+#define CACHE_SKETCH_ROWS 4
+#define CACHE_SKETCH_MAX_COUNT 15
+#define CACHE_SKETCH_SAMPLE_FACTOR 10
+
+// Size classes, each with its own share of the capacity
+typedef enum {
+    CACHE_SMALL,                    // Body inline after the headers
+    CACHE_LARGE,                    // Body sent from the open file with sendfile
+    CACHE_CLASSES
+} cache_class_t;
+
+// LRU lists of an entry (LRU uses only the window, with the whole capacity)
+typedef enum {
+    CACHE_WINDOW,
+    CACHE_PROBATION,
+    CACHE_PROTECTED,
+    CACHE_REGIONS
+} cache_region_t;
+
+// One cached file. data holds the prerendered entity headers, then the body for
+// the small class (so headers and body go out as one buffer), then the path.
+typedef struct cache_entry {
+    struct cache_entry *hash_next;  // Bucket chain
+    struct cache_entry *prev;       // Region list, head = most recent
+    struct cache_entry *next;
+    uint32_t hash;                  // http_path_hash of path
+    cache_class_t size_class;
+    cache_region_t region;
+    int linked;                     // In the table (holds one reference)
+    int refs;                       // Table + threads sending from it
+    int fd;                         // Open file of a large entry, -1 when the body is inline
+    size_t headers_len;             // Entity headers at the start of data
+    size_t size;                    // Body bytes
+    char *body;                     // Inline body (NULL for large entries)
+    int64_t mtime_ns;               // File identity when loaded
+    uint64_t ino;
+    uint64_t checked_ms;            // Last comparison with the file (CLOCK_MONOTONIC)
+    char *path;                     // Request path, stored after the body
+    char data[];
+} cache_entry_t;
+
+// Doubly linked list of one region
+typedef struct {
+    cache_entry_t *head;
+    cache_entry_t *tail;
+    size_t bytes;
+} cache_list_t;
+
+// Frequency sketch of the TinyLFU admission filter
+typedef struct {
+    uint8_t *counters;              // CACHE_SKETCH_ROWS rows of width counters
+    uint32_t width;                 // Power of two
+    uint32_t additions;             // Increments since the last halving
+    uint32_t sample_size;
+} cache_sketch_t;
+
+// Share of the capacity for one size class, with its own policy regions
+typedef struct {
+    size_t capacity;                // Bytes of file bodies
+    size_t limit[CACHE_REGIONS];    // Budget of each region
+    cache_list_t lists[CACHE_REGIONS];
+    unsigned long count;            // Entries in all regions
+} cache_partition_t;
+
+// A miss being loaded: later misses on the same path wait for it (single-flight)
+typedef struct {
+    const char *path;               // Loader's path, only compared while !done
+    uint32_t hash;
+    int users;                      // Loader + waiters, the slot is free at 0
+    int done;                       // Entry inserted or load given up
+    cache_entry_t *entry;           // Inserted entry (holds a reference), NULL if none
+} cache_flight_t;
+
+// Called for each cached file by cache_for_each
+typedef void (*cache_visit_fn)(void *arg, const char *path, unsigned frequency);
+
+// Cache of one document root
+typedef struct {
+    pthread_mutex_t lock;           // Protects everything below
+    cache_policy_t policy;
+    size_t capacity;                // Both classes
+    int large_percent;              // Share of the large class
+    unsigned long max_files;        // Large entries (open descriptors) kept at most, 0 = no limit
+    cache_partition_t parts[CACHE_CLASSES];
+    cache_entry_t **buckets;
+    uint32_t num_buckets;           // Power of two
+    unsigned long entries;
+    cache_sketch_t sketch;          // Unused by CACHE_POLICY_LRU
+    cache_flight_t flights[CACHE_MAX_FLIGHTS];
+    pthread_cond_t flight_done;     // Broadcast when any flight completes
+
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;        // Entries dropped to make room
+    unsigned long rejections;       // Candidates TinyLFU found colder than the victim
+    unsigned long coalesced;        // Misses that waited for another thread's load
+    unsigned long lock_waits;       // Acquisitions that found the lock held
+    uint64_t lock_wait_ns;
+} cache_t;
+
+
+//CACHE API
+// Create a cache of capacity bytes, large_percent of them for the large class.
+// Returns NULL if capacity is 0 or on error.
+cache_t* cache_create(size_t capacity, int large_percent, cache_policy_t policy);
+
+// Free the cache and the entries no thread holds (held ones go with their last release)
+void cache_destroy(cache_t *cache);
+
+// Drop every entry (held ones stay valid until released)
+void cache_clear(cache_t *cache);
+
+// Change the capacity and the large class share, evicting down to them
+// (a larger capacity also gets a larger table and sketch)
+void cache_set_capacity(cache_t *cache, size_t capacity, int large_percent);
+
+// Keep at most max_files large entries (each holds an open descriptor), 0 = no limit,
+// evicting down to it
+void cache_set_max_files(cache_t *cache, unsigned long max_files);
+
+// Class a file of size bytes is cached in, -1 if it is not cached at all
+int cache_size_class(cache_t *cache, size_t size);
+
+// Find path and count the access. Returns the entry with a reference the caller
+// drops with cache_release, or NULL on a miss.
+cache_entry_t* cache_lookup(cache_t *cache, const char *path, uint32_t hash);
+
+// After a cache_lookup miss: returns the entry if another thread loaded the path
+// meanwhile (waiting up to CACHE_FLIGHT_WAIT_MS for a load in progress), else NULL.
+// With NULL and *flight set the caller is the loader: its cache_insert of the path
+// wakes the waiters, and it must call cache_end_load in any case.
+// With NULL and no flight the caller loads without coordination.
+cache_entry_t* cache_begin_load(cache_t *cache, const char *path, uint32_t hash, cache_flight_t **flight);
+
+// Finish a load from cache_begin_load (waiters of an uninserted path load it themselves)
+// and clear *flight. No-op when *flight is NULL.
+void cache_end_load(cache_t *cache, cache_flight_t **flight);
+
+// Allocate an unlinked entry (held by the caller) with a copy of the entity headers.
+// With fd < 0 the size body bytes are stored inline at entry->body for the caller
+// to fill; otherwise the entry takes fd and the body is sent from it. NULL on error.
+cache_entry_t* cache_entry_create(const char *path, uint32_t hash, const char *headers,
+                                  size_t headers_len, size_t size, int fd);
+
+// Offer a filled entry to the cache, replacing an older one for the same path, and
+// hand it to the threads waiting for its load. The admission policy may evict it
+// again at once; the caller keeps its reference.
+void cache_insert(cache_t *cache, cache_entry_t *entry);
+
+// Drop an entry that no longer matches its file (no-op if already gone)
+void cache_remove(cache_t *cache, cache_entry_t *entry);
+
+// Drop a reference returned by cache_lookup or cache_entry_create
+void cache_release(cache_entry_t *entry);
+
+// Estimated recent accesses of a path hash (0 for LRU)
+unsigned cache_frequency(cache_t *cache, uint32_t hash);
+
+// Count accesses of a path hash seen before this cache existed (warm-up)
+void cache_add_frequency(cache_t *cache, uint32_t hash, unsigned count);
+
+// Whether a file of size bytes fits in its class (bytes and open files) without evicting anything
+int cache_has_room(cache_t *cache, size_t size);
+
+// Call visit(arg, path, frequency) for every entry: protected, probation, then window,
+// most recent first in each. Runs under the cache lock, visit must not use the cache.
+void cache_for_each(cache_t *cache, cache_visit_fn visit, void *arg);
+
+// Bytes currently cached
+size_t cache_bytes(cache_t *cache);
+
+// Times the cache lock was found held and the total time waited for it
+void cache_lock_stats(cache_t *cache, unsigned long *waits, uint64_t *wait_ns);
+
+#endif
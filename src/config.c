@@ -6,10 +6,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <ctype.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include "config.h"
+#include "http.h"
 
 // Remove whitespace from beginning and end of a string
 static char* trim_whitespace(char *str) {
@@ -26,10 +28,10 @@ static char* trim_whitespace(char *str) {
     return str;
 }
 
-// Check if a directory exists in the filesystem
-static int directory_exists(const char *path) {
+// Check if a document root (directory, or bundle file) exists in the filesystem
+static int root_exists(const char *path) {
     struct stat statbuf;
-    return (stat(path, &statbuf) == 0 && S_ISDIR(statbuf.st_mode));
+    return (stat(path, &statbuf) == 0 && (S_ISDIR(statbuf.st_mode) || S_ISREG(statbuf.st_mode)));
 }
 
 // Initialize configuration structure with default values
@@ -42,7 +44,79 @@ void config_init_defaults(server_config_t *config) {
     config->max_queue_size = 100;
     strcpy(config->log_file, "access.log");
     config->cache_size_mb = 10;
+    config->cache_policy = CACHE_POLICY_TINYLFU;
+    config->cache_large_share = 50;
+    config->cache_snapshot[0] = '\0';
+    config->cache_warmup_log_lines = 0;
+    config->rate_limit_rps = 0;
+    config->rate_limit_burst = 0;
     config->timeout_seconds = 30;
+    config->keepalive_timeout_seconds = 5;
+    config->io_backend = IO_BACKEND_EPOLL;
+    config->log_level = 1;     // LOG_INFO
+    config->trace_requests = 0;
+    config->num_mime_types = 0;
+    config->config_file[0] = '\0';
+    config->instance_name[0] = '\0';
+    config->anonymous_shared_memory = 0;
+    config->num_vhosts = 0;
+    for (int i = 0; i < VHOST_TABLE_SIZE; i++) config->vhost_table[i].vhost = -1;
+}
+
+// Add or replace a MIME override in a table
+static int add_mime_type(mime_type_t *table, int *count, const char *extension, const char *type) {
+    if (!extension || !type || extension[0] != '.' || type[0] == '\0' ||
+        strlen(extension) >= sizeof(table[0].extension) ||
+        strlen(type) >= sizeof(table[0].type)) {
+        return -1;
+    }
+
+    int i = 0;
+    while (i < *count && strcasecmp(table[i].extension, extension) != 0) i++;
+    if (i == MAX_MIME_TYPES) return -1;
+    if (i == *count) (*count)++;
+    strcpy(table[i].extension, extension);
+    strcpy(table[i].type, type);
+    return 0;
+}
+
+// Look up a MIME override for the path's extension in a table
+static const char* find_mime_type(const mime_type_t *table, int count, const char *path) {
+    const char *ext = strrchr(path, '.');
+    if (!ext) return NULL;
+    for (int i = 0; i < count; i++) {
+        if (strcasecmp(ext, table[i].extension) == 0) return table[i].type;
+    }
+    return NULL;
+}
+
+// Split ".ext type/subtype" in place, returns the type part
+static char* split_mime_line(char *value) {
+    char *type = value + strcspn(value, " \t");
+    if (*type) *type++ = '\0';
+    return trim_whitespace(type);
+}
+
+// Settings a [vhost] block overrides. Returns 0 if key belongs to the block,
+// 1 if it is a global setting, -1 if the value is invalid.
+static int set_vhost_option(server_config_t *config, int vhost, const char *key, char *value) {
+    vhost_config_t *host = &config->vhosts[vhost];
+    if (strcmp(key, "DOCUMENT_ROOT") == 0) {
+        if (strlen(value) >= MAX_PATH_LENGTH) return -1;
+        strcpy(host->document_root, value);
+        return 0;
+    }
+    if (strcmp(key, "MIME_TYPE") == 0) {
+        char *type = split_mime_line(value);
+        return add_mime_type(host->mime_types, &host->num_mime_types, value, type) == 0 ? 0 : -1;
+    }
+    if (strcmp(key, "CACHE_SHARE") == 0) {
+        int share = atoi(value);
+        if (share < 1 || share > 100) return -1;
+        host->cache_share_percent = share;
+        return 0;
+    }
+    return 1;
 }
 
 // Load configuration from a file
@@ -58,8 +132,10 @@ int config_load_from_file(const char *filename, server_config_t *config) {
 
     // Start with default values
     config_init_defaults(config);
+    if (strlen(filename) < MAX_PATH_LENGTH) strcpy(config->config_file, filename);
     char line[MAX_CONFIG_LINE];
     int line_num = 0;
+    int vhost = -1;     // [vhost] block being read, -1 = global settings
 
     // Read file line by line
     while (fgets(line, sizeof(line), file)) {
@@ -70,6 +146,18 @@ int config_load_from_file(const char *filename, server_config_t *config) {
         char *trimmed_line = trim_whitespace(line);
         if (trimmed_line[0] == '#' || trimmed_line[0] == '\0') continue;
 
+        // "[vhost name alias...]" starts a virtual host block
+        if (trimmed_line[0] == '[') {
+            char *close = strchr(trimmed_line, ']');
+            if (close) *close = '\0';
+            if (!close || strncmp(trimmed_line + 1, "vhost", 5) != 0 ||
+                (vhost = config_add_vhost(config, trimmed_line + 6)) < 0) {
+                fprintf(stderr, "Invalid vhost block on line %d\n", line_num);
+                vhost = -1;
+            }
+            continue;
+        }
+
         // Find the '=' symbol that separates key=value
         char *equals = strchr(trimmed_line, '=');
         if (!equals) {
@@ -82,6 +170,13 @@ int config_load_from_file(const char *filename, server_config_t *config) {
         char *key = trim_whitespace(trimmed_line);
         char *value = trim_whitespace(equals + 1);
 
+        // Inside a block, root, MIME types and cache share belong to the virtual host
+        if (vhost >= 0) {
+            int ret = set_vhost_option(config, vhost, key, value);
+            if (ret < 0) fprintf(stderr, "Invalid %s on line %d\n", key, line_num);
+            if (ret <= 0) continue;
+        }
+
         // Process each configuration option
         if (strcmp(key, "PORT") == 0) {
             config_set_port(config, atoi(value));
@@ -106,10 +201,91 @@ int config_load_from_file(const char *filename, server_config_t *config) {
             int cache_size = atoi(value);
             if (cache_size > 0) config->cache_size_mb = cache_size;
         }
+        else if (strcmp(key, "CACHE_LARGE_SHARE") == 0) {
+            int share = atoi(value);
+            if (share >= 0 && share <= 100) {
+                config->cache_large_share = share;
+            } else {
+                fprintf(stderr, "Invalid CACHE_LARGE_SHARE: %s\n", value);
+            }
+        }
+        else if (strcmp(key, "CACHE_SNAPSHOT") == 0) {
+            if (config_set_cache_snapshot(config, value) != 0) {
+                fprintf(stderr, "Invalid CACHE_SNAPSHOT: %s\n", value);
+            }
+        }
+        else if (strcmp(key, "CACHE_WARMUP_LOG_LINES") == 0) {
+            int lines = atoi(value);
+            if (lines >= 0 && lines <= MAX_WARMUP_LOG_LINES) {
+                config->cache_warmup_log_lines = lines;
+            } else {
+                fprintf(stderr, "Invalid CACHE_WARMUP_LOG_LINES: %s\n", value);
+            }
+        }
+        else if (strcmp(key, "RATE_LIMIT_RPS") == 0) {
+            int rps = atoi(value);
+            if (rps >= 0 && rps <= MAX_RATE_LIMIT_RPS) {
+                config->rate_limit_rps = rps;
+            } else {
+                fprintf(stderr, "Invalid RATE_LIMIT_RPS: %s\n", value);
+            }
+        }
+        else if (strcmp(key, "RATE_LIMIT_BURST") == 0) {
+            int burst = atoi(value);
+            if (burst >= 0 && burst <= MAX_RATE_LIMIT_BURST) {
+                config->rate_limit_burst = burst;
+            } else {
+                fprintf(stderr, "Invalid RATE_LIMIT_BURST: %s\n", value);
+            }
+        }
+        else if (strcmp(key, "CACHE_POLICY") == 0) {
+            if (config_set_cache_policy(config, value) != 0) {
+                fprintf(stderr, "Invalid CACHE_POLICY: %s\n", value);
+            }
+        }
         else if (strcmp(key, "TIMEOUT_SECONDS") == 0) {
             int timeout = atoi(value);
             if (timeout > 0) config->timeout_seconds = timeout;
         }
+        else if (strcmp(key, "KEEPALIVE_TIMEOUT") == 0) {
+            int timeout = atoi(value);
+            if (timeout > 0) config->keepalive_timeout_seconds = timeout;
+        }
+        else if (strcmp(key, "IO_BACKEND") == 0) {
+            if (config_set_io_backend(config, value) != 0) {
+                fprintf(stderr, "Invalid IO_BACKEND: %s\n", value);
+            }
+        }
+        else if (strcmp(key, "LOG_LEVEL") == 0) {
+            if (config_set_log_level(config, value) != 0) {
+                fprintf(stderr, "Invalid LOG_LEVEL: %s\n", value);
+            }
+        }
+        else if (strcmp(key, "TRACE_REQUESTS") == 0) {
+            int requests = atoi(value);
+            if (requests >= 0 && requests <= MAX_TRACE_REQUESTS) {
+                config->trace_requests = requests;
+            } else {
+                fprintf(stderr, "Invalid TRACE_REQUESTS: %s\n", value);
+            }
+        }
+        else if (strcmp(key, "INSTANCE_NAME") == 0) {
+            if (config_set_instance_name(config, value) != 0) {
+                fprintf(stderr, "Invalid INSTANCE_NAME: %s\n", value);
+            }
+        }
+        else if (strcmp(key, "SHARED_MEMORY") == 0) {
+            if (config_set_shared_memory(config, value) != 0) {
+                fprintf(stderr, "Invalid SHARED_MEMORY: %s\n", value);
+            }
+        }
+        else if (strcmp(key, "MIME_TYPE") == 0) {
+            // ".ext type/subtype"
+            char *type = split_mime_line(value);
+            if (config_add_mime_type(config, value, type) != 0) {
+                fprintf(stderr, "Invalid MIME_TYPE line %d\n", line_num);
+            }
+        }
         else {
             fprintf(stderr, "Unknown config option: %s\n", key);
         }
@@ -156,6 +332,103 @@ void config_destroy(server_config_t *config) {
     free(config);
 }
 
+// Heap copy of a configuration
+server_config_t* config_duplicate(const server_config_t *config) {
+    if (!config) return NULL;
+    server_config_t *copy = malloc(sizeof(server_config_t));
+    if (!copy) {
+        perror("Failed to allocate config");
+        return NULL;
+    }
+    memcpy(copy, config, sizeof(server_config_t));
+    return copy;
+}
+
+// Re-read the file the configuration came from (config_load_from_file validates it)
+server_config_t* config_reload(const server_config_t *config) {
+    if (!config || config->config_file[0] == '\0') return NULL;
+    return config_create(config->config_file);
+}
+
+// Whether two configurations have the same virtual host names and roots
+static int same_vhosts(const server_config_t *a, const server_config_t *b) {
+    if (a->num_vhosts != b->num_vhosts) return 0;
+    for (int i = 0; i < a->num_vhosts; i++) {
+        const vhost_config_t *x = &a->vhosts[i], *y = &b->vhosts[i];
+        if (x->num_names != y->num_names || strcmp(x->document_root, y->document_root) != 0) return 0;
+        for (int n = 0; n < x->num_names; n++) {
+            if (strcmp(x->names[n], y->names[n]) != 0) return 0;
+        }
+    }
+    return 1;
+}
+
+// Settings only read when a worker starts
+// Whether every root keeps a cache, or keeps none (workers create caches at startup only)
+static int same_cached_roots(const server_config_t *old_config, const server_config_t *new_config) {
+    for (int i = -1; i < old_config->num_vhosts; i++) {
+        int had_cache = config_get_vhost_cache_size(old_config, i) > 0;
+        if (had_cache != (config_get_vhost_cache_size(new_config, i) > 0)) return 0;
+    }
+    return 1;
+}
+
+int config_needs_respawn(const server_config_t *old_config, const server_config_t *new_config) {
+    return !same_vhosts(old_config, new_config) ||
+           !same_cached_roots(old_config, new_config) ||
+           old_config->port != new_config->port ||
+           old_config->threads_per_worker != new_config->threads_per_worker ||
+           old_config->max_queue_size != new_config->max_queue_size ||
+           old_config->io_backend != new_config->io_backend ||
+           old_config->cache_policy != new_config->cache_policy ||
+           old_config->trace_requests != new_config->trace_requests ||
+           strcmp(old_config->document_root, new_config->document_root) != 0 ||
+           strcmp(old_config->log_file, new_config->log_file) != 0;
+}
+
+// Whether two MIME tables hold the same overrides in the same order
+static int same_mime_table(const mime_type_t *a, int num_a, const mime_type_t *b, int num_b) {
+    if (num_a != num_b) return 0;
+    for (int i = 0; i < num_a; i++) {
+        if (strcmp(a[i].extension, b[i].extension) != 0 || strcmp(a[i].type, b[i].type) != 0) return 0;
+    }
+    return 1;
+}
+
+// Global and virtual host MIME tables both match
+int config_same_mime_types(const server_config_t *a, const server_config_t *b) {
+    if (!same_mime_table(a->mime_types, a->num_mime_types, b->mime_types, b->num_mime_types) ||
+        a->num_vhosts != b->num_vhosts) {
+        return 0;
+    }
+    for (int i = 0; i < a->num_vhosts; i++) {
+        if (!same_mime_table(a->vhosts[i].mime_types, a->vhosts[i].num_mime_types,
+                             b->vhosts[i].mime_types, b->vhosts[i].num_mime_types)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Copy the settings that are read on every use
+void config_copy_reloadable(server_config_t *dst, const server_config_t *src) {
+    dst->cache_size_mb = src->cache_size_mb;
+    dst->cache_large_share = src->cache_large_share;
+    strcpy(dst->cache_snapshot, src->cache_snapshot);
+    dst->rate_limit_rps = src->rate_limit_rps;
+    dst->rate_limit_burst = src->rate_limit_burst;
+    dst->timeout_seconds = src->timeout_seconds;
+    dst->keepalive_timeout_seconds = src->keepalive_timeout_seconds;
+    dst->log_level = src->log_level;
+    memcpy(dst->mime_types, src->mime_types, sizeof(dst->mime_types));
+    dst->num_mime_types = src->num_mime_types;
+    for (int i = 0; i < src->num_vhosts && i < dst->num_vhosts; i++) {
+        memcpy(dst->vhosts[i].mime_types, src->vhosts[i].mime_types, sizeof(dst->vhosts[i].mime_types));
+        dst->vhosts[i].num_mime_types = src->vhosts[i].num_mime_types;
+        dst->vhosts[i].cache_share_percent = src->vhosts[i].cache_share_percent;
+    }
+}
+
 // Validate if all configuration values are valid
 int config_validate(const server_config_t *config) {
     if (!config) return -1;
@@ -180,9 +453,22 @@ int config_validate(const server_config_t *config) {
         return -1;
     }
     // Check if document root exists (warning only)
-    if (!directory_exists(config->document_root)) {
+    if (!root_exists(config->document_root)) {
         fprintf(stderr, "Document root does not exist: %s\n", config->document_root);
     }
+    // Cache shares of the virtual hosts cannot exceed the whole cache
+    int shares = 0;
+    for (int i = 0; i < config->num_vhosts; i++) {
+        shares += config->vhosts[i].cache_share_percent;
+        const char *root = config_get_vhost_document_root(config, i);
+        if (!root_exists(root)) {
+            fprintf(stderr, "Document root of %s does not exist: %s\n", config->vhosts[i].names[0], root);
+        }
+    }
+    if (shares > 100) {
+        fprintf(stderr, "Virtual host cache shares add up to %d%%\n", shares);
+        return -1;
+    }
     return 0;
 }
 
@@ -199,8 +485,29 @@ void config_print(const server_config_t *config) {
     printf("Threads per Worker: %d\n", config->threads_per_worker);
     printf("Max Queue Size: %d\n", config->max_queue_size);
     printf("Log File: %s\n", config->log_file);
-    printf("Cache Size: %d MB\n", config->cache_size_mb);
+    printf("Cache Size: %d MB (%s, %d%% for large files)\n", config->cache_size_mb,
+           config->cache_policy == CACHE_POLICY_LRU ? "lru" : "tinylfu", config->cache_large_share);
+    printf("Cache Warm-up: %s, %d access log lines\n",
+           config->cache_snapshot[0] ? config->cache_snapshot : "no snapshot", config->cache_warmup_log_lines);
+    if (config->rate_limit_rps > 0) {
+        printf("Rate Limit: %d requests/s per client, burst %d\n", config->rate_limit_rps,
+               config_get_rate_limit_burst(config));
+    } else {
+        printf("Rate Limit: off\n");
+    }
     printf("Timeout: %d seconds\n", config->timeout_seconds);
+    printf("Keep-Alive Timeout: %d seconds\n", config->keepalive_timeout_seconds);
+    printf("I/O Backend: %s\n", config->io_backend == IO_BACKEND_IO_URING ? "io_uring" : "epoll");
+    printf("Log Level: %d\n", config->log_level);
+    printf("Trace Requests: %d per worker\n", config->trace_requests);
+    printf("MIME Overrides: %d\n", config->num_mime_types);
+    for (int i = 0; i < config->num_vhosts; i++) {
+        printf("Virtual Host %s: %s\n", config->vhosts[i].names[0],
+               config_get_vhost_document_root(config, i));
+    }
+    printf("Instance: %s (%s shared memory)\n",
+           config->instance_name[0] ? config->instance_name : "from port",
+           config->anonymous_shared_memory ? "anonymous" : "named");
 }
 
 
@@ -241,11 +548,140 @@ megabytes_t config_get_cache_size(const server_config_t *config) {
     return config ? config->cache_size_mb : 0;
 }
 
+// Return file cache policy
+cache_policy_t config_get_cache_policy(const server_config_t *config) {
+    return config ? config->cache_policy : CACHE_POLICY_TINYLFU;
+}
+
+// Return the large file share of the caches
+int config_get_cache_large_share(const server_config_t *config) {
+    return config ? config->cache_large_share : 0;
+}
+
+// Return the cache hot set file
+const char* config_get_cache_snapshot(const server_config_t *config) {
+    return config ? config->cache_snapshot : NULL;
+}
+
+// Return the access log lines replayed by the cache warm-up
+int config_get_cache_warmup_log_lines(const server_config_t *config) {
+    return config ? config->cache_warmup_log_lines : 0;
+}
+
+// Return the requests per second allowed to each client
+int config_get_rate_limit_rps(const server_config_t *config) {
+    return config ? config->rate_limit_rps : 0;
+}
+
+// Return the client burst; unset, one second's worth of requests
+int config_get_rate_limit_burst(const server_config_t *config) {
+    if (!config) return 0;
+    if (config->rate_limit_burst > 0) return config->rate_limit_burst;
+    return config->rate_limit_rps < MAX_RATE_LIMIT_BURST ? config->rate_limit_rps : MAX_RATE_LIMIT_BURST;
+}
+
 // Return timeout in seconds
 seconds_t config_get_timeout(const server_config_t *config) {
     return config ? config->timeout_seconds : 0;
 }
 
+// Return keep-alive idle timeout in seconds
+seconds_t config_get_keepalive_timeout(const server_config_t *config) {
+    return config ? config->keepalive_timeout_seconds : 0;
+}
+
+// Return worker I/O backend
+io_backend_t config_get_io_backend(const server_config_t *config) {
+    return config ? config->io_backend : IO_BACKEND_EPOLL;
+}
+
+// Return minimum log level
+int config_get_log_level(const server_config_t *config) {
+    return config ? config->log_level : 0;
+}
+
+// Return the request timelines kept per worker
+int config_get_trace_requests(const server_config_t *config) {
+    return config ? config->trace_requests : 0;
+}
+
+// Return the MIME_TYPE override for the path's extension
+const char* config_get_mime_type(const server_config_t *config, const char *path) {
+    if (!config || !path) return NULL;
+    return find_mime_type(config->mime_types, config->num_mime_types, path);
+}
+
+// Return the number of virtual hosts
+int config_get_num_vhosts(const server_config_t *config) {
+    return config ? config->num_vhosts : 0;
+}
+
+// Find the virtual host for a host name (one probe sequence, one compare on a hit)
+int config_find_vhost(const server_config_t *config, const char *host, uint32_t hash) {
+    if (!config || !host || config->num_vhosts == 0 || !host[0]) return -1;
+    for (uint32_t i = 0; i < VHOST_TABLE_SIZE; i++) {
+        const vhost_slot_t *slot = &config->vhost_table[(hash + i) & (VHOST_TABLE_SIZE - 1)];
+        if (slot->vhost < 0) return -1;
+        if (slot->hash == hash && strcmp(config->vhosts[slot->vhost].names[slot->name], host) == 0) {
+            return slot->vhost;
+        }
+    }
+    return -1;
+}
+
+// Return the first name of a virtual host
+const char* config_get_vhost_name(const server_config_t *config, int vhost) {
+    if (!config || vhost < 0 || vhost >= config->num_vhosts) return NULL;
+    return config->vhosts[vhost].names[0];
+}
+
+// Return the document root of a virtual host
+const char* config_get_vhost_document_root(const server_config_t *config, int vhost) {
+    if (!config) return NULL;
+    if (vhost < 0 || vhost >= config->num_vhosts || !config->vhosts[vhost].document_root[0]) {
+        return config->document_root;
+    }
+    return config->vhosts[vhost].document_root;
+}
+
+// Return the MIME override of a virtual host, falling back to the global ones
+const char* config_get_vhost_mime_type(const server_config_t *config, int vhost, const char *path) {
+    if (!config || !path) return NULL;
+    if (vhost >= 0 && vhost < config->num_vhosts) {
+        const vhost_config_t *host = &config->vhosts[vhost];
+        const char *type = find_mime_type(host->mime_types, host->num_mime_types, path);
+        if (type) return type;
+    }
+    return find_mime_type(config->mime_types, config->num_mime_types, path);
+}
+
+// Return the cache budget of a virtual host
+megabytes_t config_get_vhost_cache_size(const server_config_t *config, int vhost) {
+    if (!config) return 0;
+    if (vhost >= 0 && vhost < config->num_vhosts && config->vhosts[vhost].cache_share_percent > 0) {
+        return config->cache_size_mb * config->vhosts[vhost].cache_share_percent / 100;
+    }
+
+    // The default host and hosts without a share split the remainder
+    int shares = 0, unshared = 1;
+    for (int i = 0; i < config->num_vhosts; i++) {
+        shares += config->vhosts[i].cache_share_percent;
+        if (config->vhosts[i].cache_share_percent == 0) unshared++;
+    }
+    if (shares >= 100) return 0;
+    return config->cache_size_mb * (100 - shares) / 100 / unshared;
+}
+
+// Return the instance name ("" = derive from the port)
+const char* config_get_instance_name(const server_config_t *config) {
+    return config ? config->instance_name : "";
+}
+
+// Return whether shared memory is anonymous
+int config_get_anonymous_shared_memory(const server_config_t *config) {
+    return config ? config->anonymous_shared_memory : 0;
+}
+
 
 
 //SETTERS IMPLEMENTATION
@@ -284,4 +720,122 @@ int config_set_log_file(server_config_t *config, const char *log_file) {
     strncpy(config->log_file, log_file, MAX_PATH_LENGTH - 1);
     config->log_file[MAX_PATH_LENGTH - 1] = '\0';
     return 0;
-}
\ No newline at end of file
+}
+
+// Set the cache hot set file
+int config_set_cache_snapshot(server_config_t *config, const char *path) {
+    if (!config || !path || strlen(path) >= MAX_PATH_LENGTH) return -1;
+    strcpy(config->cache_snapshot, path);
+    return 0;
+}
+
+// Set the instance name used for IPC object names
+int config_set_instance_name(server_config_t *config, const char *name) {
+    if (!config || !name || strlen(name) >= MAX_INSTANCE_NAME) return -1;
+    for (const char *p = name; *p; p++) {
+        if (!isalnum((unsigned char)*p) && *p != '-' && *p != '_') return -1;
+    }
+    strcpy(config->instance_name, name);
+    return 0;
+}
+
+// Set shared memory mode by name
+int config_set_shared_memory(server_config_t *config, const char *mode) {
+    if (!config || !mode) return -1;
+    if (strcmp(mode, "named") == 0) {
+        config->anonymous_shared_memory = 0;
+    } else if (strcmp(mode, "anonymous") == 0) {
+        config->anonymous_shared_memory = 1;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// Set I/O backend by name
+int config_set_io_backend(server_config_t *config, const char *name) {
+    if (!config || !name) return -1;
+    if (strcmp(name, "epoll") == 0) {
+        config->io_backend = IO_BACKEND_EPOLL;
+    } else if (strcmp(name, "io_uring") == 0) {
+        config->io_backend = IO_BACKEND_IO_URING;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// Set file cache policy by name
+int config_set_cache_policy(server_config_t *config, const char *name) {
+    if (!config || !name) return -1;
+    if (strcmp(name, "lru") == 0) {
+        config->cache_policy = CACHE_POLICY_LRU;
+    } else if (strcmp(name, "tinylfu") == 0) {
+        config->cache_policy = CACHE_POLICY_TINYLFU;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// Set minimum log level by name (same order as log_level_t)
+int config_set_log_level(server_config_t *config, const char *name) {
+    static const char *levels[] = {"debug", "info", "warning", "error"};
+    if (!config || !name) return -1;
+    for (int i = 0; i < 4; i++) {
+        if (strcasecmp(name, levels[i]) == 0) {
+            config->log_level = i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Add a MIME_TYPE override, replacing an existing one for the same extension
+int config_add_mime_type(server_config_t *config, const char *extension, const char *type) {
+    if (!config) return -1;
+    return add_mime_type(config->mime_types, &config->num_mime_types, extension, type);
+}
+
+// Add a virtual host and index its names (lowercase, unique across hosts)
+int config_add_vhost(server_config_t *config, const char *names) {
+    if (!config || !names || config->num_vhosts == MAX_VHOSTS) return -1;
+
+    int index = config->num_vhosts;
+    vhost_config_t *host = &config->vhosts[index];
+    memset(host, 0, sizeof(*host));
+
+    const char *p = names;
+    while (*p) {
+        p += strspn(p, " \t");
+        size_t len = strcspn(p, " \t");
+        if (len == 0) break;
+        if (len >= MAX_HOST_NAME || host->num_names == MAX_VHOST_NAMES) return -1;
+
+        char *name = host->names[host->num_names];
+        for (size_t i = 0; i < len; i++) name[i] = (char)tolower((unsigned char)p[i]);
+        name[len] = '\0';
+        p += len;
+
+        // Names must be unique across every virtual host
+        if (config_find_vhost(config, name, http_path_hash(name)) >= 0) return -1;
+        for (int n = 0; n < host->num_names; n++) {
+            if (strcmp(host->names[n], name) == 0) return -1;
+        }
+        host->num_names++;
+    }
+    if (host->num_names == 0) return -1;
+
+    // Index the names only once the whole block is valid
+    for (int n = 0; n < host->num_names; n++) {
+        uint32_t hash = http_path_hash(host->names[n]);
+        uint32_t slot = hash & (VHOST_TABLE_SIZE - 1);
+        while (config->vhost_table[slot].vhost >= 0) slot = (slot + 1) & (VHOST_TABLE_SIZE - 1);
+        config->vhost_table[slot].hash = hash;
+        config->vhost_table[slot].vhost = (int16_t)index;
+        config->vhost_table[slot].name = (int16_t)n;
+    }
+
+    config->num_vhosts++;
+    return index;
+}
@@ -2,12 +2,66 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#include <stdint.h>
+
 #define MAX_CONFIG_LINE 256
 #define MAX_PATH_LENGTH 1024
+#define MAX_MIME_TYPES 32
+#define MAX_INSTANCE_NAME 64
+
+// Largest per-worker request trace ring (TRACE_REQUESTS)
+#define MAX_TRACE_REQUESTS (1 << 20)
+
+// Most access log lines replayed for the cache warm-up (CACHE_WARMUP_LOG_LINES)
+#define MAX_WARMUP_LOG_LINES 100000
+
+// Largest per-client request rate and burst (RATE_LIMIT_RPS, RATE_LIMIT_BURST)
+#define MAX_RATE_LIMIT_RPS 1000000
+#define MAX_RATE_LIMIT_BURST 65535
+
+// Name-based virtual hosts ([vhost name alias...] blocks)
+#define MAX_VHOSTS 16
+#define MAX_VHOST_NAMES 4
+#define MAX_HOST_NAME 128
+#define VHOST_TABLE_SIZE 128    // Power of two, well above MAX_VHOSTS * MAX_VHOST_NAMES
 
 typedef int megabytes_t;
 typedef int seconds_t;
 
+// I/O backend used by the worker event loop
+typedef enum {
+    IO_BACKEND_EPOLL,
+    IO_BACKEND_IO_URING
+} io_backend_t;
+
+// File cache replacement policy (CACHE_POLICY)
+typedef enum {
+    CACHE_POLICY_LRU,
+    CACHE_POLICY_TINYLFU
+} cache_policy_t;
+
+// MIME type override from a MIME_TYPE=.ext type line
+typedef struct {
+    char extension[16];
+    char type[64];
+} mime_type_t;
+
+// One [vhost] block: its names and the settings it overrides
+typedef struct {
+    char names[MAX_VHOST_NAMES][MAX_HOST_NAME];  // Lowercase host names
+    int num_names;
+    char document_root[MAX_PATH_LENGTH];
+    mime_type_t mime_types[MAX_MIME_TYPES];     // Checked before the global ones
+    int num_mime_types;
+    int cache_share_percent;                    // CACHE_SHARE (0 = even split of the rest)
+} vhost_config_t;
+
+// Open-addressing slot of the host name table (built when the file is loaded)
+typedef struct {
+    uint32_t hash;          // http_path_hash of the name
+    int16_t vhost;          // Index into vhosts, -1 = empty
+    int16_t name;           // Index into the vhost's names
+} vhost_slot_t;
 
 typedef struct {
     int port;
@@ -17,7 +71,25 @@ typedef struct {
     int max_queue_size;
     char log_file[MAX_PATH_LENGTH];
     megabytes_t cache_size_mb;
+    cache_policy_t cache_policy;
+    int cache_large_share;      // Percent of each cache for files sent with sendfile (CACHE_LARGE_SHARE)
+    char cache_snapshot[MAX_PATH_LENGTH];   // Hot set saved on shutdown, loaded on start ("" = none)
+    int cache_warmup_log_lines; // Access log lines replayed into the warm-up (0 = none)
+    int rate_limit_rps;         // Requests per second per client (RATE_LIMIT_RPS, 0 = no limit)
+    int rate_limit_burst;       // Requests a client may send at once (RATE_LIMIT_BURST, 0 = one second's)
     seconds_t timeout_seconds;
+    seconds_t keepalive_timeout_seconds;
+    io_backend_t io_backend;
+    int log_level;              // Minimum log_level_t written (LOG_LEVEL)
+    int trace_requests;         // Request timelines kept per worker (TRACE_REQUESTS, 0 = off)
+    mime_type_t mime_types[MAX_MIME_TYPES];
+    int num_mime_types;
+    char config_file[MAX_PATH_LENGTH];  // File loaded from ("" for defaults)
+    char instance_name[MAX_INSTANCE_NAME];  // Names the IPC objects (INSTANCE_NAME, "" = from the port)
+    int anonymous_shared_memory;        // SHARED_MEMORY=anonymous: no named IPC objects
+    vhost_config_t vhosts[MAX_VHOSTS];
+    int num_vhosts;
+    vhost_slot_t vhost_table[VHOST_TABLE_SIZE];
 } server_config_t;
 
 
@@ -32,6 +104,24 @@ server_config_t* config_create(const char *filename);
 // Free resources allocated by config_create()
 void config_destroy(server_config_t *config);
 
+// Heap copy of a configuration (free with config_destroy)
+server_config_t* config_duplicate(const server_config_t *config);
+
+// Re-read and validate the file config was loaded from, NULL if it is invalid
+server_config_t* config_reload(const server_config_t *config);
+
+// Whether going from old to new needs the workers to be respawned
+// (settings they only read at startup, or a root's cache turned on or off).
+// Returns 1 if so, 0 otherwise.
+int config_needs_respawn(const server_config_t *old_config, const server_config_t *new_config);
+
+// Whether two configurations map every extension to the same MIME types
+// (global and per virtual host tables). Returns 1 if so, 0 otherwise.
+int config_same_mime_types(const server_config_t *a, const server_config_t *b);
+
+// Copy the settings that can change in place (timeouts, cache size, log level, MIME table)
+void config_copy_reloadable(server_config_t *dst, const server_config_t *src);
+
 // Validate configuration values
 int config_validate(const server_config_t *config);
 
@@ -54,8 +144,47 @@ int config_get_max_queue_size(const server_config_t *config);
 const char* config_get_log_file(const server_config_t *config);
 // Get cache size in megabytes
 megabytes_t config_get_cache_size(const server_config_t *config);
+// Get file cache replacement policy
+cache_policy_t config_get_cache_policy(const server_config_t *config);
+// Get the percent of each file cache given to large files (the rest holds small ones inline)
+int config_get_cache_large_share(const server_config_t *config);
+// Get the hot set file the caches are saved to and warmed from ("" = none)
+const char* config_get_cache_snapshot(const server_config_t *config);
+// Get the number of recent access log lines replayed to warm the caches
+int config_get_cache_warmup_log_lines(const server_config_t *config);
+// Get the requests per second allowed to each client (0 = no limit)
+int config_get_rate_limit_rps(const server_config_t *config);
+// Get the requests a client may send at once (RATE_LIMIT_BURST, or the rate when unset)
+int config_get_rate_limit_burst(const server_config_t *config);
 // Get timeout in seconds
 seconds_t config_get_timeout(const server_config_t *config);
+// Get keep-alive idle timeout in seconds
+seconds_t config_get_keepalive_timeout(const server_config_t *config);
+// Get worker I/O backend
+io_backend_t config_get_io_backend(const server_config_t *config);
+// Get minimum log level (log_level_t value)
+int config_get_log_level(const server_config_t *config);
+// Get the number of request timelines each worker keeps (0 = tracing ring off)
+int config_get_trace_requests(const server_config_t *config);
+// Get the configured MIME type for a path, NULL if no MIME_TYPE line matches
+const char* config_get_mime_type(const server_config_t *config, const char *path);
+// Get the instance name for IPC objects ("" when it should be derived from the port)
+const char* config_get_instance_name(const server_config_t *config);
+// Whether shared memory is anonymous (inherited by fork) instead of named per instance
+int config_get_anonymous_shared_memory(const server_config_t *config);
+// Number of [vhost] blocks
+int config_get_num_vhosts(const server_config_t *config);
+// Virtual host serving a lowercase host name with the given http_path_hash, -1 for the default
+int config_find_vhost(const server_config_t *config, const char *host, uint32_t hash);
+// First name of a virtual host, NULL for -1 or an unknown index
+const char* config_get_vhost_name(const server_config_t *config, int vhost);
+// Document root of a virtual host (-1 = the global DOCUMENT_ROOT)
+const char* config_get_vhost_document_root(const server_config_t *config, int vhost);
+// MIME override for a path on a virtual host (its own lines first, then the global ones)
+const char* config_get_vhost_mime_type(const server_config_t *config, int vhost, const char *path);
+// Cache megabytes of a virtual host (-1 = the default host): its CACHE_SHARE percent of
+// CACHE_SIZE_MB, hosts without one split what is left evenly
+megabytes_t config_get_vhost_cache_size(const server_config_t *config, int vhost);
 
 
 //API SETTERS
@@ -69,6 +198,22 @@ int config_set_num_workers(server_config_t *config, int num_workers);
 int config_set_threads_per_worker(server_config_t *config, int threads_per_worker);
 // Set log file path
 int config_set_log_file(server_config_t *config, const char *log_file);
+// Set the cache hot set file ("" = none)
+int config_set_cache_snapshot(server_config_t *config, const char *path);
+// Set I/O backend by name ("epoll" or "io_uring")
+int config_set_io_backend(server_config_t *config, const char *name);
+// Set file cache policy by name ("lru" or "tinylfu")
+int config_set_cache_policy(server_config_t *config, const char *name);
+// Set minimum log level by name ("debug", "info", "warning" or "error")
+int config_set_log_level(server_config_t *config, const char *name);
+// Set the instance name (letters, digits, '-' and '_')
+int config_set_instance_name(server_config_t *config, const char *name);
+// Set shared memory mode by name ("named" or "anonymous")
+int config_set_shared_memory(server_config_t *config, const char *mode);
+// Add a MIME_TYPE override (".ext type")
+int config_add_mime_type(server_config_t *config, const char *extension, const char *type);
+// Start a virtual host answering to a space separated list of names, returns its index or -1
+int config_add_vhost(server_config_t *config, const char *names);
 
 
 
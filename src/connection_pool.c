@@ -0,0 +1,161 @@
+// Pool de conexões
+
+// todas as conexões de um worker são alocadas no arranque num array contíguo
+// aceitar/fechar conexões só mexe numa free list (sem malloc/free)
+// pedidos maiores que o buffer inline passam para um buffer grande do pool
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "connection_pool.h"
+
+// Preallocate capacity connections and large_buffers overflow buffers
+connection_pool_t* connection_pool_create(int capacity, int large_buffers) {
+    if (capacity < 1 || large_buffers < 0) return NULL;
+
+    connection_pool_t *pool = malloc(sizeof(connection_pool_t));
+    if (!pool) {
+        perror("Failed to allocate connection pool");
+        return NULL;
+    }
+
+    pool->connections = aligned_alloc(CACHE_LINE_SIZE, (size_t)capacity * sizeof(connection_t));
+    pool->large_buffers = large_buffers ? malloc((size_t)large_buffers * CONNECTION_LARGE_BUFFER_SIZE) : NULL;
+    pool->free_large = large_buffers ? malloc((size_t)large_buffers * sizeof(char *)) : NULL;
+    if (!pool->connections || (large_buffers && (!pool->large_buffers || !pool->free_large))) {
+        perror("Failed to allocate connections");
+        free(pool->connections);
+        free(pool->large_buffers);
+        free(pool->free_large);
+        free(pool);
+        return NULL;
+    }
+
+    pool->capacity = capacity;
+    pool->in_use = 0;
+    pool->free_list = NULL;
+    for (int i = capacity - 1; i >= 0; i--) {
+        connection_t *conn = &pool->connections[i];
+        conn->fd = -1;
+        conn->state = CONN_STATE_FREE;
+        conn->next = pool->free_list;
+        pool->free_list = conn;
+    }
+
+    pool->large_capacity = large_buffers;
+    pool->large_free = large_buffers;
+    for (int i = 0; i < large_buffers; i++) {
+        pool->free_large[i] = pool->large_buffers + (size_t)i * CONNECTION_LARGE_BUFFER_SIZE;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    return pool;
+}
+
+// Free the pool
+void connection_pool_destroy(connection_pool_t *pool) {
+    if (!pool) return;
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->connections);
+    free(pool->large_buffers);
+    free(pool->free_large);
+    free(pool);
+}
+
+// Take a connection for fd
+connection_t* connection_pool_acquire(connection_pool_t *pool, int fd, const struct sockaddr_storage *addr) {
+    pthread_mutex_lock(&pool->lock);
+    connection_t *conn = pool->free_list;
+    if (conn) {
+        pool->free_list = conn->next;
+        pool->in_use++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    if (!conn) return NULL;
+
+    conn->fd = fd;
+    conn->state = CONN_STATE_READING;
+    conn->buffer = conn->inline_buffer;
+    conn->buffer_len = 0;
+    conn->buffer_size = CONNECTION_INLINE_BUFFER_SIZE;
+    conn->registered = 0;
+    conn->recv_pending = 0;
+    conn->arena = NULL;
+    conn->next = NULL;
+    timer_init(&conn->timer, conn);
+    conn->keep_alive = 0;
+    clock_gettime(CLOCK_MONOTONIC, &conn->accepted_at);
+    conn->requests_served = 0;
+    conn->bytes_sent = 0;
+    conn->client_ip[0] = '\0';
+    conn->client_key = 0;
+
+    if (addr && addr->ss_family == AF_INET) {
+        inet_ntop(AF_INET, &((const struct sockaddr_in *)addr)->sin_addr,
+                  conn->client_ip, sizeof(conn->client_ip));
+    } else if (addr && addr->ss_family == AF_INET6) {
+        inet_ntop(AF_INET6, &((const struct sockaddr_in6 *)addr)->sin6_addr,
+                  conn->client_ip, sizeof(conn->client_ip));
+    }
+    return conn;
+}
+
+// Close the socket and return the connection to the pool
+void connection_pool_release(connection_pool_t *pool, connection_t *conn) {
+    if (conn->fd >= 0) close(conn->fd);
+    conn->fd = -1;
+    conn->state = CONN_STATE_FREE;
+
+    pthread_mutex_lock(&pool->lock);
+    if (conn->buffer != conn->inline_buffer) {
+        pool->free_large[pool->large_free++] = conn->buffer;
+    }
+    conn->buffer = conn->inline_buffer;
+    conn->next = pool->free_list;
+    pool->free_list = conn;
+    pool->in_use--;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Connections currently handed out
+int connection_pool_in_use(connection_pool_t *pool) {
+    pthread_mutex_lock(&pool->lock);
+    int in_use = pool->in_use;
+    pthread_mutex_unlock(&pool->lock);
+    return in_use;
+}
+
+// Move the connection to a large buffer
+int connection_pool_grow_buffer(connection_pool_t *pool, connection_t *conn) {
+    if (conn->buffer != conn->inline_buffer) return -1;
+
+    pthread_mutex_lock(&pool->lock);
+    char *large = pool->large_free > 0 ? pool->free_large[--pool->large_free] : NULL;
+    pthread_mutex_unlock(&pool->lock);
+    if (!large) return -1;
+
+    memcpy(large, conn->buffer, conn->buffer_len);
+    conn->buffer = large;
+    conn->buffer_size = CONNECTION_LARGE_BUFFER_SIZE;
+    return 0;
+}
+
+// Fill conn->client_ip from the socket when the accept did not provide it
+void connection_resolve_peer(connection_t *conn) {
+    if (conn->client_ip[0]) return;
+
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    if (getpeername(conn->fd, (struct sockaddr *)&addr, &len) == 0) {
+        if (addr.ss_family == AF_INET) {
+            inet_ntop(AF_INET, &((struct sockaddr_in *)&addr)->sin_addr,
+                      conn->client_ip, sizeof(conn->client_ip));
+        } else if (addr.ss_family == AF_INET6) {
+            inet_ntop(AF_INET6, &((struct sockaddr_in6 *)&addr)->sin6_addr,
+                      conn->client_ip, sizeof(conn->client_ip));
+        }
+    }
+    if (!conn->client_ip[0]) strcpy(conn->client_ip, "-");
+}
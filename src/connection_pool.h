@@ -0,0 +1,49 @@
+// Interface pool de conexões
+
+// conexões pré-alocadas por worker (alinhadas à cache line) reutilizadas por uma free list
+// buffers grandes partilhados para pedidos que não cabem no buffer inline
+
+#ifndef CONNECTION_POOL_H
+#define CONNECTION_POOL_H
+
+#include <pthread.h>
+#include <sys/socket.h>
+#include "connection_queue.h"
+
+// Preallocated connections and overflow buffers of one worker
+typedef struct {
+    connection_t *connections;      // Contiguous, cache-line aligned array
+    int capacity;                   // Number of connections
+    int in_use;                     // Connections currently handed out
+    connection_t *free_list;        // Free connections
+    char *large_buffers;            // Storage of the overflow buffers
+    char **free_large;              // Stack of free overflow buffers
+    int large_capacity;             // Number of overflow buffers
+    int large_free;                 // Free overflow buffers on the stack
+    pthread_mutex_t lock;           // Protects both free lists
+} connection_pool_t;
+
+
+//CONNECTION POOL API
+// Preallocate capacity connections and large_buffers overflow buffers
+connection_pool_t* connection_pool_create(int capacity, int large_buffers);
+
+// Free the pool (every connection must have been released)
+void connection_pool_destroy(connection_pool_t *pool);
+
+// Take a connection for fd, NULL when the pool is exhausted
+connection_t* connection_pool_acquire(connection_pool_t *pool, int fd, const struct sockaddr_storage *addr);
+
+// Close the socket and return the connection (and its overflow buffer) to the pool
+void connection_pool_release(connection_pool_t *pool, connection_t *conn);
+
+// Connections currently handed out
+int connection_pool_in_use(connection_pool_t *pool);
+
+// Move the connection to a large buffer, returns -1 if none is free or already large
+int connection_pool_grow_buffer(connection_pool_t *pool, connection_t *conn);
+
+// Fill conn->client_ip from the socket when the accept did not provide it
+void connection_resolve_peer(connection_t *conn);
+
+#endif
@@ -1 +1,130 @@
-// Fila de conexões (produtor-consumidor)
\ No newline at end of file
+// Fila de conexões (produtor-consumidor)
+
+// buffer circular protegido por mutex
+// semáforos contam slots livres e ocupados
+// push não bloqueia (fila cheia = conexão rejeitada), pop bloqueia
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "connection_queue.h"
+
+// Take the mutex, timing the wait when another thread holds it
+static void queue_lock(connection_queue_t *queue) {
+    if (pthread_mutex_trylock(&queue->mutex) == 0) return;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_mutex_lock(&queue->mutex);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    queue->lock_waits++;
+    queue->lock_wait_ns += (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec;
+}
+
+// Create a queue holding up to capacity connections
+connection_queue_t* connection_queue_create(int capacity) {
+    if (capacity < 1) return NULL;
+
+    connection_queue_t *queue = malloc(sizeof(connection_queue_t));
+    if (!queue) {
+        perror("Failed to allocate connection queue");
+        return NULL;
+    }
+
+    queue->items = calloc(capacity, sizeof(connection_t *));
+    if (!queue->items) {
+        perror("Failed to allocate connection queue items");
+        free(queue);
+        return NULL;
+    }
+
+    queue->capacity = capacity;
+    queue->head = 0;
+    queue->tail = 0;
+    queue->count = 0;
+    queue->shutdown = 0;
+    queue->lock_waits = 0;
+    queue->lock_wait_ns = 0;
+    pthread_mutex_init(&queue->mutex, NULL);
+    sem_init(&queue->empty_slots, 0, capacity);
+    sem_init(&queue->filled_slots, 0, 0);
+    return queue;
+}
+
+// Free the queue
+void connection_queue_destroy(connection_queue_t *queue) {
+    if (!queue) return;
+    sem_destroy(&queue->empty_slots);
+    sem_destroy(&queue->filled_slots);
+    pthread_mutex_destroy(&queue->mutex);
+    free(queue->items);
+    free(queue);
+}
+
+// Add a connection without blocking
+int connection_queue_push(connection_queue_t *queue, connection_t *conn) {
+    if (!queue || !conn) return -1;
+
+    // Full queue: caller decides what to do with the connection
+    if (sem_trywait(&queue->empty_slots) != 0) return -1;
+
+    queue_lock(queue);
+    queue->items[queue->tail] = conn;
+    queue->tail = (queue->tail + 1) % queue->capacity;
+    queue->count++;
+    pthread_mutex_unlock(&queue->mutex);
+
+    sem_post(&queue->filled_slots);
+    return 0;
+}
+
+// Connections currently queued (may be stale by the time it is used)
+int connection_queue_depth(connection_queue_t *queue) {
+    return queue ? __atomic_load_n(&queue->count, __ATOMIC_RELAXED) : 0;
+}
+
+// Remove a connection, blocks while empty
+connection_t* connection_queue_pop(connection_queue_t *queue) {
+    if (!queue) return NULL;
+
+    while (sem_wait(&queue->filled_slots) != 0) {
+        if (errno != EINTR) return NULL;
+    }
+
+    queue_lock(queue);
+    if (queue->count == 0) {
+        pthread_mutex_unlock(&queue->mutex);
+        return NULL;
+    }
+    connection_t *conn = queue->items[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+    pthread_mutex_unlock(&queue->mutex);
+
+    sem_post(&queue->empty_slots);
+    return conn;
+}
+
+// Contention on the queue mutex so far
+void connection_queue_lock_stats(connection_queue_t *queue, unsigned long *waits, uint64_t *wait_ns) {
+    if (!queue) return;
+    pthread_mutex_lock(&queue->mutex);
+    if (waits) *waits = queue->lock_waits;
+    if (wait_ns) *wait_ns = queue->lock_wait_ns;
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+// Wake up all consumers so they can exit
+void connection_queue_shutdown(connection_queue_t *queue, int num_consumers) {
+    if (!queue) return;
+
+    pthread_mutex_lock(&queue->mutex);
+    queue->shutdown = 1;
+    pthread_mutex_unlock(&queue->mutex);
+
+    for (int i = 0; i < num_consumers; i++) {
+        sem_post(&queue->filled_slots);
+    }
+}
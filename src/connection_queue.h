@@ -1 +1,106 @@
-// Interface da fila
\ No newline at end of file
+// Interface da fila
+
+// fila limitada (MAX_QUEUE_SIZE) entre o event loop e as threads do worker
+// o event loop produz conexões com dados prontos, as threads consomem
+
+#ifndef CONNECTION_QUEUE_H
+#define CONNECTION_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "arena.h"
+#include "timer_wheel.h"
+#include "trace.h"
+
+// Request buffer stored inside each connection (fits typical browser requests)
+#define CONNECTION_INLINE_BUFFER_SIZE 4096
+
+// Larger pooled buffer used when a request header overflows the inline one
+#define CONNECTION_LARGE_BUFFER_SIZE 16384
+
+// Cache line size used to keep connections from sharing lines
+#define CACHE_LINE_SIZE 64
+
+// Life cycle of a pooled connection
+typedef enum {
+    CONN_STATE_FREE,            // In the pool's free list
+    CONN_STATE_READING,         // Owned by the event loop, waiting for request data
+    CONN_STATE_QUEUED,          // In the connection queue
+    CONN_STATE_PROCESSING       // Owned by a serving thread
+} connection_state_t;
+
+// Client connection owned by a worker process (allocated from connection_pool_t).
+// Each object starts on its own cache line so threads serving neighbouring
+// connections never write to the same line.
+typedef struct connection {
+    // Hot fields: touched on every event
+    int fd;                                   // Client socket (non-blocking)
+    connection_state_t state;                 // Current owner/stage
+    char *buffer;                             // inline_buffer or a pooled large buffer
+    size_t buffer_len;                        // Valid bytes in buffer
+    size_t buffer_size;                       // Capacity of buffer
+    int registered;                           // Already added to the event loop
+    unsigned recv_bid;                        // io_uring provided buffer holding bytes not yet in buffer
+    unsigned recv_offset;                     // First of them in that buffer
+    unsigned recv_pending;                    // How many (0 = none)
+    arena_t *arena;                           // Request-scoped memory while a thread serves it
+    struct connection *next;                  // Link for free list and event loop lists
+
+    // Timers and per-connection stats
+    wheel_timer_t timer;                      // Header-read, idle or write deadline
+    int keep_alive;                           // Current response keeps the connection open
+    uint64_t queued_at_us;                    // When it entered the queue (CLOCK_MONOTONIC)
+    uint64_t first_byte_us;                   // Response header of the current request sent (0 = not yet)
+    struct timespec accepted_at;              // Accept time (CLOCK_MONOTONIC)
+    unsigned long requests_served;            // Requests answered on this connection
+    unsigned long bytes_sent;                 // Bytes written to this connection
+    trace_timeline_t trace;                   // Phases of the current request (TRACE_REQUESTS)
+
+    char client_ip[INET6_ADDRSTRLEN];         // Peer address for the access log
+    uint64_t client_key;                      // rate_limit_key of the peer (0 = not known yet)
+    char inline_buffer[CONNECTION_INLINE_BUFFER_SIZE];
+} __attribute__((aligned(CACHE_LINE_SIZE))) connection_t;
+
+// Bounded producer-consumer queue of connections
+typedef struct {
+    connection_t **items;   // Circular buffer
+    int capacity;           // Maximum queued connections
+    int head;               // Next slot to pop
+    int tail;               // Next slot to push
+    int count;              // Connections currently queued
+    int shutdown;           // Set when consumers must stop
+    pthread_mutex_t mutex;  // Protects head/tail and the lock counters
+    sem_t empty_slots;      // Free slots
+    sem_t filled_slots;     // Queued connections
+    unsigned long lock_waits;   // Times push/pop found the mutex taken
+    uint64_t lock_wait_ns;      // Time spent waiting for it
+} connection_queue_t;
+
+
+//CONNECTION QUEUE API
+// Create a queue holding up to capacity connections
+connection_queue_t* connection_queue_create(int capacity);
+
+// Free the queue (connections still queued are not closed)
+void connection_queue_destroy(connection_queue_t *queue);
+
+// Add a connection without blocking, returns -1 if the queue is full
+int connection_queue_push(connection_queue_t *queue, connection_t *conn);
+
+// Connections currently queued (lock-free snapshot)
+int connection_queue_depth(connection_queue_t *queue);
+
+// Remove a connection, blocks while empty. Returns NULL after shutdown.
+connection_t* connection_queue_pop(connection_queue_t *queue);
+
+// Contention on the queue mutex so far (either pointer may be NULL)
+void connection_queue_lock_stats(connection_queue_t *queue, unsigned long *waits, uint64_t *wait_ns);
+
+// Wake up all consumers so they can exit
+void connection_queue_shutdown(connection_queue_t *queue, int num_consumers);
+
+#endif
@@ -0,0 +1,180 @@
+// Raiz de documentos
+
+// abre a DOCUMENT_ROOT uma única vez e guarda o descritor
+// ficheiros são abertos com openat2(RESOLVE_BENEATH) relativamente à raiz,
+// por isso é o kernel que impede a saída da raiz (inclusive por symlinks)
+// em kernels sem openat2 percorre o caminho componente a componente com O_NOFOLLOW
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/syscall.h>
+#include <linux/openat2.h>
+#include "docroot.h"
+#include "http.h"
+
+// Open rel below dirfd using openat2 with kernel-enforced confinement
+static int open_openat2(int dirfd, const char *rel, int flags) {
+    struct open_how how;
+    memset(&how, 0, sizeof(how));
+    how.flags = (unsigned long long)(flags | O_CLOEXEC);
+    how.resolve = RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS;
+    return (int)syscall(SYS_openat2, dirfd, rel, &how, sizeof(how));
+}
+
+// Fallback for kernels without openat2: walk each component refusing symlinks
+static int open_walk(int dirfd, const char *rel, int flags) {
+    char buffer[MAX_PATH_LENGTH];
+    if (strlen(rel) >= sizeof(buffer)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(buffer, rel);
+
+    int cur = dirfd;
+    char *component = buffer;
+    for (;;) {
+        char *slash = strchr(component, '/');
+        if (slash) *slash = '\0';
+
+        if (strcmp(component, "..") == 0) {
+            if (cur != dirfd) close(cur);
+            errno = EXDEV;
+            return -1;
+        }
+
+        int next_flags = slash ? (O_PATH | O_DIRECTORY) : flags;
+        int next = openat(cur, component, next_flags | O_NOFOLLOW | O_CLOEXEC);
+        if (cur != dirfd) {
+            int saved = errno;
+            close(cur);
+            errno = saved;
+        }
+        if (next < 0 || !slash) return next;
+
+        cur = next;
+        component = slash + 1;
+    }
+}
+
+// Open rel below dirfd, falling back once openat2 is known to be missing
+static int open_beneath(docroot_t *root, int dirfd, const char *rel, int flags) {
+    if (*rel == '\0') {
+        errno = EISDIR;
+        return -1;
+    }
+
+    if (__atomic_load_n(&root->use_openat2, __ATOMIC_RELAXED)) {
+        int fd = open_openat2(dirfd, rel, flags);
+        if (fd >= 0 || errno != ENOSYS) return fd;
+        __atomic_store_n(&root->use_openat2, 0, __ATOMIC_RELAXED);
+    }
+
+    return open_walk(dirfd, rel, flags);
+}
+
+// Open the document root directory
+docroot_t* docroot_create(const char *document_root) {
+    if (!document_root) return NULL;
+
+    docroot_t *root = malloc(sizeof(docroot_t));
+    if (!root) {
+        perror("Failed to allocate document root");
+        return NULL;
+    }
+
+    root->root_fd = open(document_root, O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (root->root_fd < 0) {
+        perror("Failed to open document root");
+        free(root);
+        return NULL;
+    }
+
+    root->use_openat2 = 1;
+    pthread_rwlock_init(&root->dir_lock, NULL);
+    for (int i = 0; i < DOCROOT_DIR_CACHE_SIZE; i++) {
+        root->dir_cache[i].path[0] = '\0';
+        root->dir_cache[i].hash = 0;
+        root->dir_cache[i].fd = -1;
+    }
+
+    return root;
+}
+
+// Open the document root configured in config
+docroot_t* docroot_create_from_config(const server_config_t *config) {
+    return docroot_create(config_get_document_root(config));
+}
+
+// Close the root and all cached directory descriptors
+void docroot_destroy(docroot_t *root) {
+    if (!root) return;
+
+    for (int i = 0; i < DOCROOT_DIR_CACHE_SIZE; i++) {
+        if (root->dir_cache[i].fd >= 0) close(root->dir_cache[i].fd);
+    }
+    pthread_rwlock_destroy(&root->dir_lock);
+    close(root->root_fd);
+    free(root);
+}
+
+// Open a canonical request path below the root
+int docroot_open(docroot_t *root, const char *path, int flags) {
+    if (!root || !path) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Paths are relative to the root descriptor
+    while (*path == '/') path++;
+
+    const char *last = strrchr(path, '/');
+    size_t dir_len = last ? (size_t)(last - path) : 0;
+    if (!last || dir_len >= DOCROOT_MAX_DIR_PATH) {
+        return open_beneath(root, root->root_fd, path, flags);
+    }
+
+    const char *base = last + 1;
+    if (*base == '\0') {
+        errno = EISDIR;
+        return -1;
+    }
+
+    char dir[DOCROOT_MAX_DIR_PATH];
+    memcpy(dir, path, dir_len);
+    dir[dir_len] = '\0';
+    uint32_t hash = http_path_hash(dir);
+    docroot_dir_entry_t *entry = &root->dir_cache[hash % DOCROOT_DIR_CACHE_SIZE];
+
+    // Hit: open relative to the cached directory (lock held so it is not closed)
+    pthread_rwlock_rdlock(&root->dir_lock);
+    if (entry->fd >= 0 && entry->hash == hash && strcmp(entry->path, dir) == 0) {
+        int fd = open_beneath(root, entry->fd, base, flags);
+        int saved = errno;
+        pthread_rwlock_unlock(&root->dir_lock);
+        errno = saved;
+        return fd;
+    }
+    pthread_rwlock_unlock(&root->dir_lock);
+
+    // Miss: open the directory below the root and remember it
+    int dir_fd = open_beneath(root, root->root_fd, dir, O_PATH | O_DIRECTORY);
+    if (dir_fd < 0) return -1;
+
+    int fd = open_beneath(root, dir_fd, base, flags);
+    int saved = errno;
+
+    pthread_rwlock_wrlock(&root->dir_lock);
+    if (entry->fd >= 0) close(entry->fd);
+    strcpy(entry->path, dir);
+    entry->hash = hash;
+    entry->fd = dir_fd;
+    pthread_rwlock_unlock(&root->dir_lock);
+
+    errno = saved;
+    return fd;
+}
@@ -0,0 +1,49 @@
+// Interface document root
+
+// abre a raiz de documentos uma vez e mantém o descritor durante a vida do processo
+// todos os ficheiros são abertos relativamente a essa raiz (openat2 + RESOLVE_BENEATH)
+// mantém em cache os descritores das subdiretorias mais usadas
+
+#ifndef DOCROOT_H
+#define DOCROOT_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "config.h"
+
+// Number of cached subdirectory descriptors
+#define DOCROOT_DIR_CACHE_SIZE 64
+#define DOCROOT_MAX_DIR_PATH 256
+
+// Cached descriptor of a subdirectory below the root
+typedef struct {
+    char path[DOCROOT_MAX_DIR_PATH];  // Canonical directory path without leading '/'
+    uint32_t hash;                    // Hash of path
+    int fd;                           // O_PATH directory descriptor, -1 if empty
+} docroot_dir_entry_t;
+
+// Document root opened once and used as anchor for every file open
+typedef struct {
+    int root_fd;                                         // O_PATH descriptor of the root
+    int use_openat2;                                     // 0 after openat2 returned ENOSYS
+    pthread_rwlock_t dir_lock;                           // Protects dir_cache
+    docroot_dir_entry_t dir_cache[DOCROOT_DIR_CACHE_SIZE];
+} docroot_t;
+
+
+//DOCROOT API
+// Open the document root directory, returns NULL on error
+docroot_t* docroot_create(const char *document_root);
+
+// Open the document root configured in config
+docroot_t* docroot_create_from_config(const server_config_t *config);
+
+// Close the root and all cached directory descriptors
+void docroot_destroy(docroot_t *root);
+
+// Open a canonical request path (see http_canonicalize_path) below the root.
+// The kernel refuses to leave the root, including through symlinks.
+// Returns a file descriptor or -1 with errno set.
+int docroot_open(docroot_t *root, const char *path, int flags);
+
+#endif
@@ -8,11 +8,88 @@
 
 #include "http.h"
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
 #include <ctype.h>
 #include <time.h>
+// Check a header for a token (case-insensitive), returns 1 if present
+int http_header_has_token(const char *headers, const char *name, const char *token) {
+    if (!headers || !name || !token) return 0;
+    size_t name_len = strlen(name);
+    size_t token_len = strlen(token);
+    const char *line = headers;
+
+    while (*line && *line != '\r' && *line != '\n') {
+        size_t line_len = strcspn(line, "\r\n");
+        if (line_len > name_len && line[name_len] == ':' && strncasecmp(line, name, name_len) == 0) {
+            for (const char *p = line + name_len + 1; p + token_len <= line + line_len; p++) {
+                if (strncasecmp(p, token, token_len) == 0) return 1;
+            }
+        }
+        line += line_len;
+        if (*line == '\r') line++;
+        if (*line == '\n') line++;
+    }
+    return 0;
+}
+
+// Copy the Host header into request->host (lowercase, port removed) and hash it
+static void parse_host(const char *headers, http_request_t *request) {
+    const char *line = headers;
+    while (*line && *line != '\r' && *line != '\n') {
+        size_t line_len = strcspn(line, "\r\n");
+        if (line_len > 5 && strncasecmp(line, "Host:", 5) == 0) {
+            const char *value = line + 5;
+            const char *end = line + line_len;
+            while (value < end && (*value == ' ' || *value == '\t')) value++;
+            while (end > value && (end[-1] == ' ' || end[-1] == '\t')) end--;
+
+            // Drop ":port" (after the closing bracket for IPv6 literals) and a trailing dot
+            const char *colon = end;
+            for (const char *p = end; p > value; p--) {
+                if (p[-1] == ']') break;
+                if (p[-1] == ':') {
+                    colon = p - 1;
+                    break;
+                }
+            }
+            end = colon;
+            if (end > value && end[-1] == '.') end--;
+
+            size_t len = end - value;
+            if (len >= HTTP_MAX_HOST) return;
+            for (size_t i = 0; i < len; i++) request->host[i] = (char)tolower((unsigned char)value[i]);
+            request->host[len] = '\0';
+            request->host_hash = http_path_hash(request->host);
+            return;
+        }
+        line += line_len;
+        if (*line == '\r') line++;
+        if (*line == '\n') line++;
+    }
+}
+
+// Length of a header block up to and including the empty line that ends it
+// (the rest of the buffer may hold pipelined requests)
+static size_t header_block_length(const char *headers) {
+    const char *line = headers;
+    while (*line && *line != '\r' && *line != '\n') {
+        line += strcspn(line, "\r\n");
+        if (*line == '\r') line++;
+        if (*line == '\n') line++;
+    }
+    if (*line == '\r') line++;
+    if (*line == '\n') line++;
+    return line - headers;
+}
+
 // Parse HTTP request from buffer
 int http_parse_request(const char *buffer, http_request_t *request) {
+    return http_parse_request_arena(buffer, request, NULL);
+}
+
+// Parse HTTP request, request-scoped memory comes from arena
+int http_parse_request_arena(const char *buffer, http_request_t *request, arena_t *arena) {
     if (!buffer || !request) {
         return -1;
     }
@@ -21,23 +98,23 @@ int http_parse_request(const char *buffer, http_request_t *request) {
     memset(request, 0, sizeof(http_request_t));
     request->method = HTTP_UNSUPPORTED;
     request->version = HTTP_UNKNOWN;
+    request->arena = arena;
 
-    // Copy buffer for parsing (strtok modifies the string)
-    char *copy = strdup(buffer);
-    if (!copy) {
-        return -1;
-    }
+    // Ignore empty lines before the request line
+    while (*buffer == '\r' || *buffer == '\n') buffer++;
 
-    char *line = strtok(copy, "\r\n");
-    if (!line) {
-        free(copy);
+    // Request line ends at the first CR/LF (copied to the stack, no strdup)
+    size_t line_len = strcspn(buffer, "\r\n");
+    if (line_len == 0 || line_len >= HTTP_MAX_REQUEST_LINE) {
         return -1;
     }
+    char line[HTTP_MAX_REQUEST_LINE];
+    memcpy(line, buffer, line_len);
+    line[line_len] = '\0';
 
     // Parse request line: "METHOD PATH VERSION"
     char method[16], path[1024], version[16];
     if (sscanf(line, "%15s %1023s %15s", method, path, version) != 3) {
-        free(copy);
         return -1;
     }
 
@@ -50,12 +127,11 @@ int http_parse_request(const char *buffer, http_request_t *request) {
         request->method = HTTP_UNSUPPORTED;
     }
 
-    // Parse path (URL decode if needed)
-    strncpy(request->path, path, sizeof(request->path) - 1);
-    request->path[sizeof(request->path) - 1] = '\0';
-
-    // Simple URL decode for spaces
-    http_url_decode(request->path, request->path);
+    // Decode and canonicalize path (also computes the lookup key)
+    if (http_canonicalize_path(path, request->path, sizeof(request->path),
+                               &request->path_hash) != 0) {
+        return -1;
+    }
 
     // Parse HTTP version
     if (strcmp(version, "HTTP/1.0") == 0) {
@@ -66,17 +142,32 @@ int http_parse_request(const char *buffer, http_request_t *request) {
         request->version = HTTP_UNKNOWN;
     }
 
-    // Parse headers (simple version - just store them)
-    request->headers = strdup(buffer + strlen(line) + 2); // Skip request line + CRLF
+    // Parse headers (simple version - just store them after the request line)
+    const char *headers = buffer + line_len;
+    if (*headers == '\r') headers++;
+    if (*headers == '\n') headers++;
+    size_t headers_len = header_block_length(headers);
+    request->headers = arena ? arena_strndup(arena, headers, headers_len) : strndup(headers, headers_len);
+
+    // Virtual host selection key
+    parse_host(headers, request);
+    request->accept_gzip = http_header_has_token(headers, "Accept-Encoding", "gzip");
+
+    // HTTP/1.1 is persistent unless "close", HTTP/1.0 only with "keep-alive"
+    if (request->version == HTTP_1_1) {
+        request->keep_alive = !http_header_has_token(headers, "Connection", "close");
+    } else {
+        request->keep_alive = http_header_has_token(headers, "Connection", "keep-alive");
+    }
 
-    free(copy);
     return 0;
 }
 
 // Free resources allocated during parsing
 void http_free_request(http_request_t *request) {
     if (request && request->headers) {
-        free(request->headers);
+        // Arena memory is released by arena_reset
+        if (!request->arena) free(request->headers);
         request->headers = NULL;
     }
 }
@@ -111,73 +202,114 @@ const char* http_get_mime_type(const char *filename) {
 
 // Create HTTP response header
 char* http_create_response_header(int status_code, const char *content_type, size_t content_length) {
-    const char *status_msg = http_status_message(status_code);
-    
+    return http_create_response_header_arena(NULL, status_code, content_type, content_length, 0);
+}
+
+// Create HTTP response header in arena (or with malloc when arena is NULL)
+char* http_create_response_header_arena(arena_t *arena, int status_code, const char *content_type, size_t content_length, int keep_alive) {
     // Calculate approximate size needed
     size_t header_size = 256 + (content_type ? strlen(content_type) : 0);
-    char *header = malloc(header_size);
+    char *header = arena ? arena_alloc(arena, header_size) : malloc(header_size);
     if (!header) return NULL;
 
+    // Build response header in place
+    int len = http_format_status_lines(header, header_size, status_code, keep_alive);
+
+    if (content_type) {
+        len += snprintf(header + len, header_size - len, "Content-Type: %s\r\n", content_type);
+    }
+
+    if (content_length > 0 || keep_alive) {
+        len += snprintf(header + len, header_size - len, "Content-Length: %zu\r\n", content_length);
+    }
+
+    snprintf(header + len, header_size - len, "\r\n");  // End of headers
+    return header;
+}
+
+// Write the status line and the Server, Date and Connection headers
+int http_format_status_lines(char *buf, size_t size, int status_code, int keep_alive) {
     // Get current time for Date header
     time_t now = time(NULL);
-    struct tm *gm = gmtime(&now);
+    struct tm gm;
+    gmtime_r(&now, &gm);
     char date[64];
-    strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", gm);
+    strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &gm);
 
-    // Build response header
-    snprintf(header, header_size,
+    return snprintf(buf, size,
         "HTTP/1.1 %d %s\r\n"
         "Server: Concurrent-HTTP-Server\r\n"
         "Date: %s\r\n"
-        "Connection: close\r\n",
-        status_code, status_msg, date);
-
-    if (content_type) {
-        char temp[512];
-        snprintf(temp, sizeof(temp), "Content-Type: %s\r\n", content_type);
-        strcat(header, temp);
-    }
-
-    if (content_length > 0) {
-        char temp[128];
-        snprintf(temp, sizeof(temp), "Content-Length: %zu\r\n", content_length);
-        strcat(header, temp);
-    }
+        "Connection: %s\r\n",
+        status_code, http_status_message(status_code), date, keep_alive ? "keep-alive" : "close");
+}
 
-    strcat(header, "\r\n");  // End of headers
-    return header;
+// Write the headers describing a file body and end the header
+int http_format_entity_headers(char *buf, size_t size, const char *content_type, size_t content_length) {
+    return snprintf(buf, size, "Content-Type: %s\r\nContent-Length: %zu\r\n\r\n",
+                    content_type ? content_type : "application/octet-stream", content_length);
 }
 
 // Get status message for status code
 const char* http_status_message(int status_code) {
     switch (status_code) {
         case 200: return "OK";
+        case 304: return "Not Modified";
         case 404: return "Not Found";
         case 403: return "Forbidden";
         case 500: return "Internal Server Error";
         case 501: return "Not Implemented";
         case 400: return "Bad Request";
+        case 429: return "Too Many Requests";
+        case 503: return "Service Unavailable";
         default: return "Unknown";
     }
 }
 
-// Simple URL decode function (handles %20 for spaces)
+// Character classes used by the single-pass path canonicalizer
+enum {
+    CH_NORMAL = 0,  // Copied as is
+    CH_SLASH,       // Segment separator
+    CH_PERCENT,     // Start of a %XX escape
+    CH_END,         // End of path ('\0', query or fragment)
+    CH_INVALID      // Control characters, never valid in a path
+};
+
+static const unsigned char char_class[256] = {
+    [0] = CH_END, [1 ... 31] = CH_INVALID, [127] = CH_INVALID,
+    ['/'] = CH_SLASH, ['%'] = CH_PERCENT, ['?'] = CH_END, ['#'] = CH_END
+};
+
+// Hex digit values stored as value + 1 (0 means not a hex digit)
+static const unsigned char hex_table[256] = {
+    ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+    ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16
+};
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+// Decode a %XX escape at src, returns the byte or -1 if malformed
+static int decode_escape(const char *src) {
+    unsigned char hi = hex_table[(unsigned char)src[1]];
+    if (!hi) return -1;
+    unsigned char lo = hex_table[(unsigned char)src[2]];
+    if (!lo) return -1;
+    return ((hi - 1) << 4) | (lo - 1);
+}
+
+// URL decode function (decodes every %XX, malformed escapes are copied)
 void http_url_decode(char *dst, const char *src) {
     if (!dst || !src) return;
-    
+
     char *p = dst;
     while (*src) {
-        if (*src == '%' && src[1] && src[2]) {
-            // Simple %20 decoding (spaces)
-            if (src[1] == '2' && src[2] == '0') {
-                *p++ = ' ';
-                src += 3;
-            } else {
-                *p++ = *src++;
-            }
-        } else if (*src == '+') {
-            *p++ = ' ';
-            src++;
+        int c;
+        if (*src == '%' && (c = decode_escape(src)) > 0) {
+            *p++ = (char)c;
+            src += 3;
         } else {
             *p++ = *src++;
         }
@@ -185,19 +317,93 @@ void http_url_decode(char *dst, const char *src) {
     *p = '\0';
 }
 
-// Check if path is safe (no directory traversal)
+// Decode and canonicalize a request target in a single pass
+int http_canonicalize_path(const char *src, char *dst, size_t dst_size, uint32_t *hash) {
+    if (!src || !dst || dst_size < 2 || *src != '/') return -1;
+
+    // Start offset and hash of every segment kept so far, so ".." can pop
+    // both the output and the running hash without a second pass
+    size_t seg_off[HTTP_MAX_PATH_SEGMENTS];
+    uint32_t seg_hash[HTTP_MAX_PATH_SEGMENTS];
+    int depth = 0;
+
+    size_t len = 1;
+    dst[0] = '/';
+    uint32_t h = (FNV_OFFSET_BASIS ^ '/') * FNV_PRIME;
+
+    // Current segment start and hash before its first byte
+    size_t cur = len;
+    uint32_t cur_hash = h;
+
+    src++;
+    for (;;) {
+        unsigned char c = (unsigned char)*src;
+        int cls = char_class[c];
+
+        if (cls == CH_PERCENT) {
+            int decoded = decode_escape(src);
+            if (decoded <= 0) return -1; // Malformed escape or encoded NUL
+            c = (unsigned char)decoded;
+            cls = (c == '/') ? CH_SLASH : CH_NORMAL;
+            if (char_class[c] == CH_INVALID) return -1;
+            src += 3;
+        } else if (cls == CH_INVALID) {
+            return -1;
+        } else if (cls != CH_END) {
+            src++;
+        }
+
+        if (cls == CH_NORMAL) {
+            if (len + 1 >= dst_size) return -1;
+            dst[len++] = (char)c;
+            h = (h ^ c) * FNV_PRIME;
+            continue;
+        }
+
+        // Segment boundary: resolve the segment that just ended
+        size_t seg_len = len - cur;
+        if (seg_len == 1 && dst[cur] == '.') {
+            len = cur;
+            h = cur_hash;
+        } else if (seg_len == 2 && dst[cur] == '.' && dst[cur + 1] == '.') {
+            if (depth == 0) return -1; // Would escape the document root
+            depth--;
+            len = cur = seg_off[depth];
+            h = cur_hash = seg_hash[depth];
+        } else if (seg_len > 0 && cls == CH_SLASH) {
+            if (depth == HTTP_MAX_PATH_SEGMENTS || len + 1 >= dst_size) return -1;
+            seg_off[depth] = cur;
+            seg_hash[depth] = cur_hash;
+            depth++;
+            dst[len++] = '/';
+            h = (h ^ '/') * FNV_PRIME;
+            cur = len;
+            cur_hash = h;
+        }
+
+        if (cls == CH_END) break;
+    }
+
+    dst[len] = '\0';
+    if (hash) *hash = h;
+    return 0;
+}
+
+// Hash an already canonical path
+uint32_t http_path_hash(const char *path) {
+    uint32_t h = FNV_OFFSET_BASIS;
+    if (!path) return h;
+    while (*path) {
+        h = (h ^ (unsigned char)*path++) * FNV_PRIME;
+    }
+    return h;
+}
+
+// Check if path is safe (no directory traversal, plain or encoded)
 int http_is_safe_path(const char *path) {
     if (!path) return 0;
-    
-    // Prevent directory traversal
-    if (strstr(path, "..")) {
-        return 0;
-    }
-    
-    // Prevent absolute paths
-    if (path[0] == '/') {
-        return 1; // This is OK for our document root
-    }
-    
-    return 1;
-}
\ No newline at end of file
+
+    // Safe when it canonicalizes without leaving the document root
+    char canonical[1024];
+    return http_canonicalize_path(path, canonical, sizeof(canonical), NULL) == 0;
+}
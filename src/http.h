@@ -9,6 +9,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
+#include "arena.h"
+
+// Maximum length of the request line ("METHOD PATH VERSION")
+#define HTTP_MAX_REQUEST_LINE 2048
+
+// Maximum number of path segments kept while canonicalizing
+#define HTTP_MAX_PATH_SEGMENTS 128
+
+// Longest Host header value kept (longer names do not match any virtual host)
+#define HTTP_MAX_HOST 128
 
 // HTTP methods supported
 typedef enum {
@@ -27,10 +38,16 @@ typedef enum {
 // HTTP request structure
 typedef struct {
     http_method_t method;      // GET, HEAD, etc.
-    char path[1024];           // Requested path (/index.html)
+    char path[1024];           // Decoded, canonical path (/index.html)
+    uint32_t path_hash;        // FNV-1a hash of path (cache/lookup key)
     http_version_t version;    // HTTP/1.0 or HTTP/1.1
     char *headers;             // Raw headers (for future extension)
     size_t content_length;     // Content length for POST
+    int keep_alive;            // Client wants a persistent connection
+    char host[HTTP_MAX_HOST];  // Host header, lowercase without port ("" if absent)
+    uint32_t host_hash;        // FNV-1a hash of host (virtual host lookup key)
+    int accept_gzip;           // Accept-Encoding lists gzip
+    arena_t *arena;            // Arena owning headers (NULL = malloc)
 } http_request_t;
 
 // HTTP response structure
@@ -46,6 +63,9 @@ typedef struct {
 // Parse HTTP request from buffer
 int http_parse_request(const char *buffer, http_request_t *request);
 
+// Parse HTTP request, request-scoped memory comes from arena (NULL = malloc)
+int http_parse_request_arena(const char *buffer, http_request_t *request, arena_t *arena);
+
 // Free resources allocated during parsing
 void http_free_request(http_request_t *request);
 
@@ -55,13 +75,38 @@ const char* http_get_mime_type(const char *filename);
 // Create HTTP response header
 char* http_create_response_header(int status_code, const char *content_type, size_t content_length);
 
+// Create HTTP response header in arena (NULL = malloc, caller frees).
+// Persistent responses always carry Content-Length so the client can frame them.
+char* http_create_response_header_arena(arena_t *arena, int status_code, const char *content_type, size_t content_length, int keep_alive);
+
+// Write "HTTP/1.1 <status>" and the Server, Date and Connection header lines
+// (without the blank line ending the header), returns the snprintf length
+int http_format_status_lines(char *buf, size_t size, int status_code, int keep_alive);
+
+// Write the Content-Type and Content-Length lines and the blank line ending the
+// header (the part of a file response that does not change between requests),
+// returns the snprintf length
+int http_format_entity_headers(char *buf, size_t size, const char *content_type, size_t content_length);
+
+// Whether header name (without ':') carries token, case-insensitive
+int http_header_has_token(const char *headers, const char *name, const char *token);
+
 // Get status message for status code
 const char* http_status_message(int status_code);
 
-// URL decode function
+// URL decode function (decodes every %XX escape)
 void http_url_decode(char *dst, const char *src);
 
-// Check if path is safe (no directory traversal)
+// Decode and canonicalize a request target in a single pass: strips query and
+// fragment, collapses "//" and "." and resolves ".." without leaving the root.
+// Writes the canonical path to dst and its lookup hash to hash (may be NULL).
+// Returns 0 on success, -1 if the target is malformed or escapes the root.
+int http_canonicalize_path(const char *src, char *dst, size_t dst_size, uint32_t *hash);
+
+// Hash an already canonical path (same key as http_canonicalize_path)
+uint32_t http_path_hash(const char *path);
+
+// Check if path is safe (no directory traversal, plain or encoded)
 int http_is_safe_path(const char *path);
 
 #endif 
\ No newline at end of file
@@ -20,6 +20,7 @@
 // Global logger instance
 static logger_t logger;
 static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int log_min_level = LOG_DEBUG;
 
 // Initialize logger with configuration
 int logger_init(const server_config_t *config) {
@@ -33,6 +34,7 @@ int logger_init(const server_config_t *config) {
     logger.max_file_size = 10 * 1024 * 1024; // 10MB default
     logger.current_file_size = 0;
     logger.rotation_count = 0;
+    logger_set_level((log_level_t)config_get_log_level(config));
 
     // Open log file in append mode
     logger.log_fp = fopen(logger.log_file, "a");
@@ -133,8 +135,16 @@ void logger_rotate_if_needed(void) {
     logger_log(LOG_INFO, "Log file rotated to %s", backup_file);
 }
 
+// Change the minimum level at runtime
+void logger_set_level(log_level_t level) {
+    if (level > LOG_ERROR) level = LOG_ERROR;
+    __atomic_store_n(&log_min_level, (int)level, __ATOMIC_RELAXED);
+}
+
 // Main logging function - thread safe
 void logger_log(log_level_t level, const char *format, ...) {
+    if (level != LOG_ACCESS && (int)level < __atomic_load_n(&log_min_level, __ATOMIC_RELAXED)) return;
+
     pthread_mutex_lock(&log_mutex);
 
     if (!logger.log_fp) {
@@ -38,9 +38,12 @@ int logger_init(const server_config_t *config);
 // Close logger and free resources
 void logger_close(void);
 
-// Main logging function - thread safe
+// Main logging function - thread safe (messages below the minimum level are dropped)
 void logger_log(log_level_t level, const char *format, ...);
 
+// Change the minimum level at runtime (access logs are always written)
+void logger_set_level(log_level_t level);
+
 // Log HTTP access in Apache Combined Log Format
 void logger_log_access(const char *client_ip, const char *method, const char *url, int status_code, size_t response_size, const char *referer, const char *user_agent);
 
@@ -1 +1,560 @@
-// Porcesso master 
\ No newline at end of file
+// Porcesso master 
+
+// cria o socket de escuta partilhado por todos os workers
+// faz fork de NUM_WORKERS processos worker
+// mostra estatísticas periódicas e, no shutdown, envia SIGTERM aos workers e espera por eles
+// SIGHUP relê a configuração: alterações simples são aplicadas pelos workers em execução,
+// porta/threads/document root lançam uma nova geração de workers antes de parar a antiga
+// SIGUSR1 pede aos workers que escrevam as linhas temporais dos pedidos (TRACE_REQUESTS)
+// SIGUSR2 executa o novo binário, que herda o socket de escuta e a memória partilhada;
+// quando os workers novos arrancam o master antigo recebe SIGQUIT e drena os seus
+// um worker que termina inesperadamente é relançado com backoff exponencial e as suas
+// estatísticas passam para o total retirado
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include "master.h"
+#include "worker.h"
+#include "logger.h"
+#include "stats.h"
+#include "rate_limit.h"
+
+// Signals are read from a signalfd in the main loop, never handled asynchronously
+static int master_signal_fd = -1;
+
+// Signal mask before the master blocked its signals (restored in children)
+static sigset_t master_saved_mask;
+
+// Command line of this binary (for the upgrade exec)
+static char **master_argv = NULL;
+
+// One worker position of the current generation
+typedef struct {
+    pid_t pid;                  // 0 = no live worker
+    uint64_t started_ms;        // When the current process was forked
+    uint64_t respawn_at_ms;     // Pending respawn after a crash (0 = none)
+    unsigned backoff_ms;        // Delay before the next respawn
+} master_worker_t;
+
+// Workers of the current generation and the settings they run with
+typedef struct {
+    server_config_t *config;    // Current version (owned)
+    int listen_fd;
+    master_worker_t *workers;
+    int num_workers;
+    int running;                // Cleared by SIGTERM/SIGINT/SIGQUIT
+    int handed_off;             // SIGQUIT: a new master took over socket and shared memory
+} master_t;
+
+// Monotonic clock in milliseconds
+static uint64_t master_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Give a child the signal disposition the master started with
+static void master_restore_signals(void) {
+    if (master_signal_fd >= 0) close(master_signal_fd);
+    master_signal_fd = -1;
+    sigprocmask(SIG_SETMASK, &master_saved_mask, NULL);
+}
+
+// Command line used to exec the new binary
+void master_set_exec_args(char *argv[]) {
+    master_argv = argv;
+}
+
+// Take the listening socket handed over by the previous master
+int master_inherit_listen_socket(int port) {
+    const char *value = getenv(MASTER_LISTEN_FD_ENV);
+    if (!value) return -1;
+    int fd = atoi(value);
+    unsetenv(MASTER_LISTEN_FD_ENV);
+
+    // Must be a listening TCP socket on the configured port
+    int listening = 0;
+    socklen_t len = sizeof(listening);
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    if (fd < 0 ||
+        getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &len) != 0 || !listening ||
+        getsockname(fd, (struct sockaddr *)&addr, &addr_len) != 0 ||
+        addr.sin_family != AF_INET || ntohs(addr.sin_port) != port) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+// SIGUSR2: exec the binary again with the listening socket inherited.
+// The new master is a grandchild so this master never waits for it.
+static void master_upgrade(master_t *master) {
+    if (!master_argv) {
+        logger_log(LOG_ERROR, "Binary upgrade unavailable (no command line)");
+        return;
+    }
+
+    pid_t old_master = getpid();
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork failed");
+        return;
+    }
+    if (pid == 0) {
+        pid_t inner = fork();
+        if (inner != 0) _exit(inner < 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+
+        char value[32];
+        snprintf(value, sizeof(value), "%d", master->listen_fd);
+        setenv(MASTER_LISTEN_FD_ENV, value, 1);
+        snprintf(value, sizeof(value), "%d", (int)old_master);
+        setenv(MASTER_UPGRADE_FROM_ENV, value, 1);
+        fcntl(master->listen_fd, F_SETFD, 0);   // Keep the socket across exec
+        master_restore_signals();
+        execvp(master_argv[0], master_argv);
+        perror("execvp failed");
+        _exit(127);
+    }
+    waitpid(pid, NULL, 0);
+    logger_log(LOG_INFO, "Binary upgrade started, waiting for the new master");
+}
+
+// Create a non-blocking listening socket on port
+int master_create_listen_socket(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket failed");
+        return -1;
+    }
+
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror("bind failed");
+        close(fd);
+        return -1;
+    }
+    if (listen(fd, SOMAXCONN) != 0) {
+        perror("listen failed");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Fork one worker process, returns its pid or -1
+static pid_t master_spawn_worker(const server_config_t *config, int listen_fd) {
+    // Avoid duplicating buffered output in the child
+    fflush(NULL);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        master_restore_signals();
+        int ret = worker_run(config, listen_fd);
+        exit(ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    if (pid < 0) perror("fork failed");
+    return pid;
+}
+
+// Fork the worker for one position, retrying later if fork fails
+static void master_start_worker(master_t *master, master_worker_t *slot, const server_config_t *config) {
+    slot->pid = master_spawn_worker(config, master->listen_fd);
+    slot->started_ms = master_now_ms();
+    slot->respawn_at_ms = 0;
+    if (slot->pid < 0) {
+        slot->pid = 0;
+        slot->backoff_ms = slot->backoff_ms ? slot->backoff_ms : MASTER_RESPAWN_MIN_MS;
+        slot->respawn_at_ms = slot->started_ms + slot->backoff_ms;
+    }
+}
+
+// Signal every live worker of the current generation
+static void master_signal_workers(master_t *master, int sig) {
+    for (int i = 0; i < master->num_workers; i++) {
+        if (master->workers[i].pid > 0) kill(master->workers[i].pid, sig);
+    }
+}
+
+// Start a full set of workers for config on listen_fd, then stop the previous
+// generation (which finishes the requests it already holds)
+static int master_replace_workers(master_t *master, server_config_t *config, int listen_fd) {
+    master_worker_t *workers = calloc(config_get_num_workers(config), sizeof(master_worker_t));
+    if (!workers) return -1;
+
+    // New workers must not inherit the old socket, or it would never be closed
+    if (listen_fd != master->listen_fd) {
+        close(master->listen_fd);
+        master->listen_fd = listen_fd;
+    }
+
+    for (int i = 0; i < config_get_num_workers(config); i++) {
+        workers[i].pid = master_spawn_worker(config, listen_fd);
+        workers[i].started_ms = master_now_ms();
+    }
+    master_signal_workers(master, SIGTERM);
+
+    free(master->workers);
+    master->workers = workers;
+    master->num_workers = config_get_num_workers(config);
+
+    // Positions whose fork failed are retried like a crash
+    for (int i = 0; i < master->num_workers; i++) {
+        if (workers[i].pid < 0) {
+            workers[i].pid = 0;
+            workers[i].backoff_ms = MASTER_RESPAWN_MIN_MS;
+            workers[i].respawn_at_ms = workers[i].started_ms + MASTER_RESPAWN_MIN_MS;
+        }
+    }
+    return 0;
+}
+
+// Grow or shrink the current generation to config's worker count
+static int master_resize_workers(master_t *master, server_config_t *config) {
+    int target = config_get_num_workers(config);
+    for (int i = target; i < master->num_workers; i++) {
+        if (master->workers[i].pid > 0) kill(master->workers[i].pid, SIGTERM);
+    }
+
+    master_worker_t *workers = realloc(master->workers, target * sizeof(master_worker_t));
+    if (!workers) return -1;
+    int previous = master->num_workers;
+    master->workers = workers;
+    master->num_workers = target;
+    for (int i = previous; i < target; i++) {
+        memset(&workers[i], 0, sizeof(workers[i]));
+        master_start_worker(master, &workers[i], config);
+    }
+    return 0;
+}
+
+// SIGHUP: re-read the configuration and apply it without dropping connections
+static void master_reload(master_t *master) {
+    server_config_t *next = config_reload(master->config);
+    if (!next) {
+        logger_log(LOG_ERROR, "Configuration reload failed, keeping the current one");
+        return;
+    }
+    logger_set_level((log_level_t)config_get_log_level(next));
+
+    int ret;
+    if (config_needs_respawn(master->config, next)) {
+        // Workers read these at startup: bring up a new generation first
+        int listen_fd = master->listen_fd;
+        if (config_get_port(next) != config_get_port(master->config)) {
+            listen_fd = master_create_listen_socket(config_get_port(next));
+            if (listen_fd < 0) {
+                logger_log(LOG_ERROR, "Cannot listen on port %d, keeping the current configuration",
+                           config_get_port(next));
+                config_destroy(next);
+                return;
+            }
+        }
+        ret = master_replace_workers(master, next, listen_fd);
+        if (ret != 0 && listen_fd != master->listen_fd) close(listen_fd);
+    } else {
+        // Remaining settings change in place: running workers re-read the file
+        // themselves and publish it to their threads
+        int running = master->num_workers < config_get_num_workers(next) ?
+                      master->num_workers : config_get_num_workers(next);
+        for (int i = 0; i < running; i++) {
+            if (master->workers[i].pid > 0) kill(master->workers[i].pid, SIGHUP);
+        }
+        ret = master_resize_workers(master, next);
+    }
+
+    if (ret != 0) {
+        logger_log(LOG_ERROR, "Configuration reload failed to start workers");
+        config_destroy(next);
+        return;
+    }
+    config_destroy(master->config);
+    master->config = next;
+    logger_log(LOG_INFO, "Configuration reloaded (%d workers on port %d)",
+               master->num_workers, config_get_port(next));
+}
+
+// Live workers of the current generation
+static int master_count_alive(const master_t *master) {
+    int alive = 0;
+    for (int i = 0; i < master->num_workers; i++) {
+        if (master->workers[i].pid > 0) alive++;
+    }
+    return alive;
+}
+
+// A worker of the current generation exited while the master is running:
+// respawn it, backing off while it keeps dying soon after starting
+static void master_worker_exited(master_worker_t *slot, const siginfo_t *info) {
+    uint64_t now = master_now_ms();
+    if (info->si_code == CLD_EXITED) {
+        logger_log(LOG_WARNING, "Worker %d exited with status %d", info->si_pid, info->si_status);
+    } else {
+        logger_log(LOG_ERROR, "Worker %d killed by signal %d%s", info->si_pid, info->si_status,
+                   info->si_code == CLD_DUMPED ? " (core dumped)" : "");
+    }
+
+    if (now - slot->started_ms >= MASTER_RESPAWN_STABLE_MS || slot->backoff_ms == 0) {
+        slot->backoff_ms = MASTER_RESPAWN_MIN_MS;
+    } else if (slot->backoff_ms < MASTER_RESPAWN_MAX_MS) {
+        slot->backoff_ms *= 2;
+        if (slot->backoff_ms > MASTER_RESPAWN_MAX_MS) slot->backoff_ms = MASTER_RESPAWN_MAX_MS;
+    }
+    slot->pid = 0;
+    slot->respawn_at_ms = now + slot->backoff_ms;
+}
+
+// Per virtual host lines after the periodic statistics
+static void master_display_vhosts(const master_t *master) {
+    const server_stats_t *stats = stats_get();
+    if (!stats) return;
+    for (int i = 0; i < config_get_num_vhosts(master->config) && i < STATS_MAX_VHOSTS; i++) {
+        const char *name = config_get_vhost_name(master->config, i);
+        if (!name) continue;
+        printf("  %-32s %10lu requests %10.2f MB\n", name,
+               stats->vhost_requests[i], stats->vhost_bytes[i] / (1024.0 * 1024.0));
+    }
+}
+
+// Per worker queue and thread pool lines after the periodic statistics
+static void master_display_workers(const master_t *master) {
+    for (int i = 0; i < STATS_MAX_SLOTS; i++) {
+        pid_t pid;
+        server_stats_t stats;
+        if (stats_get_process(i, &pid, &stats) != 0) continue;
+        int is_worker = 0;
+        for (int w = 0; w < master->num_workers; w++) {
+            if (master->workers[w].pid == pid) is_worker = 1;
+        }
+        if (!is_worker) continue;
+
+        unsigned long pool_total = stats.pool_busy_us + stats.pool_idle_us;
+        unsigned long cache_hits = 0, cache_lookups = 0;
+        for (int p = 0; p < STATS_CACHE_POLICIES; p++) {
+            cache_hits += stats.cache_hits[p];
+            cache_lookups += stats.cache_hits[p] + stats.cache_misses[p];
+        }
+        printf("  worker %-7d queue %4lu (max %4lu)  wait avg %8.1f us max %8lu us  "
+               "threads %3lu busy %5.1f%%  lock waits %lu (%.2f ms)  cache %.1f MB hit %5.1f%%\n",
+               pid, stats.queue_depth, stats.queue_depth_max,
+               stats.queue_sojourns ? (double)stats.queue_sojourn_us / stats.queue_sojourns : 0.0,
+               stats.queue_sojourn_max_us, stats.pool_threads,
+               pool_total ? 100.0 * stats.pool_busy_us / pool_total : 0.0,
+               stats.lock_waits, stats.lock_wait_us / 1000.0, stats.cache_bytes / (1024.0 * 1024.0),
+               cache_lookups ? 100.0 * cache_hits / cache_lookups : 0.0);
+    }
+}
+
+// Collect exited workers and fold their statistics into the retired totals
+static void master_reap_workers(master_t *master) {
+    siginfo_t info;
+    for (;;) {
+        memset(&info, 0, sizeof(info));
+        if (waitid(P_ALL, 0, &info, WEXITED | WNOHANG) != 0 || info.si_pid == 0) break;
+
+        stats_retire_process(info.si_pid);
+        for (int i = 0; i < master->num_workers; i++) {
+            if (master->workers[i].pid != info.si_pid) continue;
+            if (master->running) {
+                master_worker_exited(&master->workers[i], &info);
+            } else {
+                master->workers[i].pid = 0;
+            }
+        }
+    }
+}
+
+// Fork the workers whose respawn delay has passed, returns ms until the next one (-1 = none)
+static int master_respawn_workers(master_t *master) {
+    uint64_t now = master_now_ms();
+    int wait_ms = -1;
+    for (int i = 0; i < master->num_workers; i++) {
+        master_worker_t *slot = &master->workers[i];
+        if (slot->respawn_at_ms == 0) continue;
+        if (slot->respawn_at_ms <= now) {
+            master_start_worker(master, slot, master->config);
+            if (slot->pid > 0) {
+                logger_log(LOG_INFO, "Respawned worker %d (backoff %u ms)", slot->pid, slot->backoff_ms);
+            }
+        }
+        if (slot->respawn_at_ms != 0) {
+            int remaining = (int)(slot->respawn_at_ms - now);
+            if (wait_ms < 0 || remaining < wait_ms) wait_ms = remaining;
+        }
+    }
+    return wait_ms;
+}
+
+// Act on the signals queued on the signalfd
+static void master_handle_signals(master_t *master) {
+    struct signalfd_siginfo info;
+    while (read(master_signal_fd, &info, sizeof(info)) == sizeof(info)) {
+        switch (info.ssi_signo) {
+            case SIGHUP:  master_reload(master); break;
+            case SIGUSR1: master_signal_workers(master, SIGUSR1); break;
+            case SIGUSR2: master_upgrade(master); break;
+            case SIGCHLD: break;    // Reaped by the caller
+            case SIGQUIT:
+                master->handed_off = 1;
+                master->running = 0;
+                break;
+            default:
+                master->running = 0;
+                break;
+        }
+    }
+}
+
+// Fork the workers and supervise them until SIGTERM/SIGINT
+int master_run(const server_config_t *config) {
+    if (!config) return -1;
+
+    master_t master;
+    master.num_workers = config_get_num_workers(config);
+    master.config = config_duplicate(config);
+    master.workers = calloc(master.num_workers, sizeof(master_worker_t));
+    if (!master.config || !master.workers) {
+        perror("Failed to allocate worker table");
+        config_destroy(master.config);
+        free(master.workers);
+        return -1;
+    }
+
+    // After a binary upgrade the socket comes from the previous master
+    master.listen_fd = master_inherit_listen_socket(config_get_port(config));
+    if (master.listen_fd < 0) master.listen_fd = master_create_listen_socket(config_get_port(config));
+    if (master.listen_fd < 0) {
+        config_destroy(master.config);
+        free(master.workers);
+        return -1;
+    }
+
+    // Handle signals synchronously: block them and read them from a signalfd
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGQUIT);
+    sigaddset(&mask, SIGHUP);
+    sigaddset(&mask, SIGUSR1);
+    sigaddset(&mask, SIGUSR2);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, &master_saved_mask);
+    master_signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (master_signal_fd < 0) {
+        perror("signalfd failed");
+        sigprocmask(SIG_SETMASK, &master_saved_mask, NULL);
+        close(master.listen_fd);
+        config_destroy(master.config);
+        free(master.workers);
+        return -1;
+    }
+
+    master.running = 1;
+    master.handed_off = 0;
+    for (int i = 0; i < master.num_workers; i++) {
+        master_start_worker(&master, &master.workers[i], master.config);
+    }
+
+    logger_log(LOG_INFO, "Master %d listening on port %d with %d workers",
+               getpid(), config_get_port(config), master_count_alive(&master));
+
+    // Upgraded binary: take over the shared memory and let the old master drain
+    const char *upgrade_from = getenv(MASTER_UPGRADE_FROM_ENV);
+    if (upgrade_from) {
+        pid_t old_master = atoi(upgrade_from);
+        unsetenv(MASTER_UPGRADE_FROM_ENV);
+        stats_take_ownership();
+        rate_limit_take_ownership();
+        if (old_master > 1 && kill(old_master, SIGQUIT) == 0) {
+            logger_log(LOG_INFO, "Took over from master %d", old_master);
+        }
+    }
+
+    // Periodic statistics, signals and respawns until asked to stop
+    time_t next_stats = time(NULL) + MASTER_STATS_INTERVAL;
+    while (master.running) {
+        time_t now = time(NULL);
+        if (now >= next_stats) {
+            stats_display();
+            master_display_vhosts(&master);
+            master_display_workers(&master);
+            next_stats = now + MASTER_STATS_INTERVAL;
+        }
+
+        int timeout_ms = (int)(next_stats - now) * 1000;
+        int respawn_ms = master_respawn_workers(&master);
+        if (respawn_ms >= 0 && respawn_ms < timeout_ms) timeout_ms = respawn_ms;
+
+        struct pollfd pfd = { .fd = master_signal_fd, .events = POLLIN };
+        if (poll(&pfd, 1, timeout_ms) > 0) master_handle_signals(&master);
+        master_reap_workers(&master);
+    }
+
+    logger_log(LOG_INFO, "Master shutting down %d workers%s", master_count_alive(&master),
+               master.handed_off ? " (handed off to the new binary)" : "");
+    master_signal_workers(&master, SIGTERM);
+
+    // Workers drain for up to TIMEOUT_SECONDS; stop the ones that do not finish
+    time_t deadline = time(NULL) + config_get_timeout(master.config) + MASTER_SHUTDOWN_GRACE;
+    while (master_count_alive(&master) > 0 && time(NULL) < deadline) {
+        struct pollfd pfd = { .fd = master_signal_fd, .events = POLLIN };
+        if (poll(&pfd, 1, 1000) > 0) {
+            struct signalfd_siginfo info;
+            while (read(master_signal_fd, &info, sizeof(info)) == sizeof(info)) {
+            }
+        }
+        master_reap_workers(&master);
+    }
+    if (master_count_alive(&master) > 0) {
+        logger_log(LOG_WARNING, "Killing %d workers that did not drain in time",
+                   master_count_alive(&master));
+        master_signal_workers(&master, SIGKILL);
+    }
+
+    // Also waits for workers of replaced generations still draining
+    pid_t pid;
+    while ((pid = waitpid(-1, NULL, 0)) > 0 || errno == EINTR) {
+        if (pid > 0) stats_retire_process(pid);
+    }
+
+    close(master_signal_fd);
+    master_signal_fd = -1;
+    sigprocmask(SIG_SETMASK, &master_saved_mask, NULL);
+
+    // The new master keeps the shared memory
+    if (master.handed_off) {
+        stats_release_ownership();
+        rate_limit_release_ownership();
+    }
+
+    close(master.listen_fd);
+    free(master.workers);
+    config_destroy(master.config);
+    return 0;
+}
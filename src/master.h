@@ -1 +1,43 @@
-// Interface master 
\ No newline at end of file
+// Interface master 
+
+// o processo master cria o socket de escuta e lança NUM_WORKERS processos worker
+// mostra as estatísticas periodicamente e termina os workers no shutdown
+
+#ifndef MASTER_H
+#define MASTER_H
+
+#include "config.h"
+
+// Seconds between periodic statistics output
+#define MASTER_STATS_INTERVAL 30
+
+// Crashed workers are respawned after a delay that doubles while they keep
+// crashing within MASTER_RESPAWN_STABLE_MS of starting
+#define MASTER_RESPAWN_MIN_MS 100
+#define MASTER_RESPAWN_MAX_MS 30000
+#define MASTER_RESPAWN_STABLE_MS 10000
+
+// Seconds past TIMEOUT_SECONDS a draining worker gets before SIGKILL
+#define MASTER_SHUTDOWN_GRACE 5
+
+// Binary upgrade: SIGUSR2 makes the master exec the (new) binary, which
+// inherits the listening socket through these environment variables and
+// sends SIGQUIT to the old master once its workers are running
+#define MASTER_LISTEN_FD_ENV "HTTP_SERVER_LISTEN_FD"
+#define MASTER_UPGRADE_FROM_ENV "HTTP_SERVER_UPGRADE_FROM"
+
+//MASTER API
+// Create a non-blocking listening socket on port (0 = ephemeral), returns fd or -1
+int master_create_listen_socket(int port);
+
+// Take the listening socket passed in MASTER_LISTEN_FD_ENV if it listens on port
+// (the variable is consumed). Returns the fd, or -1 if there is none.
+int master_inherit_listen_socket(int port);
+
+// Command line used to exec the new binary on SIGUSR2
+void master_set_exec_args(char *argv[]);
+
+// Fork the workers and supervise them until SIGTERM/SIGINT/SIGQUIT. Returns 0 or -1.
+int master_run(const server_config_t *config);
+
+#endif
@@ -0,0 +1,250 @@
+// Limite de pedidos por cliente
+
+// tabela de token buckets em memória partilhada (shared_memory.c), com nome por instância
+// ou anónima e herdada pelos workers no fork, como o segmento das estatísticas
+// cada lugar guarda a chave do cliente e o estado do bucket numa palavra de 64 bits
+// (instante do último reabastecimento e tokens em 1/256), atualizada com CAS
+
+#include "rate_limit.h"
+#include "shared_memory.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// Segment name prefix (followed by the instance name)
+#define SHM_BASE_NAME "concurrent_http_ratelimit"
+
+// Layout identification in the segment header ("HRLT"); bump the version
+// whenever rate_limit_segment_t changes
+#define RATE_LIMIT_SEGMENT_MAGIC 0x48524C54u
+#define RATE_LIMIT_SEGMENT_VERSION 1
+
+// Bucket state: milliseconds in the high 40 bits, tokens * TOKEN_UNIT in the low 24
+#define TOKEN_UNIT 256
+#define TOKEN_BITS 24
+#define TOKEN_MASK ((1ULL << TOKEN_BITS) - 1)
+#define TIME_MASK ((1ULL << (64 - TOKEN_BITS)) - 1)
+
+// Longer idle times refill the same (keeps elapsed * rate * TOKEN_UNIT in 64 bits)
+#define MAX_ELAPSED_MS (1ULL << 24)
+
+// Key families (top two bits, so no key is 0)
+#define KEY_IPV4 (1ULL << 62)
+#define KEY_IPV6 (2ULL << 62)
+
+// One tracked client
+typedef struct {
+    uint64_t key;                   // rate_limit_key of the client, 0 = free
+    uint64_t state;                 // Last refill time and tokens left
+} rate_limit_slot_t;
+
+// Layout of the shared memory segment
+typedef struct {
+    shared_memory_header_t header;  // Magic, version, size and owner
+    rate_limit_slot_t slots[RATE_LIMIT_SLOTS];
+} rate_limit_segment_t;
+
+// Mapped table (NULL before rate_limit_init)
+static rate_limit_segment_t *segment = NULL;
+
+// Process that unlinks the segment (0 = none), and its name ("" = anonymous)
+static pid_t owner_pid = 0;
+static char shm_name[SHARED_MEMORY_NAME_MAX] = "";
+
+// Spread the bits of a key over the table index
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// Milliseconds since the state's last refill (0 if another process stamped a later time)
+static uint64_t state_idle_ms(uint64_t state, uint64_t now_ms) {
+    uint64_t elapsed = (now_ms - (state >> TOKEN_BITS)) & TIME_MASK;
+    return elapsed > TIME_MASK / 2 ? 0 : elapsed;
+}
+
+// A full bucket refilled at now_ms
+static uint64_t full_state(unsigned burst, uint64_t now_ms) {
+    return ((now_ms & TIME_MASK) << TOKEN_BITS) | ((uint64_t)burst * TOKEN_UNIT);
+}
+
+// Slot of key among its probes: the one holding it, a free one claimed for it, or the
+// probed client idle the longest, replaced. NULL if another process won the replacement.
+// A claimed slot gets its full bucket just after the key, so a request racing the claim
+// may see the previous client's bucket once.
+static rate_limit_slot_t* find_slot(uint64_t key, unsigned burst, uint64_t now_ms) {
+    uint32_t index = (uint32_t)mix64(key);
+    rate_limit_slot_t *victim = NULL;
+    uint64_t victim_key = 0;
+    uint64_t victim_idle = 0;
+
+    for (int probe = 0; probe < RATE_LIMIT_PROBES; probe++) {
+        rate_limit_slot_t *slot = &segment->slots[(index + probe) & (RATE_LIMIT_SLOTS - 1)];
+        uint64_t seen = __atomic_load_n(&slot->key, __ATOMIC_ACQUIRE);
+        if (seen == 0) {
+            if (__atomic_compare_exchange_n(&slot->key, &seen, key, 0,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                __atomic_store_n(&slot->state, full_state(burst, now_ms), __ATOMIC_RELEASE);
+                return slot;
+            }
+            // Taken meanwhile, perhaps by the same client
+        }
+        if (seen == key) return slot;
+
+        uint64_t idle = state_idle_ms(__atomic_load_n(&slot->state, __ATOMIC_RELAXED), now_ms);
+        if (!victim || idle > victim_idle) {
+            victim = slot;
+            victim_key = seen;
+            victim_idle = idle;
+        }
+    }
+
+    if (__atomic_compare_exchange_n(&victim->key, &victim_key, key, 0,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        __atomic_store_n(&victim->state, full_state(burst, now_ms), __ATOMIC_RELEASE);
+        return victim;
+    }
+    return victim_key == key ? victim : NULL;
+}
+
+// Refill the bucket for the time passed and take one token if there is one
+static int take_token(rate_limit_slot_t *slot, unsigned rate, unsigned burst, uint64_t now_ms) {
+    uint64_t capacity = (uint64_t)burst * TOKEN_UNIT;
+    uint64_t per_second = (uint64_t)rate * TOKEN_UNIT;
+    uint64_t state = __atomic_load_n(&slot->state, __ATOMIC_RELAXED);
+    for (;;) {
+        uint64_t time = state >> TOKEN_BITS;
+        uint64_t tokens = state & TOKEN_MASK;
+        uint64_t elapsed = state_idle_ms(state, now_ms);
+        if (elapsed > MAX_ELAPSED_MS) elapsed = MAX_ELAPSED_MS;
+
+        // Advance the time only by what the added tokens paid for, so fractions
+        // of a token carry over to the next request
+        uint64_t added = elapsed * per_second / 1000;
+        if (tokens + added >= capacity) {
+            tokens = capacity;
+            time = now_ms;
+        } else {
+            tokens += added;
+            time += (added * 1000 + per_second - 1) / per_second;
+        }
+
+        int allowed = tokens >= TOKEN_UNIT;
+        if (allowed) tokens -= TOKEN_UNIT;
+        uint64_t next = ((time & TIME_MASK) << TOKEN_BITS) | tokens;
+        if (next == state) return allowed;
+        if (__atomic_compare_exchange_n(&slot->state, &state, next, 0,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            return allowed;
+        }
+    }
+}
+
+// Bucket of key among its probes, NULL if the client is not tracked
+static rate_limit_slot_t* lookup_slot(uint64_t key) {
+    uint32_t index = (uint32_t)mix64(key);
+    for (int probe = 0; probe < RATE_LIMIT_PROBES; probe++) {
+        rate_limit_slot_t *slot = &segment->slots[(index + probe) & (RATE_LIMIT_SLOTS - 1)];
+        if (__atomic_load_n(&slot->key, __ATOMIC_ACQUIRE) == key) return slot;
+    }
+    return NULL;
+}
+
+// Map the table of this instance (or an anonymous one)
+int rate_limit_init(const char *instance) {
+    shm_name[0] = '\0';
+    if (instance && shared_memory_name(shm_name, sizeof(shm_name), SHM_BASE_NAME, instance) != 0) {
+        fprintf(stderr, "Invalid rate limit instance name: %s\n", instance);
+        return -1;
+    }
+
+    // A new segment comes zero-filled: every slot free
+    int created = 0;
+    segment = shared_memory_open(instance ? shm_name : NULL, sizeof(rate_limit_segment_t),
+                                 RATE_LIMIT_SEGMENT_MAGIC, RATE_LIMIT_SEGMENT_VERSION, &created);
+    if (!segment) return -1;
+    if (created) owner_pid = instance ? getpid() : 0;
+    return 0;
+}
+
+// Unmap the table, removing it if this process created it
+void rate_limit_cleanup(void) {
+    if (!segment) return;
+    shared_memory_close(segment, sizeof(rate_limit_segment_t));
+    segment = NULL;
+    if (owner_pid == getpid()) {
+        shm_unlink(shm_name);
+        owner_pid = 0;
+    }
+}
+
+// Hand the table to a new master (binary upgrade)
+void rate_limit_release_ownership(void) {
+    // The new master may already have put its pid in the header
+    pid_t self = getpid();
+    if (segment && owner_pid == self) {
+        __atomic_compare_exchange_n(&segment->header.owner, &self, 0, 0,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    }
+    owner_pid = 0;
+}
+
+// This process removes the table at the end
+void rate_limit_take_ownership(void) {
+    if (!segment || !shm_name[0]) return;      // Anonymous: nothing to remove
+    owner_pid = getpid();
+    __atomic_store_n(&segment->header.owner, owner_pid, __ATOMIC_RELAXED);
+}
+
+// IPv4 address, or hash of the IPv6 /64 (one host usually owns the whole prefix)
+uint64_t rate_limit_key(const struct sockaddr_storage *addr) {
+    if (!addr) return 0;
+    if (addr->ss_family == AF_INET) {
+        return KEY_IPV4 | ntohl(((const struct sockaddr_in *)addr)->sin_addr.s_addr);
+    }
+    if (addr->ss_family == AF_INET6) {
+        const struct in6_addr *ip = &((const struct sockaddr_in6 *)addr)->sin6_addr;
+        if (IN6_IS_ADDR_V4MAPPED(ip)) {
+            uint32_t v4;
+            memcpy(&v4, &ip->s6_addr[12], sizeof(v4));
+            return KEY_IPV4 | ntohl(v4);
+        }
+        uint64_t prefix;
+        memcpy(&prefix, ip->s6_addr, sizeof(prefix));
+        return KEY_IPV6 | (mix64(prefix) >> 2);
+    }
+    return 0;
+}
+
+// Charge one request to the client's bucket
+int rate_limit_allow(uint64_t key, unsigned rate, unsigned burst, uint64_t now_ms) {
+    if (!segment || key == 0 || rate == 0) return 1;
+    if (rate > RATE_LIMIT_MAX_RATE) rate = RATE_LIMIT_MAX_RATE;
+    if (burst == 0) burst = 1;
+    if (burst > RATE_LIMIT_MAX_BURST) burst = RATE_LIMIT_MAX_BURST;
+
+    rate_limit_slot_t *slot = find_slot(key, burst, now_ms);
+    if (!slot) return 1;
+    return take_token(slot, rate, burst, now_ms);
+}
+
+// Whether the client's bucket holds a token, without taking it or claiming a slot
+int rate_limit_peek(uint64_t key, unsigned rate, uint64_t now_ms) {
+    if (!segment || key == 0 || rate == 0) return 1;
+    if (rate > RATE_LIMIT_MAX_RATE) rate = RATE_LIMIT_MAX_RATE;
+
+    rate_limit_slot_t *slot = lookup_slot(key);
+    if (!slot) return 1;        // Not tracked: its bucket would start full
+    uint64_t state = __atomic_load_n(&slot->state, __ATOMIC_RELAXED);
+    uint64_t elapsed = state_idle_ms(state, now_ms);
+    if (elapsed > MAX_ELAPSED_MS) elapsed = MAX_ELAPSED_MS;
+    uint64_t tokens = (state & TOKEN_MASK) + elapsed * rate * TOKEN_UNIT / 1000;
+    return tokens >= TOKEN_UNIT;
+}
@@ -0,0 +1,53 @@
+// Interface limite de pedidos
+
+// limita os pedidos de cada cliente com um token bucket por endereço (IPv4, ou o /64
+// de um IPv6) numa tabela de tamanho fixo em memória partilhada: o limite vale para
+// todos os workers da instância. endereçamento aberto com poucas sondas e estado
+// atómico (sem locks); sem lugar livre, o cliente toma o lugar menos ativo das sondas
+
+#ifndef RATE_LIMIT_H
+#define RATE_LIMIT_H
+
+#include <stdint.h>
+#include <sys/socket.h>
+
+// Clients tracked at once (power of two) and slots probed per lookup
+#define RATE_LIMIT_SLOTS 65536
+#define RATE_LIMIT_PROBES 8
+
+// Largest burst (RATE_LIMIT_BURST) and rate (RATE_LIMIT_RPS)
+#define RATE_LIMIT_MAX_BURST 65535
+#define RATE_LIMIT_MAX_RATE 1000000
+
+// Seconds sent in Retry-After with the 429
+#define RATE_LIMIT_RETRY_AFTER 1
+
+
+//RATE LIMIT API
+// Map the client table, named after instance like the statistics segment
+// (NULL = anonymous, shared with the workers forked later). Returns 0, -1 on error.
+int rate_limit_init(const char *instance);
+
+// Unmap the table (and remove it if this process owns it)
+void rate_limit_cleanup(void);
+
+// Leave the table to another process (rate_limit_cleanup no longer removes it)
+void rate_limit_release_ownership(void);
+
+// Remove the table in rate_limit_cleanup (segment inherited in an upgrade)
+void rate_limit_take_ownership(void);
+
+// Key of a client address: IPv4 (and IPv4-mapped IPv6) addresses are their own
+// client, IPv6 ones are grouped by /64. 0 for other families.
+uint64_t rate_limit_key(const struct sockaddr_storage *addr);
+
+// Take a token for a request of client key at now_ms (CLOCK_MONOTONIC): the bucket
+// holds up to burst tokens and gains rate per second. Returns 1 if allowed, 0 if the
+// client is over the limit; always 1 for rate 0, key 0 or without a table.
+int rate_limit_allow(uint64_t key, unsigned rate, unsigned burst, uint64_t now_ms);
+
+// Whether a request of client key would be allowed at now_ms, without charging it
+// (a cheap check before a connection takes a queue slot). 1 for untracked clients.
+int rate_limit_peek(uint64_t key, unsigned rate, uint64_t now_ms);
+
+#endif
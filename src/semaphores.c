@@ -1 +1,238 @@
-// Gestão de semáforos POSIX
\ No newline at end of file
+// Gestão de semáforos POSIX
+
+// implementa mutexes, event counts e seqlocks partilhados entre processos sobre futexes
+// o estado fica na memória partilhada do chamador; só se entra no kernel quando há espera
+// o mutex usa a robust list do kernel: se a thread dona morre, o kernel liberta o lock
+// e acorda quem espera; o próximo dono é avisado para reparar os dados
+
+#define _GNU_SOURCE
+#include "semaphores.h"
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+// Each thread registers its own robust list with the kernel on its first lock.
+// This replaces glibc's per-thread list, which only robust pthread mutexes use
+// (the server has none).
+static __thread struct robust_list_head robust_head;
+static __thread uint32_t thread_tid = 0;
+static pthread_once_t fork_once = PTHREAD_ONCE_INIT;
+
+// The child of a fork has a new tid and no registered list
+static void forget_thread(void) {
+    thread_tid = 0;
+}
+
+static void register_fork_handler(void) {
+    pthread_atfork(NULL, NULL, forget_thread);
+}
+
+// Tid of the calling thread, registering its robust list the first time
+static uint32_t current_tid(void) {
+    if (thread_tid == 0) {
+        pthread_once(&fork_once, register_fork_handler);
+        robust_head.list.next = &robust_head.list;
+        robust_head.futex_offset = (long)offsetof(shm_mutex_t, word) -
+                                   (long)offsetof(shm_mutex_t, robust_next);
+        robust_head.list_op_pending = NULL;
+        syscall(SYS_set_robust_list, &robust_head, sizeof(robust_head));
+        thread_tid = (uint32_t)syscall(SYS_gettid);
+    }
+    return thread_tid;
+}
+
+// Hint to the CPU that this is a spin-wait loop
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ __volatile__("pause");
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// Sleep while *addr == value (shared futex, the memory may be mapped by several processes)
+static int futex_wait(uint32_t *addr, uint32_t value, int timeout_ms) {
+    struct timespec ts;
+    struct timespec *timeout = NULL;
+    if (timeout_ms >= 0) {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (long)(timeout_ms % 1000) * 1000000;
+        timeout = &ts;
+    }
+    return (int)syscall(SYS_futex, addr, FUTEX_WAIT, value, timeout, NULL, 0);
+}
+
+static void futex_wake(uint32_t *addr, int count) {
+    syscall(SYS_futex, addr, FUTEX_WAKE, count, NULL, NULL, 0);
+}
+
+// ===== MUTEX =====
+
+// Initialize an unlocked mutex
+void shm_mutex_init(shm_mutex_t *mutex) {
+    mutex->robust_next = NULL;
+    __atomic_store_n(&mutex->word, 0, __ATOMIC_RELEASE);
+}
+
+// Announce the list operation about to happen, so the kernel still finds the
+// mutex if the thread dies halfway through it
+static void robust_pending(shm_mutex_t *mutex) {
+    robust_head.list_op_pending = (struct robust_list *)&mutex->robust_next;
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+}
+
+static void robust_done(void) {
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    robust_head.list_op_pending = NULL;
+}
+
+// Link a just acquired mutex into this thread's robust list
+static int robust_acquired(shm_mutex_t *mutex, uint32_t word) {
+    mutex->robust_next = robust_head.list.next;
+    robust_head.list.next = (struct robust_list *)&mutex->robust_next;
+    robust_done();
+    return (word & FUTEX_OWNER_DIED) ? SHM_MUTEX_OWNER_DIED : 0;
+}
+
+// Take a free lock (0, or released by the kernel after its owner died).
+// Returns 1 and leaves the previous word in *word on success.
+static int try_acquire(shm_mutex_t *mutex, uint32_t *word, uint32_t self) {
+    uint32_t seen = *word;
+    if (seen & FUTEX_TID_MASK) return 0;
+    return __atomic_compare_exchange_n(&mutex->word, word, self | (seen & FUTEX_WAITERS), 0,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+// Lock: spin briefly, then sleep until released (by the owner or by the kernel)
+int shm_mutex_lock(shm_mutex_t *mutex) {
+    uint32_t self = current_tid();
+    robust_pending(mutex);
+
+    uint32_t word = __atomic_load_n(&mutex->word, __ATOMIC_RELAXED);
+    if (try_acquire(mutex, &word, self)) return robust_acquired(mutex, word);
+
+    // Short critical sections are usually released before a sleep would pay off
+    for (int i = 0; i < SHM_MUTEX_SPIN; i++) {
+        cpu_relax();
+        word = __atomic_load_n(&mutex->word, __ATOMIC_RELAXED);
+        if (try_acquire(mutex, &word, self)) return robust_acquired(mutex, word);
+    }
+
+    // Sleep with the waiters bit set; whoever takes the lock from here on keeps
+    // the bit, since other threads may still be sleeping. When the owner dies
+    // the kernel sets FUTEX_OWNER_DIED in its place and wakes one sleeper.
+    for (;;) {
+        word = __atomic_load_n(&mutex->word, __ATOMIC_RELAXED);
+        if (!(word & FUTEX_TID_MASK)) {
+            uint32_t seen = word;
+            if (__atomic_compare_exchange_n(&mutex->word, &word,
+                                            self | FUTEX_WAITERS, 0,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                return robust_acquired(mutex, seen);
+            }
+            continue;
+        }
+        if (!(word & FUTEX_WAITERS)) {
+            if (!__atomic_compare_exchange_n(&mutex->word, &word, word | FUTEX_WAITERS, 0,
+                                             __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                continue;
+            }
+            word |= FUTEX_WAITERS;
+        }
+        futex_wait(&mutex->word, word, -1);
+    }
+}
+
+// Lock without waiting
+int shm_mutex_trylock(shm_mutex_t *mutex) {
+    uint32_t self = current_tid();
+    robust_pending(mutex);
+    uint32_t word = __atomic_load_n(&mutex->word, __ATOMIC_RELAXED);
+    if (try_acquire(mutex, &word, self)) return robust_acquired(mutex, word);
+    robust_done();
+    return -1;
+}
+
+// Unlock, waking one sleeper if any
+void shm_mutex_unlock(shm_mutex_t *mutex) {
+    struct robust_list *entry = (struct robust_list *)&mutex->robust_next;
+    robust_pending(mutex);
+
+    // Locks are mostly released in reverse order, so this is usually the head
+    struct robust_list **link = &robust_head.list.next;
+    while (*link != &robust_head.list && *link != entry) link = &(*link)->next;
+    if (*link == entry) *link = entry->next;
+
+    uint32_t word = __atomic_exchange_n(&mutex->word, 0, __ATOMIC_RELEASE);
+    if (word & FUTEX_WAITERS) futex_wake(&mutex->word, 1);
+    robust_done();
+}
+
+
+// ===== EVENT COUNT =====
+
+void shm_eventcount_init(shm_eventcount_t *ec) {
+    __atomic_store_n(&ec->seq, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&ec->waiters, 0, __ATOMIC_RELEASE);
+}
+
+// Read the current count
+uint32_t shm_eventcount_prepare(shm_eventcount_t *ec) {
+    return __atomic_load_n(&ec->seq, __ATOMIC_ACQUIRE);
+}
+
+// Sleep until the count moves past key
+int shm_eventcount_wait(shm_eventcount_t *ec, uint32_t key, int timeout_ms) {
+    // Announce the waiter before the final check so a signal cannot be missed
+    __atomic_fetch_add(&ec->waiters, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ec->seq, __ATOMIC_SEQ_CST) == key) {
+        futex_wait(&ec->seq, key, timeout_ms);
+    }
+    __atomic_fetch_sub(&ec->waiters, 1, __ATOMIC_RELAXED);
+    return __atomic_load_n(&ec->seq, __ATOMIC_ACQUIRE) != key ? 0 : -1;
+}
+
+// Advance the count and wake every waiter
+void shm_eventcount_signal(shm_eventcount_t *ec) {
+    __atomic_fetch_add(&ec->seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ec->waiters, __ATOMIC_SEQ_CST) > 0) futex_wake(&ec->seq, INT_MAX);
+}
+
+
+// ===== SEQLOCK =====
+
+void shm_seqlock_init(shm_seqlock_t *lock) {
+    __atomic_store_n(&lock->seq, 0, __ATOMIC_RELEASE);
+}
+
+// Odd sequence: a write is in progress
+void shm_seqlock_write_begin(shm_seqlock_t *lock) {
+    uint32_t seq = __atomic_load_n(&lock->seq, __ATOMIC_RELAXED);
+    __atomic_store_n(&lock->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void shm_seqlock_write_end(shm_seqlock_t *lock) {
+    uint32_t seq = __atomic_load_n(&lock->seq, __ATOMIC_RELAXED);
+    __atomic_store_n(&lock->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+// Wait out a write in progress and return the sequence the read starts at
+uint32_t shm_seqlock_read_begin(const shm_seqlock_t *lock) {
+    uint32_t seq;
+    while ((seq = __atomic_load_n(&lock->seq, __ATOMIC_ACQUIRE)) & 1) {
+        cpu_relax();
+    }
+    return seq;
+}
+
+// Whether a write happened since read_begin (the read must be repeated)
+int shm_seqlock_read_retry(const shm_seqlock_t *lock, uint32_t start) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&lock->seq, __ATOMIC_RELAXED) != start;
+}
@@ -1 +1,81 @@
-// Interface Semáforos
\ No newline at end of file
+// Interface Semáforos
+
+// primitivas de sincronização partilhadas entre processos, guardadas dentro do próprio
+// segmento de memória partilhada (sem objetos com nome em /dev/shm)
+// usam futexes: sem contenção não há chamadas ao sistema
+// o mutex guarda o tid do dono e segue o protocolo de robust futexes do kernel:
+// se a thread dona morre, o kernel marca o lock e acorda quem está à espera
+
+#ifndef SEMAPHORES_H
+#define SEMAPHORES_H
+
+#include <stdint.h>
+
+// Attempts before a contended lock sleeps in the kernel
+#define SHM_MUTEX_SPIN 100
+
+// shm_mutex_lock result when the previous owner died holding the lock
+#define SHM_MUTEX_OWNER_DIED 1
+
+// Mutex: 0 when free, otherwise the owner's tid (plus the kernel's waiters and
+// owner-died bits). While held, robust_next links it into the owner thread's
+// robust list so the kernel can release it if that thread dies.
+typedef struct {
+    void *robust_next;
+    uint32_t word;
+} shm_mutex_t;
+
+// Event count: waiters sleep until the count moves past the value they read
+typedef struct {
+    uint32_t seq;
+    uint32_t waiters;
+} shm_eventcount_t;
+
+// Sequence lock: one writer at a time (serialized by the caller), readers retry
+typedef struct {
+    uint32_t seq;
+} shm_seqlock_t;
+
+
+//SHARED MUTEX API
+// Initialize an unlocked mutex (memory may also simply be zeroed)
+void shm_mutex_init(shm_mutex_t *mutex);
+
+// Lock: spin briefly, then sleep. Returns 0, or SHM_MUTEX_OWNER_DIED if the previous
+// owner died holding it (the protected data may need repair).
+int shm_mutex_lock(shm_mutex_t *mutex);
+
+// Lock without waiting: 0 if acquired, SHM_MUTEX_OWNER_DIED if taken over from
+// a dead owner, -1 if held by a live one
+int shm_mutex_trylock(shm_mutex_t *mutex);
+
+// Unlock (wakes one sleeper if there is any)
+void shm_mutex_unlock(shm_mutex_t *mutex);
+
+
+//EVENT COUNT API
+void shm_eventcount_init(shm_eventcount_t *ec);
+
+// Read the current count before checking the condition being waited for
+uint32_t shm_eventcount_prepare(shm_eventcount_t *ec);
+
+// Sleep until the count differs from key or timeout_ms passes (-1 = no timeout).
+// Returns 0 when signalled, -1 on timeout.
+int shm_eventcount_wait(shm_eventcount_t *ec, uint32_t key, int timeout_ms);
+
+// Advance the count and wake every waiter (no system call when nobody waits)
+void shm_eventcount_signal(shm_eventcount_t *ec);
+
+
+//SEQLOCK API
+void shm_seqlock_init(shm_seqlock_t *lock);
+
+// Writer side (callers serialize writers themselves)
+void shm_seqlock_write_begin(shm_seqlock_t *lock);
+void shm_seqlock_write_end(shm_seqlock_t *lock);
+
+// Reader side: read the data between begin and retry, repeat while retry returns 1
+uint32_t shm_seqlock_read_begin(const shm_seqlock_t *lock);
+int shm_seqlock_read_retry(const shm_seqlock_t *lock, uint32_t start);
+
+#endif
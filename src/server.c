@@ -0,0 +1,57 @@
+// Servidor HTTP (ponto de entrada)
+
+// carrega o server.conf (ou o ficheiro passado como argumento)
+// inicializa logger e estatísticas e entrega o controlo ao processo master
+// (num upgrade o novo binário é arrancado com a mesma linha de comandos)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "config.h"
+#include "logger.h"
+#include "stats.h"
+#include "rate_limit.h"
+#include "master.h"
+
+int main(int argc, char *argv[]) {
+    const char *config_file = argc > 1 ? argv[1] : "server.conf";
+
+    server_config_t *config = config_create(config_file);
+    if (!config) {
+        fprintf(stderr, "Failed to load configuration from %s\n", config_file);
+        return EXIT_FAILURE;
+    }
+
+    if (logger_init(config) != 0) {
+        config_destroy(config);
+        return EXIT_FAILURE;
+    }
+
+    // Statistics segment named after this instance so several servers can share a host
+    char instance[MAX_INSTANCE_NAME];
+    snprintf(instance, sizeof(instance), "%s", config_get_instance_name(config));
+    if (!instance[0]) snprintf(instance, sizeof(instance), "port%d", config_get_port(config));
+
+    const char *shm_instance = config_get_anonymous_shared_memory(config) ? NULL : instance;
+    if (stats_init(shm_instance) != 0) {
+        logger_close();
+        config_destroy(config);
+        return EXIT_FAILURE;
+    }
+
+    // Per-client buckets, shared by the workers like the statistics
+    if (rate_limit_init(shm_instance) != 0) {
+        stats_cleanup();
+        logger_close();
+        config_destroy(config);
+        return EXIT_FAILURE;
+    }
+
+    master_set_exec_args(argv);
+    int ret = master_run(config);
+
+    rate_limit_cleanup();
+    stats_cleanup();
+    logger_close();
+    config_destroy(config);
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
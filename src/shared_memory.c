@@ -1 +1,132 @@
-// Gestão de memória partilhada 
\ No newline at end of file
+// Gestão de memória partilhada
+
+// cria ou reutiliza segmentos POSIX (shm_open) validando o cabeçalho:
+// magic e versão diferentes indicam outro binário, um dono que já não existe indica
+// um segmento abandonado por uma instância que foi morta; em ambos os casos é recriado
+
+#include "shared_memory.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Build a per-instance segment name
+int shared_memory_name(char *name, size_t size, const char *base, const char *instance) {
+    if (!name || !base || !instance) return -1;
+
+    int len = snprintf(name, size, "/%s.%s", base, instance);
+    if (len < 0 || (size_t)len >= size) return -1;
+
+    // Only the instance part can come from the configuration
+    for (char *p = name + strlen(base) + 2; *p; p++) {
+        char c = *p;
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+              (c >= '0' && c <= '9') || c == '-' || c == '_')) {
+            *p = '_';
+        }
+    }
+    return 0;
+}
+
+// Whether an existing segment was left by this binary and is still in use
+static int segment_is_current(const shared_memory_header_t *header, size_t size,
+                              uint32_t magic, uint32_t version) {
+    if (header->magic != magic || header->version != version || header->size != size) {
+        fprintf(stderr, "Shared memory segment has an incompatible layout\n");
+        return 0;
+    }
+    if (header->owner > 0 && kill(header->owner, 0) != 0 && errno == ESRCH) {
+        fprintf(stderr, "Shared memory segment is stale (owner %d is gone)\n", (int)header->owner);
+        return 0;
+    }
+    return 1;
+}
+
+// Attach to an existing named segment, NULL if there is none or it is unusable
+static void* attach_segment(const char *name, size_t size, uint32_t magic, uint32_t version) {
+    int fd = shm_open(name, O_RDWR, 0600);
+    if (fd == -1) return NULL;
+
+    struct stat st;
+    void *segment = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size == (off_t)size) {
+        segment = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    } else {
+        fprintf(stderr, "Shared memory segment has an incompatible layout\n");
+    }
+    close(fd);
+
+    if (segment != MAP_FAILED && segment_is_current(segment, size, magic, version)) {
+        return segment;
+    }
+
+    // Leftover from another version or a dead instance: replace it
+    if (segment != MAP_FAILED) munmap(segment, size);
+    shm_unlink(name);
+    return NULL;
+}
+
+// Create a new named segment
+static void* create_segment(const char *name, size_t size) {
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd == -1) {
+        perror("shm_open failed");
+        return NULL;
+    }
+
+    if (ftruncate(fd, size) == -1) {
+        perror("ftruncate failed");
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+
+    void *segment = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED) {
+        perror("mmap failed");
+        shm_unlink(name);
+        return NULL;
+    }
+    return segment;
+}
+
+// Map a named or anonymous segment with a validated header
+void* shared_memory_open(const char *name, size_t size, uint32_t magic, uint32_t version, int *created) {
+    if (size < sizeof(shared_memory_header_t)) return NULL;
+
+    void *segment;
+    if (name) {
+        segment = attach_segment(name, size, magic, version);
+        if (segment) {
+            if (created) *created = 0;
+            return segment;
+        }
+        segment = create_segment(name, size);
+    } else {
+        segment = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (segment == MAP_FAILED) {
+            perror("mmap failed");
+            segment = NULL;
+        }
+    }
+    if (!segment) return NULL;
+
+    // New segments are zero-filled: only the header needs to be set
+    shared_memory_header_t *header = segment;
+    header->magic = magic;
+    header->version = version;
+    header->size = size;
+    header->owner = name ? getpid() : 0;
+    if (created) *created = 1;
+    return segment;
+}
+
+// Unmap a segment
+void shared_memory_close(void *segment, size_t size) {
+    if (segment) munmap(segment, size);
+}
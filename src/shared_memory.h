@@ -1 +1,42 @@
-// Interface memória partilhada 
\ No newline at end of file
+// Interface memória partilhada
+
+// abre segmentos de memória partilhada com nome por instância do servidor
+// ou anónimos (MAP_SHARED herdado pelos processos filhos no fork)
+// cada segmento começa com um cabeçalho (magic, versão, tamanho, dono) que permite
+// detetar segmentos de outra versão ou deixados por uma instância que já morreu
+
+#ifndef SHARED_MEMORY_H
+#define SHARED_MEMORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// Longest segment name built by shared_memory_name (including the '\0')
+#define SHARED_MEMORY_NAME_MAX 128
+
+// First bytes of every segment
+typedef struct {
+    uint32_t magic;     // Identifies what the segment holds
+    uint32_t version;   // Layout version of that structure
+    uint64_t size;      // Size of the whole segment
+    pid_t owner;        // Process that unlinks the segment (0 = none, anonymous)
+} shared_memory_header_t;
+
+//SHARED MEMORY API
+// Build "/<base>.<instance>" into name. Instance characters other than letters,
+// digits, '-' and '_' are replaced with '_'. Returns 0, or -1 if it does not fit.
+int shared_memory_name(char *name, size_t size, const char *base, const char *instance);
+
+// Map a segment of size bytes that starts with a shared_memory_header_t.
+// name NULL maps anonymous shared memory (shared with children forked later).
+// An existing named segment is reused only if its header matches magic, version
+// and size and its owner is still running; otherwise it is replaced.
+// *created is set to 1 when the segment is new (zero-filled, header set, owned by
+// this process), 0 when an existing one was attached. Returns NULL on error.
+void* shared_memory_open(const char *name, size_t size, uint32_t magic, uint32_t version, int *created);
+
+// Unmap a segment returned by shared_memory_open
+void shared_memory_close(void *segment, size_t size);
+
+#endif
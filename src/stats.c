@@ -1,148 +1,275 @@
 // Estatisitcas do servidor
 
-// Implementa um sistema de estatísticas com memória partilhada usando shm_open() e sincronização com semáforos POSIX.
+// Implementa um sistema de estatísticas com memória partilhada (shared_memory.c), com um
+// segmento por instância do servidor ou anónimo, herdado pelos workers no fork.
+// Cada processo escreve num slot próprio do segmento com operações atómicas (sem lock);
+// um mutex dentro do segmento (semaphores.c) só protege a atribuição de slots e a passagem
+// de um slot para o total retirado quando o processo termina (ou morre sem aviso)
 
 #include "stats.h"
+#include "semaphores.h"
+#include "shared_memory.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <sys/mman.h>
-#include <fcntl.h>
-#include <semaphore.h>
 #include <errno.h>
+#include <sys/mman.h>
 #include <time.h>
+#include <signal.h>
+#include <pthread.h>
 
 // ===== VARIÁVEIS GLOBAIS PRIVADAS =====
 
-// Nomes para objetos de IPC
-#define SHM_NAME "/concurrent_http_stats"
-#define SEM_NAME "/concurrent_http_stats_sem"
+// Prefixo do nome do segmento (seguido do nome da instância)
+#define SHM_BASE_NAME "concurrent_http_stats"
+
+// Identificação do layout no cabeçalho do segmento ("HTST"); mudar a versão
+// sempre que stats_segment_t mudar
+#define STATS_SEGMENT_MAGIC 0x48545354u
+#define STATS_SEGMENT_VERSION 5
+
+// Nomes das políticas do cache para o stats_print (ordem de cache_policy_t)
+static const char *cache_policy_names[STATS_CACHE_POLICIES] = { "lru", "tinylfu" };
+
+// Contadores escritos por um único processo (alinhados para não partilharem cache lines)
+typedef struct {
+    pid_t pid;                       // 0 = slot livre
+    server_stats_t counters;
+} __attribute__((aligned(64))) stats_slot_t;
+
+// Layout do segmento de memória partilhada
+typedef struct {
+    shared_memory_header_t header;   // Magic, versão, tamanho e dono
+    shm_mutex_t lock;                // Atribuição e retirada de slots
+    shm_seqlock_t retire_seq;        // Leitores repetem a soma se um slot foi retirado entretanto
+    time_t server_start_time;
+    server_stats_t retired;          // Totais de processos que já terminaram
+    stats_slot_t overflow;           // Usado quando não há slots livres
+    stats_slot_t slots[STATS_MAX_SLOTS];
+} stats_segment_t;
 
 // Ponteiro para estatísticas em memória partilhada
-static server_stats_t *shared_stats = NULL;
+static stats_segment_t *shared_stats = NULL;
+
+// Slot deste processo (atribuído na primeira escrita, limpo no fork)
+static stats_slot_t *local_slot = NULL;
+static pthread_mutex_t local_slot_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t atfork_once = PTHREAD_ONCE_INIT;
+
+// Cópia devolvida por stats_get()
+static server_stats_t snapshot;
 
-// Semáforo para sincronização entre processos
-static sem_t *stats_semaphore = NULL;
+// Processo que removerá os objetos IPC (0 = nenhum); os filhos herdam o valor
+// mas só o processo com este pid faz o unlink, uma única vez
+static pid_t owner_pid = 0;
 
-// Flag para indicar se somos o criador dos objetos IPC
-static int is_creator = 0;
+// Nome do segmento ("" = anónimo)
+static char shm_name[SHARED_MEMORY_NAME_MAX] = "";
 
 // ===== FUNÇÕES PRIVADAS =====
 
-// Cria e inicializa objetos de memória partilhada
-static int create_shared_memory(void) {
-    int shm_fd;
-    
-    // Criar segmento de memória partilhada
-    shm_fd = shm_open(SHM_NAME, O_CREAT | O_RDWR, 0666);
-    if (shm_fd == -1) {
-        perror("shm_open failed");
-        return -1;
+// Inicializa estrutura de estatísticas (o segmento novo já vem a zeros, mutex livre)
+static void initialize_stats(void) {
+    shared_stats->server_start_time = time(NULL);
+}
+
+// O processo filho não herda o slot do pai
+static void reset_local_slot(void) {
+    local_slot = NULL;
+    pthread_mutex_init(&local_slot_lock, NULL);
+}
+
+static void register_atfork(void) {
+    pthread_atfork(NULL, NULL, reset_local_slot);
+}
+
+// Guarda value em *max se for maior
+static void update_max(unsigned long *max, unsigned long value) {
+    unsigned long cur = __atomic_load_n(max, __ATOMIC_RELAXED);
+    while (value > cur && !__atomic_compare_exchange_n(max, &cur, value, 0,
+                                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
     }
-    
-    // Definir tamanho do segmento
-    if (ftruncate(shm_fd, sizeof(server_stats_t)) == -1) {
-        perror("ftruncate failed");
-        close(shm_fd);
-        return -1;
+}
+
+// Bucket de value num histograma de potências de dois com buckets entradas
+static int log2_bucket(unsigned long value, int buckets) {
+    int bucket = value == 0 ? 0 : 64 - __builtin_clzl(value);
+    return bucket < buckets ? bucket : buckets - 1;
+}
+
+// Soma os contadores de src a dst (src pode estar a ser escrito por outro processo)
+static void add_counters(server_stats_t *dst, server_stats_t *src) {
+    unsigned long *d = &dst->total_requests;
+    unsigned long *fields[] = {
+        &src->total_requests, &src->total_bytes, &src->status_200, &src->status_404,
+        &src->status_403, &src->status_500, &src->status_503, &src->status_400,
+        &src->status_501, &src->total_response_time_ms, &src->connection_errors,
+        &src->timeout_errors, &src->rate_limited
+    };
+    unsigned long *targets[] = {
+        d, &dst->total_bytes, &dst->status_200, &dst->status_404,
+        &dst->status_403, &dst->status_500, &dst->status_503, &dst->status_400,
+        &dst->status_501, &dst->total_response_time_ms, &dst->connection_errors,
+        &dst->timeout_errors, &dst->rate_limited
+    };
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        __atomic_fetch_add(targets[i], __atomic_load_n(fields[i], __ATOMIC_RELAXED), __ATOMIC_RELAXED);
     }
-    
-    // Mapear memória partilhada
-    shared_stats = mmap(NULL, sizeof(server_stats_t), 
-                       PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
-    if (shared_stats == MAP_FAILED) {
-        perror("mmap failed");
-        close(shm_fd);
-        return -1;
+    unsigned long *pool_fields[] = {
+        &src->queue_sojourns, &src->queue_sojourn_us, &src->pool_busy_us, &src->pool_idle_us,
+        &src->lock_waits, &src->lock_wait_us
+    };
+    unsigned long *pool_targets[] = {
+        &dst->queue_sojourns, &dst->queue_sojourn_us, &dst->pool_busy_us, &dst->pool_idle_us,
+        &dst->lock_waits, &dst->lock_wait_us
+    };
+    for (size_t i = 0; i < sizeof(pool_fields) / sizeof(pool_fields[0]); i++) {
+        __atomic_fetch_add(pool_targets[i], __atomic_load_n(pool_fields[i], __ATOMIC_RELAXED),
+                           __ATOMIC_RELAXED);
     }
-    
-    close(shm_fd);
-    return 0;
+    for (int i = 0; i < STATS_DEPTH_BUCKETS; i++) {
+        __atomic_fetch_add(&dst->queue_depth_hist[i],
+                           __atomic_load_n(&src->queue_depth_hist[i], __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    }
+    for (int i = 0; i < STATS_SOJOURN_BUCKETS; i++) {
+        __atomic_fetch_add(&dst->queue_sojourn_hist[i],
+                           __atomic_load_n(&src->queue_sojourn_hist[i], __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    }
+    for (int i = 0; i < STATS_CACHE_POLICIES; i++) {
+        __atomic_fetch_add(&dst->cache_hits[i],
+                           __atomic_load_n(&src->cache_hits[i], __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+        __atomic_fetch_add(&dst->cache_misses[i],
+                           __atomic_load_n(&src->cache_misses[i], __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+        __atomic_fetch_add(&dst->cache_evictions[i],
+                           __atomic_load_n(&src->cache_evictions[i], __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+        __atomic_fetch_add(&dst->cache_rejections[i],
+                           __atomic_load_n(&src->cache_rejections[i], __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    }
+    update_max(&dst->queue_depth_max, __atomic_load_n(&src->queue_depth_max, __ATOMIC_RELAXED));
+    update_max(&dst->queue_sojourn_max_us, __atomic_load_n(&src->queue_sojourn_max_us, __ATOMIC_RELAXED));
+    for (int i = 0; i < STATS_MAX_VHOSTS; i++) {
+        __atomic_fetch_add(&dst->vhost_requests[i],
+                           __atomic_load_n(&src->vhost_requests[i], __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+        __atomic_fetch_add(&dst->vhost_bytes[i],
+                           __atomic_load_n(&src->vhost_bytes[i], __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    }
+
+    update_max(&dst->max_concurrent, __atomic_load_n(&src->max_concurrent, __ATOMIC_RELAXED));
 }
 
-// Liga-se a memória partilhada existente
-static int attach_shared_memory(void) {
-    int shm_fd;
-    
-    // Abrir segmento existente
-    shm_fd = shm_open(SHM_NAME, O_RDWR, 0666);
-    if (shm_fd == -1) {
-        perror("shm_open failed");
-        return -1;
+// Bloqueia o segmento, avisando se o dono anterior morreu com o lock
+static void lock_segment(void) {
+    if (shm_mutex_lock(&shared_stats->lock) == SHM_MUTEX_OWNER_DIED) {
+        fprintf(stderr, "Statistics lock recovered from a dead process\n");
     }
-    
-    // Mapear memória partilhada
-    shared_stats = mmap(NULL, sizeof(server_stats_t), 
-                       PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
-    if (shared_stats == MAP_FAILED) {
-        perror("mmap failed");
-        close(shm_fd);
-        return -1;
-    }
-    
-    close(shm_fd);
-    return 0;
 }
 
-// Cria semáforo para sincronização
-static int create_semaphore(void) {
-    // Criar semáforo com valor inicial 1 (disponível)
-    stats_semaphore = sem_open(SEM_NAME, O_CREAT | O_EXCL, 0666, 1);
-    
-    if (stats_semaphore == SEM_FAILED) {
-        if (errno == EEXIST) {
-            // Semáforo já existe, apenas abrir
-            stats_semaphore = sem_open(SEM_NAME, O_RDWR);
+// Passa os contadores de um slot para o total retirado e liberta-o (com o lock)
+static void retire_slot(stats_slot_t *slot) {
+    shm_seqlock_write_begin(&shared_stats->retire_seq);
+    add_counters(&shared_stats->retired, &slot->counters);
+    memset(&slot->counters, 0, sizeof(slot->counters));
+    shm_seqlock_write_end(&shared_stats->retire_seq);
+    __atomic_store_n(&slot->pid, 0, __ATOMIC_RELEASE);
+}
+
+// Atribui um slot livre a este processo, recuperando os de processos mortos
+static stats_slot_t *claim_slot(void) {
+    pid_t self = getpid();
+    stats_slot_t *claimed = &shared_stats->overflow;
+
+    lock_segment();
+    for (int i = 0; i < STATS_MAX_SLOTS; i++) {
+        stats_slot_t *slot = &shared_stats->slots[i];
+        if (slot->pid != 0 && kill(slot->pid, 0) != 0 && errno == ESRCH) {
+            retire_slot(slot);
         }
-        
-        if (stats_semaphore == SEM_FAILED) {
-            perror("sem_open failed");
-            return -1;
+        if (slot->pid == 0) {
+            slot->pid = self;
+            claimed = slot;
+            break;
         }
-    } else {
-        is_creator = 1; // Somos os criadores do semáforo
     }
-    
-    return 0;
+    shm_mutex_unlock(&shared_stats->lock);
+    return claimed;
 }
 
+// Contadores onde este processo escreve (NULL se as estatísticas não estão ativas)
+static server_stats_t *local_counters(void) {
+    if (!shared_stats) return NULL;
 
-// Inicializa estrutura de estatísticas com valores zero
-static void initialize_stats(void) {
-    memset(shared_stats, 0, sizeof(server_stats_t));
-    shared_stats->server_start_time = time(NULL);
-    shared_stats->average_response_time = 0.0;
+    stats_slot_t *slot = __atomic_load_n(&local_slot, __ATOMIC_ACQUIRE);
+    if (!slot) {
+        pthread_mutex_lock(&local_slot_lock);
+        slot = local_slot;
+        if (!slot) {
+            slot = claim_slot();
+            __atomic_store_n(&local_slot, slot, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&local_slot_lock);
+    }
+    return &slot->counters;
+}
+
+// Uma passagem pelos contadores (pode contar duas vezes um slot a ser retirado)
+static void sum_slots(server_stats_t *out) {
+    memset(out, 0, sizeof(*out));
+    add_counters(out, &shared_stats->retired);
+    add_counters(out, &shared_stats->overflow.counters);
+    for (int i = 0; i < STATS_MAX_SLOTS; i++) {
+        stats_slot_t *slot = &shared_stats->slots[i];
+        add_counters(out, &slot->counters);
+        out->active_connections += __atomic_load_n(&slot->counters.active_connections, __ATOMIC_RELAXED);
+        out->queue_depth += __atomic_load_n(&slot->counters.queue_depth, __ATOMIC_RELAXED);
+        out->pool_threads += __atomic_load_n(&slot->counters.pool_threads, __ATOMIC_RELAXED);
+        out->cache_bytes += __atomic_load_n(&slot->counters.cache_bytes, __ATOMIC_RELAXED);
+    }
+    out->active_connections += __atomic_load_n(&shared_stats->overflow.counters.active_connections,
+                                               __ATOMIC_RELAXED);
+    out->queue_depth += __atomic_load_n(&shared_stats->overflow.counters.queue_depth, __ATOMIC_RELAXED);
+    out->pool_threads += __atomic_load_n(&shared_stats->overflow.counters.pool_threads, __ATOMIC_RELAXED);
+    out->cache_bytes += __atomic_load_n(&shared_stats->overflow.counters.cache_bytes, __ATOMIC_RELAXED);
+    out->server_start_time = shared_stats->server_start_time;
+    if (out->total_requests > 0) {
+        out->average_response_time = (double)out->total_response_time_ms / out->total_requests;
+    }
+}
+
+// Soma o total retirado e todos os slots
+static void collect_stats(server_stats_t *out) {
+    uint32_t seq;
+    do {
+        seq = shm_seqlock_read_begin(&shared_stats->retire_seq);
+        sum_slots(out);
+    } while (shm_seqlock_read_retry(&shared_stats->retire_seq, seq));
 }
 
 
 
 // IMPLEMENTAÇÃO DA API PÚBLICA
-int stats_init(void) {
-    int ret;
-    
-    // Tentar anexar à memória partilhada existente primeiro
-    ret = attach_shared_memory();
-    if (ret != 0) {
-        // Se não existe, criar nova
-        printf("Creating new shared memory segment...\n");
-        ret = create_shared_memory();
-        if (ret != 0) {
-            return -1;
-        }
-        is_creator = 1;
+int stats_init(const char *instance) {
+    pthread_once(&atfork_once, register_atfork);
+    local_slot = NULL;
+
+    shm_name[0] = '\0';
+    if (instance && shared_memory_name(shm_name, sizeof(shm_name), SHM_BASE_NAME, instance) != 0) {
+        fprintf(stderr, "Invalid statistics instance name: %s\n", instance);
+        return -1;
     }
-    
-    // Inicializar semáforo
-    if (create_semaphore() != 0) {
+
+    // Anexar ao segmento desta instância ou criar um novo (anónimo se instance é NULL)
+    int created = 0;
+    shared_stats = shared_memory_open(instance ? shm_name : NULL, sizeof(stats_segment_t),
+                                      STATS_SEGMENT_MAGIC, STATS_SEGMENT_VERSION, &created);
+    if (!shared_stats) {
         return -1;
     }
-    
+
     // Se somos os criadores, inicializar a estrutura
-    if (is_creator) {
-        sem_wait(stats_semaphore); // Lock
+    if (created) {
+        owner_pid = instance ? getpid() : 0;
         initialize_stats();
-        sem_post(stats_semaphore); // Unlock
         
         printf("Statistics system initialized (creator)\n");
     } else {
@@ -154,88 +281,197 @@ int stats_init(void) {
 
 void stats_cleanup(void) {
     if (shared_stats) {
-        munmap(shared_stats, sizeof(server_stats_t));
+        shared_memory_close(shared_stats, sizeof(stats_segment_t));
         shared_stats = NULL;
-    }
-    
-    if (stats_semaphore) {
-        sem_close(stats_semaphore);
-        
+        local_slot = NULL;
+
         // Se fomos os criadores, remover objetos IPC
-        if (is_creator) {
-            sem_unlink(SEM_NAME);
-            shm_unlink(SHM_NAME);
+        if (owner_pid == getpid()) {
+            shm_unlink(shm_name);
+            owner_pid = 0;
             printf("Statistics system cleaned up (creator)\n");
         }
-        
-        stats_semaphore = NULL;
     }
 }
 
+// Os objetos IPC passam para um novo processo master (upgrade do binário)
+void stats_release_ownership(void) {
+    // O novo master pode já ter registado o seu pid no cabeçalho
+    pid_t self = getpid();
+    if (shared_stats && owner_pid == self) {
+        __atomic_compare_exchange_n(&shared_stats->header.owner, &self, 0, 0,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    }
+    owner_pid = 0;
+}
+
+// Este processo passa a remover os objetos IPC no fim
+void stats_take_ownership(void) {
+    if (!shared_stats || !shm_name[0]) return;     // Segmento anónimo: nada a remover
+    owner_pid = getpid();
+    __atomic_store_n(&shared_stats->header.owner, owner_pid, __ATOMIC_RELAXED);
+}
+
+// Passa o slot de um processo terminado para o total retirado (chamado pelo master)
+void stats_retire_process(pid_t pid) {
+    if (!shared_stats || pid <= 0) return;
+
+    lock_segment();
+    for (int i = 0; i < STATS_MAX_SLOTS; i++) {
+        if (shared_stats->slots[i].pid == pid) {
+            retire_slot(&shared_stats->slots[i]);
+            break;
+        }
+    }
+    shm_mutex_unlock(&shared_stats->lock);
+}
+
 void stats_increment_request(int status_code) {
-    if (!shared_stats || !stats_semaphore) return;
-    
-    sem_wait(stats_semaphore); // Lock
-    
-    shared_stats->total_requests++;
-    
+    server_stats_t *counters = local_counters();
+    if (!counters) return;
+
+    __atomic_fetch_add(&counters->total_requests, 1, __ATOMIC_RELAXED);
+
     // Incrementar contador específico do status code
+    unsigned long *status = NULL;
     switch (status_code) {
-        case 200: shared_stats->status_200++; break;
-        case 404: shared_stats->status_404++; break;
-        case 403: shared_stats->status_403++; break;
-        case 500: shared_stats->status_500++; break;
-        case 503: shared_stats->status_503++; break;
-        case 400: shared_stats->status_400++; break;
-        case 501: shared_stats->status_501++; break;
+        case 200: status = &counters->status_200; break;
+        case 404: status = &counters->status_404; break;
+        case 403: status = &counters->status_403; break;
+        case 500: status = &counters->status_500; break;
+        case 503: status = &counters->status_503; break;
+        case 400: status = &counters->status_400; break;
+        case 501: status = &counters->status_501; break;
         default: break; // Outros status codes não contabilizados separadamente
     }
-    
-    sem_post(stats_semaphore); // Unlock
+    if (status) __atomic_fetch_add(status, 1, __ATOMIC_RELAXED);
 }
 
 void stats_add_bytes(size_t bytes) {
-    if (!shared_stats || !stats_semaphore) return;
-    
-    sem_wait(stats_semaphore); // Lock
-    shared_stats->total_bytes += bytes;
-    sem_post(stats_semaphore); // Unlock
+    server_stats_t *counters = local_counters();
+    if (!counters) return;
+
+    __atomic_fetch_add(&counters->total_bytes, bytes, __ATOMIC_RELAXED);
 }
 
 void stats_update_response_time(long response_time_ms) {
-    if (!shared_stats || !stats_semaphore) return;
-    
-    sem_wait(stats_semaphore); // Lock
-    
-    // Atualizar soma acumulada
-    shared_stats->total_response_time_ms += response_time_ms;
-    
-    // Calcular nova média
-    if (shared_stats->total_requests > 0) {
-        shared_stats->average_response_time = 
-            (double)shared_stats->total_response_time_ms / shared_stats->total_requests;
-    }
-    
-    sem_post(stats_semaphore); // Unlock
+    server_stats_t *counters = local_counters();
+    if (!counters) return;
+
+    // A média é calculada na leitura a partir da soma acumulada
+    __atomic_fetch_add(&counters->total_response_time_ms, response_time_ms, __ATOMIC_RELAXED);
+}
+
+void stats_add_vhost_request(int vhost, size_t bytes) {
+    server_stats_t *counters = local_counters();
+    if (!counters || vhost < 0 || vhost >= STATS_MAX_VHOSTS) return;
+
+    __atomic_fetch_add(&counters->vhost_requests[vhost], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&counters->vhost_bytes[vhost], bytes, __ATOMIC_RELAXED);
 }
 
 void stats_set_active_connections(unsigned long count) {
-    if (!shared_stats || !stats_semaphore) return;
-    
-    sem_wait(stats_semaphore); // Lock
-    shared_stats->active_connections = count;
-    
+    server_stats_t *counters = local_counters();
+    if (!counters) return;
+
+    __atomic_store_n(&counters->active_connections, count, __ATOMIC_RELAXED);
+
     // Atualizar máximo simultâneo
-    if (count > shared_stats->max_concurrent) {
-        shared_stats->max_concurrent = count;
+    unsigned long max = __atomic_load_n(&counters->max_concurrent, __ATOMIC_RELAXED);
+    while (count > max && !__atomic_compare_exchange_n(&counters->max_concurrent, &max, count, 0,
+                                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
     }
-    
-    sem_post(stats_semaphore); // Unlock
+}
+
+void stats_record_queue_depth(unsigned long depth) {
+    server_stats_t *counters = local_counters();
+    if (!counters) return;
+
+    __atomic_fetch_add(&counters->queue_depth_hist[log2_bucket(depth, STATS_DEPTH_BUCKETS)], 1,
+                       __ATOMIC_RELAXED);
+    update_max(&counters->queue_depth_max, depth);
+}
+
+void stats_record_queue_sojourn(unsigned long sojourn_us) {
+    server_stats_t *counters = local_counters();
+    if (!counters) return;
+
+    __atomic_fetch_add(&counters->queue_sojourns, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&counters->queue_sojourn_us, sojourn_us, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&counters->queue_sojourn_hist[log2_bucket(sojourn_us, STATS_SOJOURN_BUCKETS)], 1,
+                       __ATOMIC_RELAXED);
+    update_max(&counters->queue_sojourn_max_us, sojourn_us);
+}
+
+void stats_add_thread_time(unsigned long busy_us, unsigned long idle_us) {
+    server_stats_t *counters = local_counters();
+    if (!counters) return;
+
+    __atomic_fetch_add(&counters->pool_busy_us, busy_us, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&counters->pool_idle_us, idle_us, __ATOMIC_RELAXED);
+}
+
+void stats_set_worker_gauges(unsigned long queue_depth, unsigned long threads,
+                             unsigned long lock_waits, unsigned long lock_wait_us) {
+    server_stats_t *counters = local_counters();
+    if (!counters) return;
+
+    // Os totais de locks vêm já acumulados pelo worker: substituem o valor anterior
+    __atomic_store_n(&counters->queue_depth, queue_depth, __ATOMIC_RELAXED);
+    __atomic_store_n(&counters->pool_threads, threads, __ATOMIC_RELAXED);
+    __atomic_store_n(&counters->lock_waits, lock_waits, __ATOMIC_RELAXED);
+    __atomic_store_n(&counters->lock_wait_us, lock_wait_us, __ATOMIC_RELAXED);
+}
+
+void stats_record_cache_lookup(int policy, int hit) {
+    server_stats_t *counters = local_counters();
+    if (!counters || policy < 0 || policy >= STATS_CACHE_POLICIES) return;
+
+    __atomic_fetch_add(hit ? &counters->cache_hits[policy] : &counters->cache_misses[policy], 1,
+                       __ATOMIC_RELAXED);
+}
+
+void stats_record_cache_eviction(int policy, int rejected) {
+    server_stats_t *counters = local_counters();
+    if (!counters || policy < 0 || policy >= STATS_CACHE_POLICIES) return;
+
+    __atomic_fetch_add(rejected ? &counters->cache_rejections[policy] : &counters->cache_evictions[policy],
+                       1, __ATOMIC_RELAXED);
+}
+
+void stats_set_cache_bytes(unsigned long bytes) {
+    server_stats_t *counters = local_counters();
+    if (!counters) return;
+
+    __atomic_store_n(&counters->cache_bytes, bytes, __ATOMIC_RELAXED);
+}
+
+int stats_get_process(int index, pid_t *pid, server_stats_t *out) {
+    if (!shared_stats || index < 0 || index >= STATS_MAX_SLOTS || !out) return -1;
+
+    stats_slot_t *slot = &shared_stats->slots[index];
+    pid_t owner = __atomic_load_n(&slot->pid, __ATOMIC_ACQUIRE);
+    if (owner == 0) return -1;
+
+    memset(out, 0, sizeof(*out));
+    add_counters(out, &slot->counters);
+    out->active_connections = __atomic_load_n(&slot->counters.active_connections, __ATOMIC_RELAXED);
+    out->queue_depth = __atomic_load_n(&slot->counters.queue_depth, __ATOMIC_RELAXED);
+    out->pool_threads = __atomic_load_n(&slot->counters.pool_threads, __ATOMIC_RELAXED);
+    out->cache_bytes = __atomic_load_n(&slot->counters.cache_bytes, __ATOMIC_RELAXED);
+    out->server_start_time = shared_stats->server_start_time;
+    if (out->total_requests > 0) {
+        out->average_response_time = (double)out->total_response_time_ms / out->total_requests;
+    }
+    if (pid) *pid = owner;
+    return 0;
 }
 
 const server_stats_t* stats_get(void) {
-    // Retorna ponteiro para leitura (caller deve fazer sua própria sincronização se necessário)
-    return shared_stats;
+    // Retorna uma cópia agregada de todos os processos (reescrita em cada chamada)
+    if (!shared_stats) return NULL;
+    collect_stats(&snapshot);
+    return &snapshot;
 }
 
 void stats_print(void) {
@@ -244,12 +480,9 @@ void stats_print(void) {
         return;
     }
     
-    // Fazer cópia local para evitar inconsistências durante leitura
+    // Somar os slots de todos os processos numa cópia local
     server_stats_t local_stats;
-    
-    sem_wait(stats_semaphore); // Lock
-    memcpy(&local_stats, shared_stats, sizeof(server_stats_t));
-    sem_post(stats_semaphore); // Unlock
+    collect_stats(&local_stats);
     
     printf("=== SERVER STATISTICS ===\n");
     printf("Uptime: %ld seconds\n", stats_get_uptime());
@@ -271,6 +504,25 @@ void stats_print(void) {
     printf("\nErrors:\n");
     printf("  Connection Errors: %lu\n", local_stats.connection_errors);
     printf("  Timeout Errors: %lu\n", local_stats.timeout_errors);
+    printf("  Rate Limited (429): %lu\n", local_stats.rate_limited);
+    unsigned long pool_total = local_stats.pool_busy_us + local_stats.pool_idle_us;
+    printf("\nQueue and Threads:\n");
+    printf("  Queued Now: %lu (max %lu)\n", local_stats.queue_depth, local_stats.queue_depth_max);
+    printf("  Avg Queue Wait: %.1f us (max %lu us)\n",
+           local_stats.queue_sojourns ? (double)local_stats.queue_sojourn_us / local_stats.queue_sojourns : 0.0,
+           local_stats.queue_sojourn_max_us);
+    printf("  Threads: %lu, busy %.1f%%\n", local_stats.pool_threads,
+           pool_total ? 100.0 * local_stats.pool_busy_us / pool_total : 0.0);
+    printf("  Lock Waits: %lu (%.2f ms)\n", local_stats.lock_waits, local_stats.lock_wait_us / 1000.0);
+    printf("\nFile Cache: %.2f MB\n", local_stats.cache_bytes / (1024.0 * 1024.0));
+    for (int i = 0; i < STATS_CACHE_POLICIES; i++) {
+        unsigned long lookups = local_stats.cache_hits[i] + local_stats.cache_misses[i];
+        if (lookups == 0) continue;
+        printf("  %s: %lu hits / %lu lookups (%.1f%%), %lu evicted, %lu rejected\n",
+               cache_policy_names[i], local_stats.cache_hits[i], lookups,
+               100.0 * local_stats.cache_hits[i] / lookups,
+               local_stats.cache_evictions[i], local_stats.cache_rejections[i]);
+    }
 }
 
 void stats_display(void) {
@@ -278,10 +530,7 @@ void stats_display(void) {
     
     // Versão mais compacta para output periódico
     server_stats_t local_stats;
-    
-    sem_wait(stats_semaphore); // Lock
-    memcpy(&local_stats, shared_stats, sizeof(server_stats_t));
-    sem_post(stats_semaphore); // Unlock
+    collect_stats(&local_stats);
     
     long uptime = stats_get_uptime();
     double rps = stats_get_requests_per_second();
@@ -317,22 +566,29 @@ double stats_get_requests_per_second(void) {
     
     long uptime = stats_get_uptime();
     if (uptime == 0) return 0.0;
-    
-    return (double)shared_stats->total_requests / uptime;
+
+    server_stats_t local_stats;
+    collect_stats(&local_stats);
+    return (double)local_stats.total_requests / uptime;
 }
 
 void stats_increment_connection_error(void) {
-    if (!shared_stats || !stats_semaphore) return;
-    
-    sem_wait(stats_semaphore); // Lock
-    shared_stats->connection_errors++;
-    sem_post(stats_semaphore); // Unlock
+    server_stats_t *counters = local_counters();
+    if (!counters) return;
+
+    __atomic_fetch_add(&counters->connection_errors, 1, __ATOMIC_RELAXED);
 }
 
 void stats_increment_timeout_error(void) {
-    if (!shared_stats || !stats_semaphore) return;
-    
-    sem_wait(stats_semaphore); // Lock
-    shared_stats->timeout_errors++;
-    sem_post(stats_semaphore); // Unlock
-}
\ No newline at end of file
+    server_stats_t *counters = local_counters();
+    if (!counters) return;
+
+    __atomic_fetch_add(&counters->timeout_errors, 1, __ATOMIC_RELAXED);
+}
+
+void stats_increment_rate_limited(void) {
+    server_stats_t *counters = local_counters();
+    if (!counters) return;
+
+    __atomic_fetch_add(&counters->rate_limited, 1, __ATOMIC_RELAXED);
+}
@@ -10,6 +10,20 @@
 #include <time.h>
 #include <sys/types.h>
 
+// Processos com contadores próprios no segmento partilhado (os restantes partilham um slot)
+#define STATS_MAX_SLOTS 64
+
+// Virtual hosts com contadores próprios (índice do bloco [vhost] na configuração)
+#define STATS_MAX_VHOSTS 16
+
+// Histogramas em potências de dois: o bucket 0 conta o valor 0, o bucket b conta
+// [2^(b-1), 2^b) e o último tudo o que é maior
+#define STATS_DEPTH_BUCKETS 12          // Profundidade da fila (último: >= 1024)
+#define STATS_SOJOURN_BUCKETS 20        // Espera na fila em µs (último: >= ~262 ms)
+
+// Políticas do cache de ficheiros com contadores próprios (índice = cache_policy_t: lru, tinylfu)
+#define STATS_CACHE_POLICIES 2
+
 // Estrutura para estatísticas do servidor partilhada entre processos
 typedef struct {
     // Contadores de requests por código de status
@@ -35,18 +49,54 @@ typedef struct {
     // Contadores de erro
     unsigned long connection_errors;     // Erros de conexão
     unsigned long timeout_errors;        // Timeouts
+    unsigned long rate_limited;          // Pedidos recusados pelo limite por cliente (429)
+
+    // Contadores por virtual host
+    unsigned long vhost_requests[STATS_MAX_VHOSTS];
+    unsigned long vhost_bytes[STATS_MAX_VHOSTS];
+
+    // Fila de conexões entre o event loop e as threads (por worker)
+    unsigned long queue_depth;                              // Conexões na fila agora
+    unsigned long queue_depth_max;                          // Máximo visto num push
+    unsigned long queue_depth_hist[STATS_DEPTH_BUCKETS];    // Profundidade após cada push
+    unsigned long queue_sojourns;                           // Conexões retiradas da fila
+    unsigned long queue_sojourn_us;                         // Soma do tempo passado na fila
+    unsigned long queue_sojourn_max_us;
+    unsigned long queue_sojourn_hist[STATS_SOJOURN_BUCKETS];
+
+    // Thread pool (por worker)
+    unsigned long pool_threads;          // Threads a servir
+    unsigned long pool_busy_us;          // Tempo a servir conexões, todas as threads
+    unsigned long pool_idle_us;          // Tempo à espera de uma conexão na fila
+    unsigned long lock_waits;            // Aquisições de locks que encontraram o lock ocupado
+    unsigned long lock_wait_us;          // Tempo bloqueado nesses locks
+
+    // Cache de ficheiros, por política
+    unsigned long cache_hits[STATS_CACHE_POLICIES];
+    unsigned long cache_misses[STATS_CACHE_POLICIES];
+    unsigned long cache_evictions[STATS_CACHE_POLICIES];   // Entradas expulsas para dar lugar
+    unsigned long cache_rejections[STATS_CACHE_POLICIES];  // Candidatos recusados pelo TinyLFU
+    unsigned long cache_bytes;                              // Bytes em cache agora (por worker)
 } server_stats_t;
 
 
 
 
 // Inicializa o sistema de estatísticas em memória partilhada
+// instance dá nome ao segmento (várias instâncias no mesmo host não o partilham);
+// NULL usa memória anónima, partilhada só com os processos criados depois por fork
 // Retorna 0 em sucesso, -1 em erro
-int stats_init(void);
+int stats_init(const char *instance);
 
 // Limpa recursos do sistema de estatísticas
 void stats_cleanup(void);
 
+// Deixa os objetos IPC para outro processo (stats_cleanup deixa de os remover)
+void stats_release_ownership(void);
+
+// Assume a remoção dos objetos IPC no stats_cleanup (segmento herdado num upgrade)
+void stats_take_ownership(void);
+
 // Incrementa contador para um código de status HTTP específico
 void stats_increment_request(int status_code);
 
@@ -56,12 +106,45 @@ void stats_add_bytes(size_t bytes);
 // Atualiza métricas de tempo de resposta
 void stats_update_response_time(long response_time_ms);
 
+// Conta um pedido servido por um virtual host (índice do bloco [vhost])
+void stats_add_vhost_request(int vhost, size_t bytes);
+
 // Define o número de conexões ativas
 void stats_set_active_connections(unsigned long count);
 
-// Obtém ponteiro para as estatísticas atuais (para leitura)
+// Regista a profundidade da fila depois de um push (máximo e histograma)
+void stats_record_queue_depth(unsigned long depth);
+
+// Regista o tempo que uma conexão esperou na fila
+void stats_record_queue_sojourn(unsigned long sojourn_us);
+
+// Soma tempo ocupado e parado de uma thread do pool
+void stats_add_thread_time(unsigned long busy_us, unsigned long idle_us);
+
+// Publica os valores instantâneos do worker: conexões na fila, threads do pool e
+// totais de espera em locks desde o arranque
+void stats_set_worker_gauges(unsigned long queue_depth, unsigned long threads,
+                             unsigned long lock_waits, unsigned long lock_wait_us);
+
+// Conta uma procura no cache de ficheiros (policy = cache_policy_t)
+void stats_record_cache_lookup(int policy, int hit);
+
+// Conta uma entrada que saiu do cache para dar lugar (rejected = candidato recusado na admissão)
+void stats_record_cache_eviction(int policy, int rejected);
+
+// Publica os bytes em cache do worker
+void stats_set_cache_bytes(unsigned long bytes);
+
+// Passa os contadores de um processo que terminou para o total retirado
+void stats_retire_process(pid_t pid);
+
+// Obtém um agregado das estatísticas atuais de todos os processos (para leitura)
 const server_stats_t* stats_get(void);
 
+// Copia os contadores do slot index (0..STATS_MAX_SLOTS-1) e o pid do processo dono
+// Retorna 0 se o slot está em uso, -1 se está livre ou as estatísticas não estão ativas
+int stats_get_process(int index, pid_t *pid, server_stats_t *out);
+
 // Imprime estatísticas em formato legível (para debug)
 void stats_print(void);
 
@@ -80,5 +163,8 @@ void stats_increment_connection_error(void);
 // Incrementa contador de timeouts
 void stats_increment_timeout_error(void);
 
+// Incrementa contador de pedidos recusados (429) por o cliente exceder o seu limite
+void stats_increment_rate_limited(void);
+
 
 #endif
\ No newline at end of file
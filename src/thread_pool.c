@@ -1 +1,54 @@
-// Gestão thread pool
\ No newline at end of file
+// Gestão thread pool
+
+// cria as threads de um worker e espera por elas no fim
+// a sincronização do trabalho é feita pela fila de conexões
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "thread_pool.h"
+
+// Start num_threads threads running routine(arg)
+thread_pool_t* thread_pool_create(int num_threads, thread_pool_routine_t routine, void *arg) {
+    if (num_threads < 1 || !routine) return NULL;
+
+    thread_pool_t *pool = malloc(sizeof(thread_pool_t));
+    if (!pool) {
+        perror("Failed to allocate thread pool");
+        return NULL;
+    }
+
+    pool->threads = calloc(num_threads, sizeof(pthread_t));
+    if (!pool->threads) {
+        perror("Failed to allocate threads");
+        free(pool);
+        return NULL;
+    }
+
+    pool->num_threads = 0;
+    for (int i = 0; i < num_threads; i++) {
+        int err = pthread_create(&pool->threads[i], NULL, routine, arg);
+        if (err != 0) {
+            fprintf(stderr, "Failed to create thread %d: %s\n", i, strerror(err));
+            break;
+        }
+        pool->num_threads++;
+    }
+
+    if (pool->num_threads == 0) {
+        free(pool->threads);
+        free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+// Wait for every thread to return and free the pool
+void thread_pool_destroy(thread_pool_t *pool) {
+    if (!pool) return;
+    for (int i = 0; i < pool->num_threads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    free(pool->threads);
+    free(pool);
+}
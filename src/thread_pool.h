@@ -1 +1,28 @@
-// Interface thread pool
\ No newline at end of file
+// Interface thread pool
+
+// conjunto fixo de THREADS_PER_WORKER threads criadas no arranque do worker
+// cada thread corre a mesma rotina (consumir a fila de conexões)
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <pthread.h>
+
+// Routine executed by every thread of the pool
+typedef void* (*thread_pool_routine_t)(void *arg);
+
+// Fixed-size pool of threads
+typedef struct {
+    pthread_t *threads;     // Thread handles
+    int num_threads;        // Threads successfully started
+} thread_pool_t;
+
+
+//THREAD POOL API
+// Start num_threads threads running routine(arg)
+thread_pool_t* thread_pool_create(int num_threads, thread_pool_routine_t routine, void *arg);
+
+// Wait for every thread to return and free the pool
+void thread_pool_destroy(thread_pool_t *pool);
+
+#endif
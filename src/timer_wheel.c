@@ -0,0 +1,163 @@
+// Roda de temporizadores
+
+// nível 0 tem um slot por tick, cada nível acima cobre 64x mais tempo
+// quando o nível 0 dá a volta, o slot correspondente do nível seguinte
+// é redistribuído (cascata) pelos níveis inferiores
+
+#include <stddef.h>
+#include "timer_wheel.h"
+
+// Insert timer in the slot matching its expiry relative to the current tick
+static void wheel_insert(timer_wheel_t *wheel, wheel_timer_t *timer) {
+    // Already due: fire on the next tick
+    if (timer->expires <= wheel->current_tick) timer->expires = wheel->current_tick + 1;
+
+    uint64_t delta = timer->expires - wheel->current_tick;
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 &&
+           delta >= ((uint64_t)1 << (TIMER_WHEEL_SLOT_BITS * (level + 1)))) {
+        level++;
+    }
+
+    // Clamp timers beyond the wheel's range to its last slot
+    uint64_t max_delta = ((uint64_t)1 << (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS)) - 1;
+    if (delta > max_delta) timer->expires = wheel->current_tick + max_delta;
+
+    int slot = (int)((timer->expires >> (TIMER_WHEEL_SLOT_BITS * level)) & TIMER_WHEEL_SLOT_MASK);
+    wheel_timer_t *head = &wheel->slots[level][slot];
+    timer->next = head->next;
+    timer->prev = head;
+    head->next->prev = timer;
+    head->next = timer;
+}
+
+// Unlink timer from its slot
+static void wheel_unlink(wheel_timer_t *timer) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->next = timer->prev = NULL;
+}
+
+// Move every timer of a higher level slot down to the levels below
+static void wheel_cascade(timer_wheel_t *wheel, int level) {
+    int slot = (int)((wheel->current_tick >> (TIMER_WHEEL_SLOT_BITS * level)) & TIMER_WHEEL_SLOT_MASK);
+    wheel_timer_t *head = &wheel->slots[level][slot];
+
+    // The next level only wraps when this one does
+    if (slot == 0 && level + 1 < TIMER_WHEEL_LEVELS) wheel_cascade(wheel, level + 1);
+
+    while (head->next != head) {
+        wheel_timer_t *timer = head->next;
+        wheel_unlink(timer);
+        wheel_insert(wheel, timer);
+    }
+}
+
+// Initialize an empty wheel
+void timer_wheel_init(timer_wheel_t *wheel, unsigned tick_ms, uint64_t now_ms) {
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            wheel_timer_t *head = &wheel->slots[level][slot];
+            head->next = head->prev = head;
+        }
+    }
+    wheel->current_tick = 0;
+    wheel->start_ms = now_ms;
+    wheel->tick_ms = tick_ms ? tick_ms : 1;
+    wheel->count = 0;
+}
+
+// Initialize a timer before its first use
+void timer_init(wheel_timer_t *timer, void *data) {
+    timer->next = timer->prev = NULL;
+    timer->expires = 0;
+    timer->active = 0;
+    timer->data = data;
+}
+
+// Schedule (or reschedule) timer
+void timer_wheel_add(timer_wheel_t *wheel, wheel_timer_t *timer, uint64_t expires_ms) {
+    if (timer->active) {
+        wheel_unlink(timer);
+        wheel->count--;
+    }
+
+    // Round up so a timer never fires early
+    uint64_t relative = expires_ms > wheel->start_ms ? expires_ms - wheel->start_ms : 0;
+    timer->expires = (relative + wheel->tick_ms - 1) / wheel->tick_ms;
+    timer->active = 1;
+    wheel_insert(wheel, timer);
+    wheel->count++;
+}
+
+// Remove timer if it is scheduled
+void timer_wheel_cancel(timer_wheel_t *wheel, wheel_timer_t *timer) {
+    if (!timer->active) return;
+    wheel_unlink(timer);
+    timer->active = 0;
+    wheel->count--;
+}
+
+// Fire every timer due at now_ms
+int timer_wheel_expire(timer_wheel_t *wheel, uint64_t now_ms, timer_expire_fn fn, void *arg) {
+    if (now_ms < wheel->start_ms) return 0;
+    uint64_t target = (now_ms - wheel->start_ms) / wheel->tick_ms;
+    int expired = 0;
+
+    while (wheel->current_tick < target) {
+        // Nothing scheduled: jump straight to the target tick
+        if (wheel->count == 0) {
+            wheel->current_tick = target;
+            break;
+        }
+
+        wheel->current_tick++;
+        int slot = (int)(wheel->current_tick & TIMER_WHEEL_SLOT_MASK);
+        if (slot == 0) wheel_cascade(wheel, 1);
+
+        wheel_timer_t *head = &wheel->slots[0][slot];
+        while (head->next != head) {
+            wheel_timer_t *timer = head->next;
+            wheel_unlink(timer);
+            timer->active = 0;
+            wheel->count--;
+            expired++;
+            if (fn) fn(timer, arg);
+        }
+    }
+    return expired;
+}
+
+// Call fn for every scheduled timer
+void timer_wheel_for_each(timer_wheel_t *wheel, timer_expire_fn fn, void *arg) {
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            wheel_timer_t *head = &wheel->slots[level][slot];
+            for (wheel_timer_t *timer = head->next; timer != head; timer = timer->next) {
+                fn(timer, arg);
+            }
+        }
+    }
+}
+
+// Milliseconds until the wheel needs to run again
+int timer_wheel_next_timeout(const timer_wheel_t *wheel, uint64_t now_ms) {
+    if (wheel->count == 0) return -1;
+
+    // Nearest non-empty level 0 slot, otherwise the next cascade
+    uint64_t ticks = TIMER_WHEEL_SLOTS - (wheel->current_tick & TIMER_WHEEL_SLOT_MASK);
+    for (uint64_t i = 1; i < TIMER_WHEEL_SLOTS; i++) {
+        int slot = (int)((wheel->current_tick + i) & TIMER_WHEEL_SLOT_MASK);
+        const wheel_timer_t *head = &wheel->slots[0][slot];
+        if (head->next != head) {
+            ticks = i;
+            break;
+        }
+        if (slot == 0) break;
+    }
+
+    uint64_t due_ms = wheel->start_ms + (wheel->current_tick + ticks) * wheel->tick_ms;
+    if (due_ms <= now_ms) return 0;
+    uint64_t wait = due_ms - now_ms;
+    return wait > (uint64_t)0x7fffffff ? 0x7fffffff : (int)wait;
+}
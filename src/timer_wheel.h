@@ -0,0 +1,61 @@
+// Interface timer wheel
+
+// roda de temporizadores hierárquica (4 níveis x 64 slots)
+// inserir, cancelar e expirar são O(1) para milhares de conexões
+// usada pelo event loop de cada worker para os timeouts das conexões
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+#define TIMER_WHEEL_SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+// Intrusive timer, embedded in the object it times out
+typedef struct wheel_timer {
+    struct wheel_timer *next;   // Doubly linked list of the slot
+    struct wheel_timer *prev;
+    uint64_t expires;           // Expiry tick
+    int active;                 // Currently in the wheel
+    void *data;                 // Owner (passed back on expiry)
+} wheel_timer_t;
+
+// Called for every expired timer (the timer is already removed)
+typedef void (*timer_expire_fn)(wheel_timer_t *timer, void *arg);
+
+// Hierarchical timing wheel
+typedef struct {
+    wheel_timer_t slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];  // List heads
+    uint64_t current_tick;      // Last processed tick
+    uint64_t start_ms;          // Time of tick 0
+    unsigned tick_ms;           // Resolution
+    int count;                  // Active timers
+} timer_wheel_t;
+
+
+//TIMER WHEEL API
+// Initialize an empty wheel with tick_ms resolution starting at now_ms
+void timer_wheel_init(timer_wheel_t *wheel, unsigned tick_ms, uint64_t now_ms);
+
+// Initialize a timer before its first use
+void timer_init(wheel_timer_t *timer, void *data);
+
+// Schedule (or reschedule) timer to expire at expires_ms
+void timer_wheel_add(timer_wheel_t *wheel, wheel_timer_t *timer, uint64_t expires_ms);
+
+// Remove timer if it is scheduled
+void timer_wheel_cancel(timer_wheel_t *wheel, wheel_timer_t *timer);
+
+// Fire every timer due at now_ms, returns how many expired
+int timer_wheel_expire(timer_wheel_t *wheel, uint64_t now_ms, timer_expire_fn fn, void *arg);
+
+// Call fn for every scheduled timer (fn must not add or cancel timers)
+void timer_wheel_for_each(timer_wheel_t *wheel, timer_expire_fn fn, void *arg);
+
+// Milliseconds until the wheel needs to run again, -1 if it is empty
+int timer_wheel_next_timeout(const timer_wheel_t *wheel, uint64_t now_ms);
+
+#endif
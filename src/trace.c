@@ -0,0 +1,116 @@
+// Tracing
+
+// ring buffer das linhas temporais dos pedidos mais recentes de um worker
+// cada thread reserva uma posição com um ticket atómico e publica o registo no fim;
+// quem lê ignora registos incompletos ou reescritos enquanto os copiava
+
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+
+// Column names of the phase durations, each measured from the previous phase reached
+static const char *phase_columns[TRACE_PHASES] = {
+    NULL, "connect_us", "queue_us", "parse_us", "open_us", "header_us", "send_us"
+};
+
+// Create a ring holding the last capacity requests
+trace_ring_t* trace_ring_create(uint32_t capacity) {
+    if (capacity == 0) return NULL;
+
+    trace_ring_t *ring = calloc(1, sizeof(trace_ring_t));
+    if (!ring) return NULL;
+    ring->records = calloc(capacity, sizeof(trace_record_t));
+    if (!ring->records) {
+        free(ring);
+        return NULL;
+    }
+    ring->capacity = capacity;
+    return ring;
+}
+
+// Free the ring
+void trace_ring_destroy(trace_ring_t *ring) {
+    if (!ring) return;
+    free(ring->records);
+    free(ring);
+}
+
+// Store a finished request in the slot of the next ticket
+void trace_ring_record(trace_ring_t *ring, const trace_timeline_t *timeline, const char *method,
+                       const char *path, int status, uint64_t bytes) {
+    if (!ring || !timeline) return;
+
+    uint64_t ticket = __atomic_fetch_add(&ring->next, 1, __ATOMIC_RELAXED);
+    trace_record_t *record = &ring->records[ticket % ring->capacity];
+
+    // Readers skip the slot until seq names this ticket
+    __atomic_store_n(&record->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    record->timeline = *timeline;
+    record->bytes = bytes;
+    record->status = status;
+    snprintf(record->method, sizeof(record->method), "%s", method ? method : "-");
+    snprintf(record->path, sizeof(record->path), "%s", path ? path : "-");
+    // One field per column in the dump
+    for (char *c = record->path; *c; c++) {
+        if ((unsigned char)*c <= ' ') *c = '_';
+    }
+    __atomic_store_n(&record->seq, ticket + 1, __ATOMIC_RELEASE);
+}
+
+// Copy the record of a ticket, returns -1 if it is incomplete or was overwritten meanwhile
+static int trace_ring_read(const trace_ring_t *ring, uint64_t ticket, trace_record_t *copy) {
+    const trace_record_t *record = &ring->records[ticket % ring->capacity];
+    if (__atomic_load_n(&record->seq, __ATOMIC_ACQUIRE) != ticket + 1) return -1;
+    memcpy(copy, record, sizeof(trace_record_t));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&record->seq, __ATOMIC_RELAXED) != ticket + 1) return -1;
+    copy->path[TRACE_PATH_SIZE - 1] = '\0';
+    copy->method[sizeof(copy->method) - 1] = '\0';
+    return 0;
+}
+
+// Write the stored requests oldest first
+int trace_ring_dump(const trace_ring_t *ring, FILE *out) {
+    if (!ring || !out) return 0;
+
+    fprintf(out, "# seq status method path bytes");
+    for (int phase = 1; phase < TRACE_PHASES; phase++) fprintf(out, " %s", phase_columns[phase]);
+    fprintf(out, " total_us\n");
+
+    uint64_t end = __atomic_load_n(&ring->next, __ATOMIC_ACQUIRE);
+    uint64_t start = end > ring->capacity ? end - ring->capacity : 0;
+    int written = 0;
+    for (uint64_t ticket = start; ticket < end; ticket++) {
+        trace_record_t record;
+        if (trace_ring_read(ring, ticket, &record) != 0) continue;
+
+        const uint64_t *at = record.timeline.at_us;
+        fprintf(out, "%lu %d %s %s %lu", (unsigned long)ticket + 1, record.status, record.method,
+                record.path, (unsigned long)record.bytes);
+
+        // The total is server-side time, the wait for the first request is left out
+        int first = -1;
+        int previous = -1;
+        for (int phase = 0; phase < TRACE_PHASES; phase++) {
+            if (phase > 0) {
+                if (at[phase] && previous >= 0) {
+                    fprintf(out, " %lu", (unsigned long)(at[phase] - at[previous]));
+                } else {
+                    fprintf(out, " -");
+                }
+            }
+            if (at[phase]) {
+                if (first < 0 && phase >= TRACE_QUEUED) first = phase;
+                previous = phase;
+            }
+        }
+        if (first >= 0 && at[TRACE_LAST_BYTE]) {
+            fprintf(out, " %lu\n", (unsigned long)(at[TRACE_LAST_BYTE] - at[first]));
+        } else {
+            fprintf(out, " -\n");
+        }
+        written++;
+    }
+    return written;
+}
@@ -0,0 +1,95 @@
+// Interface tracing
+
+// pontos de instrumentação no caminho de um pedido, em dois níveis:
+// sondas USDT (sys/sdt.h, provider "httpd") que são um nop até um tracer
+// (bpftrace, perf, systemtap) se ligar a elas
+// e, com TRACE_REQUESTS, a linha temporal de cada pedido (fila, parse, disco, rede)
+// guardada num ring buffer por worker e escrita em ficheiro com SIGUSR1
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Probes (arguments in order):
+//   accept(fd)                     connection taken by the event loop
+//   enqueue(fd, depth)             handed to the connection queue
+//   dequeue(fd, sojourn_us)        taken by a serving thread
+//   parse_done(fd, ok, path)       request header parsed (path NULL if it failed)
+//   cache_lookup(path, hit)        bundle index or file cache lookup
+//   open_stat(path, status)        file opened and stat'ed (status 200 or the error sent)
+//   first_byte(fd, status)         response header written
+//   last_byte(fd, status, bytes)   response complete
+// Builds without sys/sdt.h (or with -DTRACE_NO_USDT) compile them out.
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>) && !defined(TRACE_NO_USDT)
+#include <sys/sdt.h>
+#define TRACE_USDT 1
+#endif
+#endif
+
+#ifdef TRACE_USDT
+#define TRACE_PROBE1(name, a) DTRACE_PROBE1(httpd, name, a)
+#define TRACE_PROBE2(name, a, b) DTRACE_PROBE2(httpd, name, a, b)
+#define TRACE_PROBE3(name, a, b, c) DTRACE_PROBE3(httpd, name, a, b, c)
+#else
+#define TRACE_PROBE1(name, a) ((void)(a))
+#define TRACE_PROBE2(name, a, b) ((void)(a), (void)(b))
+#define TRACE_PROBE3(name, a, b, c) ((void)(a), (void)(b), (void)(c))
+#endif
+
+// Path bytes kept per traced request
+#define TRACE_PATH_SIZE 64
+
+// Moments in the life of one request (CLOCK_MONOTONIC microseconds, 0 = not reached)
+typedef enum {
+    TRACE_ACCEPTED,     // Connection accepted (first request of a connection only)
+    TRACE_QUEUED,       // Connection queued (first request of each dispatch)
+    TRACE_DEQUEUED,     // Thread started on the request
+    TRACE_PARSED,       // Header parsed
+    TRACE_OPENED,       // File (or bundle entry) found and stat'ed
+    TRACE_FIRST_BYTE,   // Response header sent
+    TRACE_LAST_BYTE,    // Response complete
+    TRACE_PHASES
+} trace_phase_t;
+
+// Timestamps of the request a connection is serving
+typedef struct {
+    uint64_t at_us[TRACE_PHASES];
+} trace_timeline_t;
+
+// One finished request in the ring
+typedef struct {
+    uint64_t seq;                   // Ticket + 1 once complete, 0 while being written
+    trace_timeline_t timeline;
+    uint64_t bytes;
+    int status;
+    char method[8];
+    char path[TRACE_PATH_SIZE];
+} trace_record_t;
+
+// Fixed-size ring of the most recent requests, written by every serving thread
+typedef struct {
+    trace_record_t *records;
+    uint32_t capacity;
+    uint64_t next;                  // Tickets handed out
+} trace_ring_t;
+
+
+//TRACE API
+// Create a ring holding the last capacity requests, NULL if capacity is 0 or on error
+trace_ring_t* trace_ring_create(uint32_t capacity);
+
+// Free the ring
+void trace_ring_destroy(trace_ring_t *ring);
+
+// Store a finished request, overwriting the oldest (lock-free, any thread)
+void trace_ring_record(trace_ring_t *ring, const trace_timeline_t *timeline, const char *method,
+                       const char *path, int status, uint64_t bytes);
+
+// Write the stored requests oldest first, one line each with the time spent per phase
+// ("-" where a phase was not reached). Returns the number of requests written.
+int trace_ring_dump(const trace_ring_t *ring, FILE *out);
+
+#endif
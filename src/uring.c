@@ -0,0 +1,246 @@
+// io_uring sem liburing
+
+// mapeia os anéis de submissão/conclusão devolvidos por io_uring_setup
+// publica SQEs e consome CQEs com barreiras acquire/release
+// regista ficheiros, buffers fixos e anéis de buffers fornecidos
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <time.h>
+#include "uring.h"
+
+// Thin syscall wrappers (glibc does not provide them)
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                              unsigned flags, const void *arg, size_t argsz) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, const void *arg, unsigned nr) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr);
+}
+
+// Create a ring with at least entries slots
+int uring_init(uring_t *ring, unsigned entries) {
+    struct io_uring_params params;
+    memset(ring, 0, sizeof(uring_t));
+    memset(&params, 0, sizeof(params));
+    ring->ring_fd = -1;
+
+    int fd = sys_io_uring_setup(entries, &params);
+    if (fd < 0) return -errno;
+
+    ring->ring_fd = fd;
+    ring->features = params.features;
+    ring->sq_entries = params.sq_entries;
+    ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    // Both rings share one mapping on kernels with IORING_FEAT_SINGLE_MMAP
+    int single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        if (ring->cq_size > ring->sq_size) ring->sq_size = ring->cq_size;
+        ring->cq_size = ring->sq_size;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) goto fail;
+
+    if (single_mmap) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) goto fail;
+    }
+
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) goto fail;
+
+    char *sq = ring->sq_ptr;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->sqe_tail = *ring->sq_tail;
+
+    char *cq = ring->cq_ptr;
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    return 0;
+
+fail:;
+    int saved = errno;
+    uring_exit(ring);
+    return -saved;
+}
+
+// Unmap and close the ring
+void uring_exit(uring_t *ring) {
+    if (ring->sqes && ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ptr && ring->cq_ptr != MAP_FAILED && ring->cq_ptr != ring->sq_ptr) {
+        munmap(ring->cq_ptr, ring->cq_size);
+    }
+    if (ring->sq_ptr && ring->sq_ptr != MAP_FAILED) munmap(ring->sq_ptr, ring->sq_size);
+    if (ring->ring_fd >= 0) close(ring->ring_fd);
+    memset(ring, 0, sizeof(uring_t));
+    ring->ring_fd = -1;
+}
+
+// Get a zeroed SQE, NULL if the submission queue is full
+struct io_uring_sqe* uring_get_sqe(uring_t *ring) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sqe_tail - head >= ring->sq_entries) return NULL;
+
+    unsigned index = ring->sqe_tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    ring->sq_array[index] = index;
+    ring->sqe_tail++;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+// Free submission queue slots
+unsigned uring_sq_space(uring_t *ring) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    return ring->sq_entries - (ring->sqe_tail - head);
+}
+
+// Submit pending SQEs and wait for wait_nr completions
+int uring_submit_and_wait(uring_t *ring, unsigned wait_nr, int timeout_ms) {
+    unsigned to_submit = ring->sqe_tail - *ring->sq_tail;
+    __atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+
+    unsigned flags = wait_nr ? IORING_ENTER_GETEVENTS : 0;
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    const void *argp = NULL;
+    size_t argsz = 0;
+
+    if (wait_nr && timeout_ms >= 0 && (ring->features & IORING_FEAT_EXT_ARG)) {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+        memset(&arg, 0, sizeof(arg));
+        arg.sigmask_sz = _NSIG / 8;
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+        flags |= IORING_ENTER_EXT_ARG;
+        argp = &arg;
+        argsz = sizeof(arg);
+    }
+
+    int ret = sys_io_uring_enter(ring->ring_fd, to_submit, wait_nr, flags, argp, argsz);
+    return ret < 0 ? -errno : ret;
+}
+
+// Return the next completion without waiting
+struct io_uring_cqe* uring_peek_cqe(uring_t *ring) {
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    if (head == tail) return NULL;
+    return &ring->cqes[head & *ring->cq_mask];
+}
+
+// Mark the completion returned by uring_peek_cqe as consumed
+void uring_cqe_seen(uring_t *ring) {
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+// Register a (possibly sparse) fixed file table
+int uring_register_files(uring_t *ring, const int *fds, unsigned nr) {
+    int ret = sys_io_uring_register(ring->ring_fd, IORING_REGISTER_FILES, fds, nr);
+    return ret < 0 ? -errno : 0;
+}
+
+// Register fixed buffers
+int uring_register_buffers(uring_t *ring, const struct iovec *iovecs, unsigned nr) {
+    int ret = sys_io_uring_register(ring->ring_fd, IORING_REGISTER_BUFFERS, iovecs, nr);
+    return ret < 0 ? -errno : 0;
+}
+
+// Create and register a provided buffer ring
+int uring_buf_ring_init(uring_t *ring, uring_buf_ring_t *buf_ring, uint16_t bgid,
+                        unsigned entries, unsigned buf_size) {
+    memset(buf_ring, 0, sizeof(uring_buf_ring_t));
+    if (entries == 0 || (entries & (entries - 1)) != 0) return -EINVAL;
+
+    // The ring must be page aligned, mmap guarantees it
+    buf_ring->ring_size = entries * sizeof(struct io_uring_buf);
+    void *mem = mmap(NULL, buf_ring->ring_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return -errno;
+
+    buf_ring->buffers = malloc((size_t)entries * buf_size);
+    if (!buf_ring->buffers) {
+        munmap(mem, buf_ring->ring_size);
+        return -ENOMEM;
+    }
+
+    buf_ring->br = mem;
+    buf_ring->entries = entries;
+    buf_ring->buf_size = buf_size;
+    buf_ring->bgid = bgid;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)mem;
+    reg.ring_entries = entries;
+    reg.bgid = bgid;
+    if (sys_io_uring_register(ring->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        int saved = errno;
+        free(buf_ring->buffers);
+        munmap(mem, buf_ring->ring_size);
+        memset(buf_ring, 0, sizeof(uring_buf_ring_t));
+        return -saved;
+    }
+
+    for (unsigned bid = 0; bid < entries; bid++) {
+        uring_buf_ring_recycle(buf_ring, bid);
+    }
+    return 0;
+}
+
+// Unregister and free a provided buffer ring
+void uring_buf_ring_free(uring_t *ring, uring_buf_ring_t *buf_ring) {
+    if (!buf_ring->br) return;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.bgid = buf_ring->bgid;
+    sys_io_uring_register(ring->ring_fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+
+    munmap(buf_ring->br, buf_ring->ring_size);
+    free(buf_ring->buffers);
+    memset(buf_ring, 0, sizeof(uring_buf_ring_t));
+}
+
+// Pointer to the data of buffer bid
+char* uring_buf_ring_buffer(uring_buf_ring_t *buf_ring, unsigned bid) {
+    return buf_ring->buffers + (size_t)bid * buf_ring->buf_size;
+}
+
+// Give buffer bid back to the kernel
+void uring_buf_ring_recycle(uring_buf_ring_t *buf_ring, unsigned bid) {
+    struct io_uring_buf *buf = &buf_ring->br->bufs[buf_ring->tail & (buf_ring->entries - 1)];
+    buf->addr = (uint64_t)(uintptr_t)uring_buf_ring_buffer(buf_ring, bid);
+    buf->len = buf_ring->buf_size;
+    buf->bid = (uint16_t)bid;
+    buf_ring->tail++;
+    __atomic_store_n(&buf_ring->br->tail, buf_ring->tail, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,95 @@
+// Interface io_uring
+
+// camada fina sobre as syscalls io_uring_setup/enter/register (sem liburing)
+// usada pelo backend io_uring dos workers
+
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/io_uring.h>
+
+// Submission/completion rings mapped from the kernel
+typedef struct {
+    int ring_fd;
+    unsigned features;
+
+    // Submission queue
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned sq_entries;
+    unsigned sqe_tail;          // Next SQE handed out (not yet published)
+    struct io_uring_sqe *sqes;
+
+    // Completion queue
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    // Mappings to release on exit
+    void *sq_ptr;
+    size_t sq_size;
+    void *cq_ptr;
+    size_t cq_size;
+    size_t sqes_size;
+} uring_t;
+
+// Provided buffer ring used with IOSQE_BUFFER_SELECT
+typedef struct {
+    struct io_uring_buf_ring *br;
+    char *buffers;
+    unsigned entries;
+    unsigned buf_size;
+    uint16_t bgid;
+    uint16_t tail;
+    size_t ring_size;
+} uring_buf_ring_t;
+
+
+//URING API
+// Create a ring with at least entries slots, returns 0 or -errno
+int uring_init(uring_t *ring, unsigned entries);
+
+// Unmap and close the ring
+void uring_exit(uring_t *ring);
+
+// Get a zeroed SQE, NULL if the submission queue is full
+struct io_uring_sqe* uring_get_sqe(uring_t *ring);
+
+// Free submission queue slots
+unsigned uring_sq_space(uring_t *ring);
+
+// Submit pending SQEs and wait for wait_nr completions.
+// timeout_ms < 0 waits forever. Returns submitted count or -errno (-ETIME on timeout).
+int uring_submit_and_wait(uring_t *ring, unsigned wait_nr, int timeout_ms);
+
+// Return the next completion without waiting, NULL if none
+struct io_uring_cqe* uring_peek_cqe(uring_t *ring);
+
+// Mark the completion returned by uring_peek_cqe as consumed
+void uring_cqe_seen(uring_t *ring);
+
+// Register a (possibly sparse, -1 entries) fixed file table
+int uring_register_files(uring_t *ring, const int *fds, unsigned nr);
+
+// Register fixed buffers for READ_FIXED/WRITE_FIXED
+int uring_register_buffers(uring_t *ring, const struct iovec *iovecs, unsigned nr);
+
+// Create and register a provided buffer ring of entries buffers (power of two)
+int uring_buf_ring_init(uring_t *ring, uring_buf_ring_t *buf_ring, uint16_t bgid,
+                        unsigned entries, unsigned buf_size);
+
+// Unregister and free a provided buffer ring
+void uring_buf_ring_free(uring_t *ring, uring_buf_ring_t *buf_ring);
+
+// Pointer to the data of buffer bid
+char* uring_buf_ring_buffer(uring_buf_ring_t *buf_ring, unsigned bid);
+
+// Give buffer bid back to the kernel
+void uring_buf_ring_recycle(uring_buf_ring_t *buf_ring, unsigned bid);
+
+#endif
@@ -0,0 +1,224 @@
+// Aquecimento do cache
+
+// conjunto de ficheiros (host, caminho) com contagem de acessos, indexado por hash
+// para juntar as várias fontes: snapshot gravado, access log e os caches dos workers
+// a gravação passa por um ficheiro temporário renomeado, quem lê nunca vê meio ficheiro
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "warmup.h"
+#include "http.h"
+
+// Slot of the index for a hash
+static int index_slot(const warmup_set_t *set, uint32_t hash, int probe) {
+    return (int)((hash + (uint32_t)probe) & (uint32_t)(set->index_size - 1));
+}
+
+// Hash of a (host, path) pair
+static uint32_t entry_hash(const char *host, const char *path) {
+    return http_path_hash(path) ^ (http_path_hash(host) * 0x9E3779B1u);
+}
+
+// Point the index at every entry again (after the entries moved)
+static void rebuild_index(warmup_set_t *set) {
+    for (int i = 0; i < set->index_size; i++) set->index[i] = -1;
+    for (int i = 0; i < set->count; i++) {
+        uint32_t hash = entry_hash(set->entries[i].host, set->entries[i].path);
+        int probe = 0;
+        while (set->index[index_slot(set, hash, probe)] >= 0) probe++;
+        set->index[index_slot(set, hash, probe)] = i;
+    }
+}
+
+// Create an empty set
+warmup_set_t* warmup_set_create(int capacity) {
+    if (capacity <= 0) return NULL;
+
+    warmup_set_t *set = calloc(1, sizeof(warmup_set_t));
+    if (!set) return NULL;
+    set->index_size = 1;
+    while (set->index_size < capacity * 2) set->index_size <<= 1;
+    set->entries = malloc((size_t)capacity * sizeof(warmup_entry_t));
+    set->index = malloc((size_t)set->index_size * sizeof(int));
+    if (!set->entries || !set->index) {
+        perror("Failed to allocate warm-up set");
+        warmup_set_destroy(set);
+        return NULL;
+    }
+    set->capacity = capacity;
+    rebuild_index(set);
+    return set;
+}
+
+// Free the set
+void warmup_set_destroy(warmup_set_t *set) {
+    if (!set) return;
+    free(set->entries);
+    free(set->index);
+    free(set);
+}
+
+// Merge accesses into the entry of host/path, creating it if there is room
+int warmup_add(warmup_set_t *set, const char *host, const char *path, unsigned frequency) {
+    if (!set || !path || path[0] != '/' || strlen(path) >= MAX_PATH_LENGTH) return -1;
+    if (!host) host = "";
+    if (strlen(host) >= MAX_HOST_NAME) return -1;
+
+    uint32_t hash = entry_hash(host, path);
+    int probe = 0;
+    int slot;
+    while (set->index[slot = index_slot(set, hash, probe)] >= 0) {
+        warmup_entry_t *entry = &set->entries[set->index[slot]];
+        if (strcmp(entry->path, path) == 0 && strcmp(entry->host, host) == 0) {
+            entry->frequency += frequency;
+            return 0;
+        }
+        probe++;
+    }
+    if (set->count == set->capacity) return -1;
+
+    warmup_entry_t *entry = &set->entries[set->count];
+    strcpy(entry->host, host);
+    strcpy(entry->path, path);
+    entry->frequency = frequency;
+    entry->order = set->count;
+    set->index[slot] = set->count++;
+    return 0;
+}
+
+// Hottest first, then first added
+static int compare_entries(const void *a, const void *b) {
+    const warmup_entry_t *x = a, *y = b;
+    if (x->frequency != y->frequency) return x->frequency > y->frequency ? -1 : 1;
+    return x->order - y->order;
+}
+
+// Sort by frequency
+void warmup_sort(warmup_set_t *set) {
+    if (!set || set->count == 0) return;
+    qsort(set->entries, set->count, sizeof(warmup_entry_t), compare_entries);
+    rebuild_index(set);
+}
+
+// Write the set and rename it over filename
+int warmup_save(const warmup_set_t *set, const char *filename) {
+    if (!set || !filename || !filename[0]) return -1;
+
+    char temp[MAX_PATH_LENGTH + 32];
+    int written = snprintf(temp, sizeof(temp), "%s.tmp.%d", filename, getpid());
+    if (written < 0 || (size_t)written >= sizeof(temp)) return -1;
+
+    FILE *fp = fopen(temp, "w");
+    if (!fp) {
+        fprintf(stderr, "Failed to write cache snapshot %s: %s\n", temp, strerror(errno));
+        return -1;
+    }
+    fprintf(fp, "# frequency host path (host - = default root)\n");
+    for (int i = 0; i < set->count; i++) {
+        const warmup_entry_t *entry = &set->entries[i];
+        fprintf(fp, "%u %s %s\n", entry->frequency, entry->host[0] ? entry->host : "-", entry->path);
+    }
+    if (fclose(fp) != 0 || rename(temp, filename) != 0) {
+        fprintf(stderr, "Failed to write cache snapshot %s: %s\n", filename, strerror(errno));
+        unlink(temp);
+        return -1;
+    }
+    return 0;
+}
+
+// Read "frequency host path" lines; the path is the rest of the line
+int warmup_load(warmup_set_t *set, const char *filename) {
+    if (!set || !filename || !filename[0]) return -1;
+    FILE *fp = fopen(filename, "r");
+    if (!fp) return -1;
+
+    char line[MAX_HOST_NAME + MAX_PATH_LENGTH + 32];
+    int loaded = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '#' || line[0] == '\0') continue;
+
+        unsigned frequency;
+        char host[MAX_HOST_NAME];
+        int path_start = 0;
+        if (sscanf(line, "%u %127s %n", &frequency, host, &path_start) != 2 || path_start == 0) continue;
+        if (warmup_add(set, strcmp(host, "-") == 0 ? "" : host, line + path_start, frequency) == 0) {
+            loaded++;
+        }
+    }
+    fclose(fp);
+    return loaded;
+}
+
+// Count one access log line if it is a GET answered 200; directories map to their index.html
+static int replay_line(warmup_set_t *set, const char *line) {
+    const char *request = strstr(line, "\"GET /");
+    if (!request) return 0;
+    const char *path = request + 5;
+    const char *end = strstr(path, " HTTP/1.1\" ");
+    if (!end || atoi(end + 11) != 200) return 0;
+
+    char key[MAX_PATH_LENGTH];
+    size_t len = end - path;
+    if (len + sizeof("index.html") > sizeof(key)) return 0;
+    memcpy(key, path, len);
+    key[len] = '\0';
+    if (key[len - 1] == '/') strcpy(key + len, "index.html");
+    return warmup_add(set, "", key, 1) == 0;
+}
+
+// Read the tail of the log and count its last max_lines lines
+int warmup_replay_log(warmup_set_t *set, const char *log_file, int max_lines) {
+    if (!set || !log_file || max_lines <= 0) return -1;
+    int fd = open(log_file, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    size_t tail = (size_t)max_lines * WARMUP_LOG_LINE_ESTIMATE;
+    if (tail > (size_t)st.st_size) tail = st.st_size;
+    char *buffer = malloc(tail + 1);
+    if (!buffer) {
+        close(fd);
+        return -1;
+    }
+    off_t start = st.st_size - tail;
+    size_t got = 0;
+    while (got < tail) {
+        ssize_t n = pread(fd, buffer + got, tail - got, start + got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += n;
+    }
+    close(fd);
+    buffer[got] = '\0';
+
+    // A tail starting mid-file begins with part of a line; keep the last max_lines lines
+    char *line = buffer;
+    if (start > 0) {
+        char *newline = strchr(line, '\n');
+        line = newline ? newline + 1 : buffer + got;
+    }
+    int lines = 0;
+    for (char *c = line; *c; c++) lines += *c == '\n';
+    for (; lines > max_lines; lines--) line = strchr(line, '\n') + 1;
+
+    int counted = 0;
+    while (*line) {
+        char *newline = strchr(line, '\n');
+        if (!newline) break;    // Being written
+        *newline = '\0';
+        counted += replay_line(set, line);
+        line = newline + 1;
+    }
+    free(buffer);
+    return counted;
+}
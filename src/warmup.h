@@ -0,0 +1,62 @@
+// Interface warm-up
+
+// conjunto quente de ficheiros para aquecer os caches depois de um arranque:
+// gravado no fim de um worker (caminho, host e frequência de cada entrada) e lido
+// no arranque seguinte, mais os pedidos recentes do access log se configurado
+// o worker percorre-o do mais quente para o mais frio numa thread de fundo
+
+#ifndef WARMUP_H
+#define WARMUP_H
+
+#include "config.h"
+
+// Files kept in a hot set (snapshot lines and distinct replayed paths)
+#define WARMUP_MAX_ENTRIES 4096
+
+// Bytes read from the end of the access log per replayed line
+#define WARMUP_LOG_LINE_ESTIMATE 256
+
+// One file of the hot set
+typedef struct {
+    char host[MAX_HOST_NAME];       // First name of its virtual host, "" = default root
+    char path[MAX_PATH_LENGTH];     // Request path as the cache keys it
+    unsigned frequency;             // Accesses seen (summed over merged sources)
+    int order;                      // Insertion order, breaks frequency ties
+} warmup_entry_t;
+
+// Distinct (host, path) pairs with an index for merging
+typedef struct {
+    warmup_entry_t *entries;
+    int count;
+    int capacity;
+    int *index;                     // Open addressing, 2 * capacity slots, -1 = empty
+    int index_size;
+} warmup_set_t;
+
+
+//WARMUP API
+// Create an empty set of up to capacity files, NULL on error
+warmup_set_t* warmup_set_create(int capacity);
+
+// Free the set
+void warmup_set_destroy(warmup_set_t *set);
+
+// Add frequency accesses of host/path ("" or NULL host = default root), merging
+// with an existing entry. Returns 0, or -1 if the set is full or the path invalid.
+int warmup_add(warmup_set_t *set, const char *host, const char *path, unsigned frequency);
+
+// Order the entries hottest first (ties keep insertion order)
+void warmup_sort(warmup_set_t *set);
+
+// Write the set to filename ("frequency host path" lines, host "-" for the default root)
+// through a temporary file renamed into place. Returns 0 on success, -1 on error.
+int warmup_save(const warmup_set_t *set, const char *filename);
+
+// Merge a file written by warmup_save. Returns the lines read, -1 if it cannot be opened.
+int warmup_load(warmup_set_t *set, const char *filename);
+
+// Merge the GET requests answered 200 among the last max_lines lines of an access log
+// (default root: the log has no Host). Returns the requests counted, -1 on error.
+int warmup_replay_log(warmup_set_t *set, const char *log_file, int max_lines);
+
+#endif
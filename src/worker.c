@@ -1 +1,2036 @@
-// Processos worker
\ No newline at end of file
+// Processos worker
+
+// o event loop (epoll ou io_uring) aceita conexões e espera por dados
+// conexões com dados são colocadas na fila e servidas pelas threads do pool
+// no backend io_uring cada thread tem o seu próprio ring para abrir e ler ficheiros
+// (openat2 + statx + read encadeados numa única submissão; o resto do corpo segue
+// por splice do descritor fixo para o socket através de um pipe da thread)
+// raízes em diretório têm um cache de ficheiros em memória (cache.c): um acerto sai
+// num único sendmsg sem abrir o ficheiro, uma falha carrega-o enquanto o envia
+// no arranque uma thread de fundo aquece os caches com o conjunto quente gravado pelo
+// worker anterior (CACHE_SNAPSHOT) e/ou o fim do access log, sem atrasar o accept
+// cada conexão tem um timer na roda do worker (leitura do header, keep-alive, escrita)
+// SIGHUP relê a configuração e publica uma nova versão (RCU) sem parar as threads
+// SIGUSR1 escreve as linhas temporais dos últimos pedidos (TRACE_REQUESTS) em ficheiro
+// cada pedido lido paga um token do cliente (RATE_LIMIT_RPS); sem tokens recebe
+// um 429 pré-calculado e a conexão fecha, e um cliente já sem tokens é recusado
+// pelo event loop antes de ocupar a fila
+// SIGTERM deixa de aceitar, fecha as conexões keep-alive paradas e espera pelas restantes
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <sys/ioctl.h>
+#include <linux/openat2.h>
+#include "worker.h"
+#include "http.h"
+#include "logger.h"
+#include "stats.h"
+#include "rate_limit.h"
+
+// user_data/epoll tags for non-connection events (never valid pointers)
+#define TAG_ACCEPT 1
+#define TAG_WAKEUP 2
+#define TAG_CANCEL 3
+
+// Set to 0 by SIGTERM/SIGINT
+static volatile sig_atomic_t worker_running = 1;
+
+// Wakeup eventfd the signal handler writes to (self-pipe)
+static int worker_signal_fd = -1;
+
+// Set by SIGHUP
+static volatile sig_atomic_t worker_reload_requested = 0;
+
+// Set by SIGUSR1
+static volatile sig_atomic_t worker_trace_dump_requested = 0;
+
+// Per-thread state of the io_uring file path
+typedef struct {
+    uring_t ring;           // Private ring, registered buffer + one direct file slot
+    char *file_buffer;      // Registered buffer for READ_FIXED
+    int pipe_fds[2];        // Splice pipe for bodies past the first chunk
+    size_t pipe_size;       // Its capacity (most bytes spliced at once)
+    int ready;              // Ring initialized
+    arena_pool_t *arenas;   // Request arenas (only used by this thread)
+    int index;              // Slot in worker->thread_epochs
+} worker_thread_t;
+
+// Signal handler: flags the event loop and wakes it (async-signal-safe only)
+static void worker_signal_handler(int sig) {
+    int saved_errno = errno;
+    if (sig == SIGHUP) {
+        worker_reload_requested = 1;
+    } else if (sig == SIGUSR1) {
+        worker_trace_dump_requested = 1;
+    } else {
+        worker_running = 0;
+    }
+    if (worker_signal_fd >= 0) {
+        uint64_t one = 1;
+        ssize_t ret = write(worker_signal_fd, &one, sizeof(one));
+        (void)ret;
+    }
+    errno = saved_errno;
+}
+
+// Current configuration (valid until the calling thread leaves its connection)
+static const server_config_t* worker_config(worker_t *worker) {
+    return __atomic_load_n(&worker->config, __ATOMIC_ACQUIRE);
+}
+
+// Thread starts using configuration versions
+static void worker_thread_enter(worker_t *worker, worker_thread_t *thread) {
+    uint64_t epoch = __atomic_load_n(&worker->config_epoch, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&worker->thread_epochs[thread->index], epoch, __ATOMIC_SEQ_CST);
+}
+
+// Thread no longer holds any configuration pointer
+static void worker_thread_leave(worker_t *worker, worker_thread_t *thread) {
+    __atomic_store_n(&worker->thread_epochs[thread->index], 0, __ATOMIC_RELEASE);
+}
+
+// Free replaced configurations no thread can still be reading (event loop)
+static void worker_reclaim_configs(worker_t *worker) {
+    if (worker->num_retired == 0) return;
+
+    uint64_t oldest = UINT64_MAX;
+    for (int i = 0; i < worker->registered_threads; i++) {
+        uint64_t epoch = __atomic_load_n(&worker->thread_epochs[i], __ATOMIC_SEQ_CST);
+        if (epoch != 0 && epoch < oldest) oldest = epoch;
+    }
+
+    int kept = 0;
+    for (int i = 0; i < worker->num_retired; i++) {
+        if (worker->retired_epoch[i] <= oldest) {
+            config_destroy(worker->retired[i]);
+        } else {
+            worker->retired[kept] = worker->retired[i];
+            worker->retired_epoch[kept] = worker->retired_epoch[i];
+            kept++;
+        }
+    }
+    worker->num_retired = kept;
+}
+
+// Cache bytes of a virtual host index (-1 = the default host)
+static size_t worker_cache_capacity(const server_config_t *config, int vhost) {
+    return (size_t)config_get_vhost_cache_size(config, vhost) * 1024 * 1024;
+}
+
+// Split what RLIMIT_NOFILE leaves after the connections, threads and the worker's own
+// descriptors between the caches, as the open files their large entries may keep.
+// The soft limit is raised to the hard one first.
+static void worker_limit_cache_files(worker_t *worker, int threads) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0) return;
+    if (limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &limit) != 0) getrlimit(RLIMIT_NOFILE, &limit);
+    }
+    if (limit.rlim_cur == RLIM_INFINITY) return;
+
+    int caches = worker->cache != NULL;
+    for (int i = 0; i < MAX_VHOSTS; i++) caches += worker->vhost_caches[i] != NULL;
+    if (caches == 0) return;
+
+    rlim_t reserved = WORKER_MAX_CONNECTIONS + WORKER_RESERVED_FILES + 2 * (rlim_t)threads;
+    unsigned long share = limit.rlim_cur > reserved ? (limit.rlim_cur - reserved) / caches : 0;
+    if (share == 0) share = 1;      // 0 would mean no limit
+    cache_set_max_files(worker->cache, share);
+    for (int i = 0; i < MAX_VHOSTS; i++) cache_set_max_files(worker->vhost_caches[i], share);
+}
+
+// SIGHUP: re-read the file and publish the settings that change in place.
+// Port, threads and document root stay; the master respawns the worker for those.
+static void worker_reload_config(worker_t *worker) {
+    worker_reload_requested = 0;
+    worker_reclaim_configs(worker);
+    if (worker->num_retired == WORKER_MAX_RETIRED_CONFIGS) {
+        logger_log(LOG_WARNING, "Worker %d: previous configurations still in use, reload skipped",
+                   getpid());
+        return;
+    }
+
+    server_config_t *loaded = config_reload(worker->config);
+    server_config_t *next = loaded ? config_duplicate(worker->config) : NULL;
+    if (!next) {
+        logger_log(LOG_ERROR, "Worker %d: configuration reload failed, keeping the current one",
+                   getpid());
+        config_destroy(loaded);
+        return;
+    }
+    config_copy_reloadable(next, loaded);
+    config_destroy(loaded);
+
+    // Publish, then retire the old version under the new epoch
+    server_config_t *old = worker->config;
+    __atomic_store_n(&worker->config, next, __ATOMIC_RELEASE);
+    uint64_t epoch = __atomic_add_fetch(&worker->config_epoch, 1, __ATOMIC_SEQ_CST);
+    worker->retired[worker->num_retired] = old;
+    worker->retired_epoch[worker->num_retired] = epoch;
+    worker->num_retired++;
+
+    // CACHE_SIZE_MB and CACHE_SHARE apply in place (the master respawns the workers when a
+    // root's cache turns on or off); cached headers carry the old MIME types
+    if (!config_same_mime_types(old, next)) {
+        cache_clear(worker->cache);
+        for (int i = 0; i < config_get_num_vhosts(next); i++) cache_clear(worker->vhost_caches[i]);
+    }
+    int large_share = config_get_cache_large_share(next);
+    cache_set_capacity(worker->cache, worker_cache_capacity(next, -1), large_share);
+    for (int i = 0; i < config_get_num_vhosts(next); i++) {
+        cache_set_capacity(worker->vhost_caches[i], worker_cache_capacity(next, i), large_share);
+    }
+
+    logger_set_level((log_level_t)config_get_log_level(next));
+    logger_log(LOG_INFO, "Worker %d: configuration reloaded", getpid());
+}
+
+// Current CLOCK_MONOTONIC time in microseconds
+static uint64_t worker_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Current CLOCK_MONOTONIC time in milliseconds
+static uint64_t worker_now_ms(void) {
+    return worker_now_us() / 1000;
+}
+
+// Take one of the worker's locks, counting the time spent waiting when it is held
+static void worker_lock(worker_t *worker, pthread_mutex_t *mutex) {
+    if (pthread_mutex_trylock(mutex) == 0) return;
+
+    uint64_t start = worker_now_us();
+    pthread_mutex_lock(mutex);
+    __atomic_fetch_add(&worker->lock_waits, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&worker->lock_wait_us, worker_now_us() - start, __ATOMIC_RELAXED);
+}
+
+// (Re)arm the connection's deadline seconds from now
+static void worker_arm_timer(worker_t *worker, connection_t *conn, int seconds) {
+    worker_lock(worker, &worker->timer_lock);
+    timer_wheel_add(&worker->timers, &conn->timer, worker_now_ms() + (uint64_t)seconds * 1000);
+    pthread_mutex_unlock(&worker->timer_lock);
+}
+
+// A keep-alive connection waiting for its next request (its deadline is the idle one)
+static int worker_conn_idle(const connection_t *conn) {
+    return conn->state == CONN_STATE_READING && conn->buffer_len == 0 && conn->requests_served > 0;
+}
+
+// Deadline expired: shut the socket down so whoever owns the connection sees
+// EOF/EPIPE and releases it through the normal path (called with timer_lock held).
+// Only header and write deadlines count as timeout errors, an idle close is normal.
+static void worker_timer_expired(wheel_timer_t *timer, void *arg) {
+    (void)arg;
+    connection_t *conn = timer->data;
+    if (!worker_conn_idle(conn)) stats_increment_timeout_error();
+    shutdown(conn->fd, SHUT_RDWR);
+}
+
+// SIGUSR1: write the request timelines to LOG_FILE.trace.<pid>
+static void worker_dump_trace(worker_t *worker) {
+    worker_trace_dump_requested = 0;
+    if (!worker->trace) {
+        logger_log(LOG_WARNING, "Worker %d: request tracing is off (TRACE_REQUESTS=0)", getpid());
+        return;
+    }
+
+    char path[MAX_PATH_LENGTH + 32];
+    snprintf(path, sizeof(path), "%s.trace.%d", config_get_log_file(worker_config(worker)), getpid());
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        logger_log(LOG_ERROR, "Worker %d: cannot write %s: %s", getpid(), path, strerror(errno));
+        return;
+    }
+    int count = trace_ring_dump(worker->trace, file);
+    fclose(file);
+    logger_log(LOG_INFO, "Worker %d: wrote %d request timelines to %s", getpid(), count, path);
+}
+
+// Publish the queue and pool gauges to the stats segment (at most once per timer tick)
+static void worker_publish_gauges(worker_t *worker) {
+    uint64_t now_ms = worker_now_ms();
+    if (now_ms < worker->gauges_published_ms + WORKER_TIMER_TICK_MS) return;
+    worker->gauges_published_ms = now_ms;
+
+    unsigned long lock_waits = 0;
+    uint64_t lock_wait_ns = 0;
+    connection_queue_lock_stats(worker->queue, &lock_waits, &lock_wait_ns);
+
+    // Every cache of the worker: bytes held and lock contention
+    size_t cached = 0;
+    for (int i = -1; i < MAX_VHOSTS; i++) {
+        cache_t *cache = i < 0 ? worker->cache : worker->vhost_caches[i];
+        if (!cache) continue;
+        unsigned long waits = 0;
+        uint64_t wait_ns = 0;
+        cache_lock_stats(cache, &waits, &wait_ns);
+        lock_waits += waits;
+        lock_wait_ns += wait_ns;
+        cached += cache_bytes(cache);
+    }
+    stats_set_cache_bytes(cached);
+    stats_set_active_connections(connection_pool_in_use(worker->connections));
+    stats_set_worker_gauges(connection_queue_depth(worker->queue),
+                            worker->pool ? worker->pool->num_threads : 0,
+                            lock_waits + __atomic_load_n(&worker->lock_waits, __ATOMIC_RELAXED),
+                            lock_wait_ns / 1000 + __atomic_load_n(&worker->lock_wait_us, __ATOMIC_RELAXED));
+}
+
+// Fire due connection timers, apply a pending reload or trace dump, close admission
+// intervals, publish the gauges and free old configurations (event loop thread, once per iteration)
+static void worker_housekeeping(worker_t *worker) {
+    worker_lock(worker, &worker->timer_lock);
+    timer_wheel_expire(&worker->timers, worker_now_ms(), worker_timer_expired, worker);
+    pthread_mutex_unlock(&worker->timer_lock);
+
+    if (worker_reload_requested) worker_reload_config(worker);
+    if (worker_trace_dump_requested) worker_dump_trace(worker);
+    admission_tick(&worker->admission, connection_queue_depth(worker->queue), worker_now_ms());
+    worker_publish_gauges(worker);
+    worker_reclaim_configs(worker);
+}
+
+// How long the event loop may sleep before the next deadline
+// (one tick while draining, threads release connections without waking it)
+static int worker_wait_timeout(worker_t *worker) {
+    worker_lock(worker, &worker->timer_lock);
+    int timeout = timer_wheel_next_timeout(&worker->timers, worker_now_ms());
+    pthread_mutex_unlock(&worker->timer_lock);
+    int max_wait = worker->draining ? WORKER_TIMER_TICK_MS : WORKER_MAX_WAIT_MS;
+    return timeout < 0 || timeout > max_wait ? max_wait : timeout;
+}
+
+// Close keep-alive connections waiting for their next request (called with timer_lock held).
+// New connections that have not sent anything yet keep their header deadline.
+static void worker_close_idle(wheel_timer_t *timer, void *arg) {
+    (void)arg;
+    connection_t *conn = timer->data;
+    if (worker_conn_idle(conn)) {
+        shutdown(conn->fd, SHUT_RDWR);
+    }
+}
+
+// Stop accepting, close idle connections and start the drain deadline
+static void worker_begin_drain(worker_t *worker) {
+    worker->draining = 1;
+    worker->drain_deadline_ms = worker_now_ms() + (uint64_t)config_get_timeout(worker_config(worker)) * 1000;
+
+    if (worker->backend == IO_BACKEND_IO_URING) {
+        struct io_uring_sqe *sqe = uring_get_sqe(&worker->ring);
+        if (sqe) {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = TAG_ACCEPT;
+            sqe->user_data = TAG_CANCEL;
+        }
+    } else {
+        epoll_ctl(worker->epoll_fd, EPOLL_CTL_DEL, worker->listen_fd, NULL);
+    }
+
+    worker_lock(worker, &worker->timer_lock);
+    timer_wheel_for_each(&worker->timers, worker_close_idle, worker);
+    pthread_mutex_unlock(&worker->timer_lock);
+
+    logger_log(LOG_INFO, "Worker %d draining %d connections", getpid(),
+               connection_pool_in_use(worker->connections));
+}
+
+// Whether the event loop should stop: after SIGTERM, once every connection
+// is released or the drain deadline passes
+static int worker_loop_done(worker_t *worker) {
+    if (worker_running) return 0;
+    if (!worker->draining) worker_begin_drain(worker);
+    if (connection_pool_in_use(worker->connections) == 0) return 1;
+    if (worker_now_ms() >= worker->drain_deadline_ms) {
+        logger_log(LOG_WARNING, "Worker %d: drain deadline passed with %d connections open",
+                   getpid(), connection_pool_in_use(worker->connections));
+        return 1;
+    }
+    return 0;
+}
+
+// Take a pooled connection for an accepted socket
+static connection_t* worker_accept_connection(worker_t *worker, int fd, const struct sockaddr_storage *addr) {
+    // The io_uring accept gives no peer address: look it up once when clients are rate limited
+    struct sockaddr_storage peer;
+    socklen_t peer_len = sizeof(peer);
+    if (!addr && config_get_rate_limit_rps(worker_config(worker)) > 0 &&
+        getpeername(fd, (struct sockaddr *)&peer, &peer_len) == 0) {
+        addr = &peer;
+    }
+
+    connection_t *conn = connection_pool_acquire(worker->connections, fd, addr);
+    if (!conn) {
+        // Pool exhausted: refuse the connection
+        close(fd);
+        stats_increment_connection_error();
+        return NULL;
+    }
+    conn->client_key = rate_limit_key(addr);
+
+    // The whole request header must arrive within TIMEOUT_SECONDS
+    worker_arm_timer(worker, conn, config_get_timeout(worker_config(worker)));
+    TRACE_PROBE1(accept, fd);
+    return conn;
+}
+
+// Wake the event loop (eventfd)
+static void worker_wake_loop(worker_t *worker) {
+    uint64_t one = 1;
+    if (write(worker->wakeup_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        perror("eventfd write failed");
+    }
+}
+
+// Close the socket and recycle the connection. A provided buffer it still holds
+// goes back to the loop, the only one that may recycle it.
+static void worker_close_connection(worker_t *worker, connection_t *conn) {
+    worker_lock(worker, &worker->timer_lock);
+    timer_wheel_cancel(&worker->timers, &conn->timer);
+    pthread_mutex_unlock(&worker->timer_lock);
+    if (conn->recv_pending) {
+        worker_lock(worker, &worker->return_lock);
+        worker->recycled_bids[worker->num_recycled_bids++] = conn->recv_bid;
+        pthread_mutex_unlock(&worker->return_lock);
+        conn->recv_pending = 0;
+        worker_wake_loop(worker);
+    }
+    connection_pool_release(worker->connections, conn);
+}
+
+// Render a fixed rejection with Retry-After into buffer, returning its length
+static size_t worker_render_rejection(char *buffer, size_t size, int status, int retry_after) {
+    char body[128];
+    snprintf(body, sizeof(body), "<html><body><h1>%d %s</h1></body></html>\n",
+             status, http_status_message(status));
+    int len = snprintf(buffer, size,
+                       "HTTP/1.1 %d %s\r\n"
+                       "Content-Type: text/html\r\n"
+                       "Content-Length: %zu\r\n"
+                       "Retry-After: %d\r\n"
+                       "Connection: close\r\n"
+                       "\r\n%s",
+                       status, http_status_message(status), strlen(body), retry_after, body);
+    return len > 0 && (size_t)len < size ? (size_t)len : 0;
+}
+
+// Render the 503 sent to shed requests and the 429 sent to clients over their rate (once per worker)
+static void worker_render_rejections(worker_t *worker) {
+    worker->shed_response_len = worker_render_rejection(worker->shed_response, sizeof(worker->shed_response),
+                                                        503, ADMISSION_RETRY_AFTER);
+    worker->limit_response_len = worker_render_rejection(worker->limit_response, sizeof(worker->limit_response),
+                                                         429, RATE_LIMIT_RETRY_AFTER);
+}
+
+// Reject a request with the prerendered 503 without involving the threads
+static void worker_shed(worker_t *worker, connection_t *conn) {
+    if (send(conn->fd, worker->shed_response, worker->shed_response_len,
+             MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+        stats_increment_connection_error();
+    }
+    stats_increment_request(503);
+    worker_close_connection(worker, conn);
+}
+
+// Turn a client with an empty bucket away with the prerendered 429 before it takes a queue slot
+static void worker_limit(worker_t *worker, connection_t *conn) {
+    if (send(conn->fd, worker->limit_response, worker->limit_response_len,
+             MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+        stats_increment_connection_error();
+    }
+    stats_increment_request(429);
+    stats_increment_rate_limited();
+    worker_close_connection(worker, conn);
+}
+
+// Whether the connection's client has a token left (each request is charged once parsed)
+static int worker_rate_ready(worker_t *worker, connection_t *conn, uint64_t now_ms) {
+    int rate = config_get_rate_limit_rps(worker_config(worker));
+    return rate == 0 || rate_limit_peek(conn->client_key, rate, now_ms);
+}
+
+// Hand a connection with pending data to the thread pool, or shed it under overload
+// or when its client is over its rate
+static void worker_dispatch(worker_t *worker, connection_t *conn) {
+    uint64_t now_us = worker_now_us();
+    if (admission_should_shed(&worker->admission, connection_queue_depth(worker->queue),
+                              now_us / 1000)) {
+        worker_shed(worker, conn);
+        return;
+    }
+    if (!worker_rate_ready(worker, conn, now_us / 1000)) {
+        worker_limit(worker, conn);
+        return;
+    }
+
+    conn->state = CONN_STATE_QUEUED;
+    conn->queued_at_us = now_us;
+    int fd = conn->fd;
+    if (connection_queue_push(worker->queue, conn) != 0) {
+        // Queue filled up since the check
+        worker_shed(worker, conn);
+        return;
+    }
+    int depth = connection_queue_depth(worker->queue);
+    stats_record_queue_depth(depth);
+    TRACE_PROBE2(enqueue, fd, depth);
+}
+
+// Give a connection back to the event loop to wait for more data
+static void worker_return_connection(worker_t *worker, connection_t *conn) {
+    conn->state = CONN_STATE_READING;
+
+    // Draining: an idle keep-alive connection released after the drain started
+    // is closed by the loop like the ones that were idle already
+    if (!worker_running && conn->buffer_len == 0 && conn->recv_pending == 0 && conn->requests_served > 0) {
+        shutdown(conn->fd, SHUT_RDWR);
+    }
+
+    worker_lock(worker, &worker->return_lock);
+    conn->next = worker->return_head;
+    worker->return_head = conn;
+    pthread_mutex_unlock(&worker->return_lock);
+    worker_wake_loop(worker);
+}
+
+// Take every connection handed back by the threads
+static connection_t* worker_take_returned(worker_t *worker) {
+    worker_lock(worker, &worker->return_lock);
+    connection_t *list = worker->return_head;
+    worker->return_head = NULL;
+    pthread_mutex_unlock(&worker->return_lock);
+    return list;
+}
+
+
+// ===== EPOLL BACKEND =====
+
+// Register the listening socket and the wakeup eventfd
+static int epoll_loop_init(worker_t *worker) {
+    worker->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (worker->epoll_fd < 0) {
+        perror("epoll_create1 failed");
+        return -1;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLEXCLUSIVE;   // Wake only one worker per connection
+    ev.data.u64 = TAG_ACCEPT;
+    if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->listen_fd, &ev) != 0) {
+        perror("epoll_ctl listen failed");
+        return -1;
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.u64 = TAG_WAKEUP;
+    if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->wakeup_fd, &ev) != 0) {
+        perror("epoll_ctl eventfd failed");
+        return -1;
+    }
+    return 0;
+}
+
+// Wait (once) for the connection to become readable
+static void epoll_arm(worker_t *worker, connection_t *conn) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    ev.data.ptr = conn;
+
+    int op = conn->registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (epoll_ctl(worker->epoll_fd, op, conn->fd, &ev) != 0) {
+        stats_increment_connection_error();
+        worker_close_connection(worker, conn);
+        return;
+    }
+    conn->registered = 1;
+}
+
+// Accept every pending connection
+static void epoll_accept(worker_t *worker) {
+    for (;;) {
+        struct sockaddr_storage addr;
+        socklen_t len = sizeof(addr);
+        int fd = accept4(worker->listen_fd, (struct sockaddr *)&addr, &len,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) stats_increment_connection_error();
+            return;
+        }
+
+        connection_t *conn = worker_accept_connection(worker, fd, &addr);
+        if (conn) epoll_arm(worker, conn);
+    }
+}
+
+// Event loop: accepts, re-arms returned connections and dispatches readable ones
+static void epoll_loop_run(worker_t *worker) {
+    struct epoll_event events[WORKER_MAX_EVENTS];
+
+    while (!worker_loop_done(worker)) {
+        int n = epoll_wait(worker->epoll_fd, events, WORKER_MAX_EVENTS, worker_wait_timeout(worker));
+        if (n < 0 && errno != EINTR) {
+            perror("epoll_wait failed");
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.u64 == TAG_ACCEPT) {
+                if (!worker->draining) epoll_accept(worker);
+            } else if (events[i].data.u64 == TAG_WAKEUP) {
+                uint64_t value;
+                if (read(worker->wakeup_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+                    perror("eventfd read failed");
+                }
+                connection_t *conn = worker_take_returned(worker);
+                while (conn) {
+                    connection_t *next = conn->next;
+                    epoll_arm(worker, conn);
+                    conn = next;
+                }
+            } else {
+                worker_dispatch(worker, events[i].data.ptr);
+            }
+        }
+
+        worker_housekeeping(worker);
+    }
+}
+
+// Release epoll resources
+static void epoll_loop_cleanup(worker_t *worker) {
+    if (worker->epoll_fd >= 0) close(worker->epoll_fd);
+    worker->epoll_fd = -1;
+}
+
+
+// ===== IO_URING BACKEND =====
+
+// Get an SQE, flushing the submission queue if it is full
+static struct io_uring_sqe* uring_loop_sqe(worker_t *worker) {
+    struct io_uring_sqe *sqe = uring_get_sqe(&worker->ring);
+    if (!sqe) {
+        uring_submit_and_wait(&worker->ring, 0, 0);
+        sqe = uring_get_sqe(&worker->ring);
+    }
+    return sqe;
+}
+
+// (Re)arm accept on the listening socket (fixed file 0)
+static void uring_post_accept(worker_t *worker) {
+    struct io_uring_sqe *sqe = uring_loop_sqe(worker);
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = 0;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->ioprio = worker->multishot_accept ? IORING_ACCEPT_MULTISHOT : 0;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = TAG_ACCEPT;
+}
+
+// (Re)arm the read of the wakeup eventfd (fixed file 1)
+static void uring_post_wakeup(worker_t *worker) {
+    struct io_uring_sqe *sqe = uring_loop_sqe(worker);
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = 1;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->addr = (uint64_t)(uintptr_t)&worker->wakeup_value;
+    sqe->len = sizeof(worker->wakeup_value);
+    sqe->user_data = TAG_WAKEUP;
+}
+
+// Receive into a kernel-selected provided buffer
+static void uring_post_recv(worker_t *worker, connection_t *conn) {
+    struct io_uring_sqe *sqe = uring_loop_sqe(worker);
+    if (!sqe) {
+        worker_close_connection(worker, conn);
+        return;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn->fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = WORKER_RECV_BUFFER_GROUP;
+    sqe->len = WORKER_RECV_BUFFER_SIZE;
+    sqe->user_data = (uint64_t)(uintptr_t)conn;
+}
+
+// Set up the ring, provided buffers and registered files
+static int uring_loop_init(worker_t *worker) {
+    int ret = uring_init(&worker->ring, WORKER_URING_ENTRIES);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+
+    ret = uring_buf_ring_init(&worker->ring, &worker->recv_buffers, WORKER_RECV_BUFFER_GROUP,
+                              WORKER_RECV_BUFFERS, WORKER_RECV_BUFFER_SIZE);
+    if (ret == 0) {
+        int files[2] = { worker->listen_fd, worker->wakeup_fd };
+        ret = uring_register_files(&worker->ring, files, 2);
+    }
+    if (ret < 0) {
+        uring_buf_ring_free(&worker->ring, &worker->recv_buffers);
+        uring_exit(&worker->ring);
+        errno = -ret;
+        return -1;
+    }
+
+    worker->multishot_accept = 1;
+    uring_post_accept(worker);
+    uring_post_wakeup(worker);
+    return 0;
+}
+
+// Move what fits of the connection's pending provided buffer into its buffer, growing
+// it first if needed; the buffer is recycled once empty. Returns the bytes moved.
+static size_t uring_take_pending(worker_t *worker, connection_t *conn) {
+    if (conn->recv_pending > conn->buffer_size - 1 - conn->buffer_len) {
+        connection_pool_grow_buffer(worker->connections, conn);
+    }
+    size_t space = conn->buffer_size - 1 - conn->buffer_len;
+    size_t n = conn->recv_pending < space ? conn->recv_pending : space;
+    memcpy(conn->buffer + conn->buffer_len,
+           uring_buf_ring_buffer(&worker->recv_buffers, conn->recv_bid) + conn->recv_offset, n);
+    conn->buffer_len += n;
+    conn->recv_offset += n;
+    conn->recv_pending -= n;
+    if (conn->recv_pending == 0) uring_buf_ring_recycle(&worker->recv_buffers, conn->recv_bid);
+    return n;
+}
+
+// Recycle the provided buffers of connections closed while holding one
+static void uring_recycle_closed(worker_t *worker) {
+    worker_lock(worker, &worker->return_lock);
+    for (int i = 0; i < worker->num_recycled_bids; i++) {
+        uring_buf_ring_recycle(&worker->recv_buffers, worker->recycled_bids[i]);
+    }
+    worker->num_recycled_bids = 0;
+    pthread_mutex_unlock(&worker->return_lock);
+}
+
+// Continue a connection handed back by a thread: bytes left in its provided buffer
+// are served before anything new is received (dropping them would corrupt a pipeline)
+static void uring_resume_connection(worker_t *worker, connection_t *conn) {
+    if (conn->recv_pending == 0) {
+        uring_post_recv(worker, conn);
+    } else if (uring_take_pending(worker, conn) > 0) {
+        worker_dispatch(worker, conn);
+    } else {
+        worker_close_connection(worker, conn);
+    }
+}
+
+// Handle the completion of a recv on a connection. What does not fit in the
+// buffer stays in the provided buffer until the thread has made room.
+static void uring_handle_recv(worker_t *worker, connection_t *conn, int res, unsigned flags) {
+    if (res == -ENOBUFS) {
+        // All provided buffers in flight, they come back as soon as they are copied
+        uring_post_recv(worker, conn);
+        return;
+    }
+    if (res <= 0) {
+        worker_close_connection(worker, conn);
+        return;
+    }
+
+    conn->recv_bid = flags >> IORING_CQE_BUFFER_SHIFT;
+    conn->recv_offset = 0;
+    conn->recv_pending = res;
+    uring_take_pending(worker, conn);
+    worker_dispatch(worker, conn);
+}
+
+// Event loop: multishot accept, buffer-select recv and wakeups from the threads
+static void uring_loop_run(worker_t *worker) {
+    while (!worker_loop_done(worker)) {
+        int ret = uring_submit_and_wait(&worker->ring, 1, worker_wait_timeout(worker));
+        if (ret < 0 && ret != -EINTR && ret != -ETIME) {
+            fprintf(stderr, "io_uring_enter failed: %s\n", strerror(-ret));
+            break;
+        }
+
+        struct io_uring_cqe *cqe;
+        while ((cqe = uring_peek_cqe(&worker->ring)) != NULL) {
+            uint64_t user_data = cqe->user_data;
+            int res = cqe->res;
+            unsigned flags = cqe->flags;
+            uring_cqe_seen(&worker->ring);
+
+            if (user_data == TAG_ACCEPT) {
+                if (res >= 0 && worker->draining) {
+                    close(res);     // Accepted before the cancel took effect
+                } else if (res >= 0) {
+                    connection_t *conn = worker_accept_connection(worker, res, NULL);
+                    if (conn) uring_post_recv(worker, conn);
+                } else if (res == -EINVAL && worker->multishot_accept) {
+                    // Older kernel: fall back to one accept per SQE
+                    worker->multishot_accept = 0;
+                } else if (res != -EAGAIN && res != -EINTR && res != -ECANCELED) {
+                    stats_increment_connection_error();
+                }
+                if (!(flags & IORING_CQE_F_MORE) && !worker->draining) uring_post_accept(worker);
+            } else if (user_data == TAG_CANCEL) {
+                continue;
+            } else if (user_data == TAG_WAKEUP) {
+                uring_recycle_closed(worker);
+                connection_t *conn = worker_take_returned(worker);
+                while (conn) {
+                    connection_t *next = conn->next;
+                    uring_resume_connection(worker, conn);
+                    conn = next;
+                }
+                uring_post_wakeup(worker);
+            } else {
+                uring_handle_recv(worker, (connection_t *)(uintptr_t)user_data, res, flags);
+            }
+        }
+
+        worker_housekeeping(worker);
+    }
+}
+
+// Release io_uring resources
+static void uring_loop_cleanup(worker_t *worker) {
+    uring_buf_ring_free(&worker->ring, &worker->recv_buffers);
+    uring_exit(&worker->ring);
+}
+
+
+// ===== REQUEST HANDLING =====
+
+// Map an open/stat errno to an HTTP status
+static int status_from_errno(int err) {
+    switch (err) {
+        case ENOENT:
+        case ENOTDIR:
+        case ENAMETOOLONG: return 404;
+        case EACCES:
+        case EPERM:
+        case EXDEV:
+        case ELOOP:
+        case EISDIR:       return 403;
+        default:           return 500;
+    }
+}
+
+// Method name for the access log
+static const char* method_name(http_method_t method) {
+    switch (method) {
+        case HTTP_GET:  return "GET";
+        case HTTP_HEAD: return "HEAD";
+        default:        return "-";
+    }
+}
+
+// Wait until the socket is writable (the write deadline in the wheel normally
+// fires first, this bound only covers a stalled event loop)
+static int wait_writable(worker_t *worker, int fd) {
+    struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+    int ret;
+    do {
+        ret = poll(&pfd, 1, config_get_timeout(worker_config(worker)) * 1000);
+    } while (ret < 0 && errno == EINTR);
+    if (ret == 0) stats_increment_timeout_error();
+    return ret > 0 ? 0 : -1;
+}
+
+// Send the whole buffer on a non-blocking socket, returns bytes sent or -1
+static ssize_t send_all(worker_t *worker, int fd, const void *buf, size_t len, int more) {
+    const char *p = buf;
+    size_t sent = 0;
+    int flags = MSG_NOSIGNAL | (more ? MSG_MORE : 0);
+
+    while (sent < len) {
+        ssize_t n = send(fd, p + sent, len - sent, flags);
+        if (n > 0) {
+            sent += n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (wait_writable(worker, fd) != 0) return -1;
+        } else {
+            return -1;
+        }
+    }
+    return (ssize_t)sent;
+}
+
+// Send a gather list on a non-blocking socket (iov is consumed), returns bytes sent or -1
+static ssize_t sendmsg_all(worker_t *worker, int fd, struct iovec *iov, int count, int more) {
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    size_t sent = 0;
+    int flags = MSG_NOSIGNAL | (more ? MSG_MORE : 0);
+
+    while (count > 0 && iov->iov_len == 0) {
+        iov++;
+        count--;
+    }
+    while (count > 0) {
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t n = sendmsg(fd, &msg, flags);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (wait_writable(worker, fd) != 0) return -1;
+            continue;
+        }
+        if (n <= 0) return -1;
+
+        // Skip what went out, including a partially sent element
+        sent += n;
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return (ssize_t)sent;
+}
+
+// Send count bytes of file_fd starting at start with sendfile, returns bytes sent or -1
+static ssize_t sendfile_all(worker_t *worker, int fd, int file_fd, off_t start, size_t count) {
+    off_t offset = start;
+    while ((size_t)(offset - start) < count) {
+        ssize_t n = sendfile(fd, file_fd, &offset, count - (offset - start));
+        if (n > 0) continue;
+        if (n == 0) break;  // File shrank
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            if (wait_writable(worker, fd) != 0) return -1;
+            continue;
+        }
+        return -1;
+    }
+    return (ssize_t)(offset - start);
+}
+
+// Timestamp a phase of the connection's current request (once, and only when tracing)
+static void worker_trace_mark(worker_t *worker, connection_t *conn, trace_phase_t phase) {
+    if (worker->trace && conn->trace.at_us[phase] == 0) conn->trace.at_us[phase] = worker_now_us();
+}
+
+// The response header is on the wire
+static void worker_first_byte(worker_t *worker, connection_t *conn, int status_code) {
+    TRACE_PROBE2(first_byte, conn->fd, status_code);
+    if (conn->first_byte_us == 0) conn->first_byte_us = worker_now_us();
+    worker_trace_mark(worker, conn, TRACE_FIRST_BYTE);
+}
+
+// The file lookup finished (status 200, or the error about to be sent)
+static void worker_opened(worker_t *worker, connection_t *conn, const char *path, int status_code) {
+    TRACE_PROBE2(open_stat, path, status_code);
+    worker_trace_mark(worker, conn, TRACE_OPENED);
+}
+
+// Whether the connection may stay open after a response with this status
+static int status_keeps_connection(int status_code) {
+    return status_code != 400 && status_code < 500;
+}
+
+// Send an error page, returns bytes sent
+static size_t send_error(worker_t *worker, connection_t *conn, int status_code, int with_body) {
+    char body[256];
+    int body_len = snprintf(body, sizeof(body),
+                            "<html><body><h1>%d %s</h1></body></html>\n",
+                            status_code, http_status_message(status_code));
+
+    if (!status_keeps_connection(status_code)) conn->keep_alive = 0;
+    char *header = http_create_response_header_arena(conn->arena, status_code, "text/html",
+                                                     body_len, conn->keep_alive);
+    if (!header) return 0;
+
+    size_t total = 0;
+    ssize_t n = send_all(worker, conn->fd, header, strlen(header), with_body);
+    if (n > 0) total += n;
+    worker_first_byte(worker, conn, status_code);
+    if (n >= 0 && with_body) {
+        n = send_all(worker, conn->fd, body, body_len, 0);
+        if (n > 0) total += n;
+    }
+    if (!conn->arena) free(header);
+    return total;
+}
+
+// Document root for a virtual host index (-1 = the default host)
+static docroot_t* worker_docroot(worker_t *worker, int vhost) {
+    return vhost >= 0 && worker->vhost_docroots[vhost] ? worker->vhost_docroots[vhost] : worker->docroot;
+}
+
+// Bundle serving a virtual host index (-1 = the default host), NULL for a directory root
+static const bundle_t* worker_bundle(worker_t *worker, int vhost) {
+    return vhost >= 0 ? worker->vhost_bundles[vhost] : worker->bundle;
+}
+
+// File cache of a virtual host index (-1 = the default host), NULL when it has none
+static cache_t* worker_cache(worker_t *worker, int vhost) {
+    return vhost >= 0 ? worker->vhost_caches[vhost] : worker->cache;
+}
+
+// Send the 200 header for a file of size bytes, returns bytes sent or -1
+static ssize_t send_file_header(worker_t *worker, connection_t *conn, int vhost, const char *path,
+                                size_t size, int more) {
+    const char *type = config_get_vhost_mime_type(worker_config(worker), vhost, path);
+    char *header = http_create_response_header_arena(conn->arena, 200,
+                                                     type ? type : http_get_mime_type(path),
+                                                     size, conn->keep_alive);
+    if (!header) return -1;
+    ssize_t n = send_all(worker, conn->fd, header, strlen(header), more);
+    if (!conn->arena) free(header);
+    worker_first_byte(worker, conn, 200);
+    return n;
+}
+
+// Send a cached file: the status lines, then the stored headers with the inline body
+// right behind them (one buffer), in one sendmsg; a large body follows with sendfile
+static int send_cached_file(worker_t *worker, connection_t *conn, const cache_entry_t *entry,
+                            int with_body, size_t *bytes_sent) {
+    char lines[256];
+    int len = http_format_status_lines(lines, sizeof(lines), 200, conn->keep_alive);
+    int sendfile_body = with_body && entry->fd >= 0 && entry->size > 0;
+    struct iovec iov[2] = {
+        { lines, len },
+        { (void *)entry->data, entry->headers_len + (with_body && entry->body ? entry->size : 0) },
+    };
+    ssize_t n = sendmsg_all(worker, conn->fd, iov, 2, sendfile_body);
+    if (n > 0) *bytes_sent += n;
+    worker_first_byte(worker, conn, 200);
+    if (n >= 0 && sendfile_body) {
+        n = sendfile_all(worker, conn->fd, entry->fd, 0, entry->size);
+        if (n > 0) *bytes_sent += n;
+        if (n >= 0 && (size_t)n < entry->size) conn->keep_alive = 0;    // File shrank
+    }
+    return 200;
+}
+
+// Modification time of a stat result in nanoseconds
+static int64_t stat_mtime_ns(const struct stat *st) {
+    return (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+// Whether a cached file changed on disk (compared at most every CACHE_REVALIDATE_MS)
+static int worker_cache_stale(worker_t *worker, int vhost, cache_entry_t *entry) {
+    uint64_t now_ms = worker_now_ms();
+    if (now_ms < __atomic_load_n(&entry->checked_ms, __ATOMIC_RELAXED) + CACHE_REVALIDATE_MS) return 0;
+
+    int fd = docroot_open(worker_docroot(worker, vhost), entry->path, O_PATH);
+    if (fd < 0) return 1;
+    struct stat st;
+    int stale = fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (size_t)st.st_size != entry->size ||
+                stat_mtime_ns(&st) != entry->mtime_ns || (uint64_t)st.st_ino != entry->ino;
+    close(fd);
+    if (!stale) __atomic_store_n(&entry->checked_ms, now_ms, __ATOMIC_RELAXED);
+    return stale;
+}
+
+// Serve path from the file cache, returns 0 on a miss (nothing sent). A GET miss
+// waits for another thread loading the same file, or sets *flight: this thread loads it.
+static int serve_file_cached(worker_t *worker, connection_t *conn, const http_request_t *request,
+                             cache_t *cache, int vhost, const char *path, size_t *bytes_sent,
+                             cache_flight_t **flight) {
+    if (!cache) return 0;
+    uint32_t hash = http_path_hash(path);
+    cache_entry_t *entry = cache_lookup(cache, path, hash);
+    TRACE_PROBE2(cache_lookup, path, entry != NULL);
+    if (entry && worker_cache_stale(worker, vhost, entry)) {
+        cache_remove(cache, entry);
+        cache_release(entry);
+        entry = NULL;
+    }
+    if (!entry && request->method == HTTP_GET) entry = cache_begin_load(cache, path, hash, flight);
+    if (!entry) return 0;
+
+    worker_opened(worker, conn, path, 200);
+    int status = send_cached_file(worker, conn, entry, request->method == HTTP_GET, bytes_sent);
+    cache_release(entry);
+    return status;
+}
+
+// Cache entry for a file of size bytes, with its entity headers rendered.
+// Small files get room for the body inline; large ones keep file_fd, which the entry
+// owns from then on (entry->fd == file_fd). NULL if the file is not cached.
+static cache_entry_t* worker_cache_entry(worker_t *worker, cache_t *cache, int vhost, const char *path,
+                                         size_t size, int file_fd) {
+    if (!cache) return NULL;
+    int size_class = cache_size_class(cache, size);
+    if (size_class < 0 || (size_class == CACHE_LARGE && file_fd < 0)) return NULL;
+
+    const char *type = config_get_vhost_mime_type(worker_config(worker), vhost, path);
+    char headers[256];
+    int len = http_format_entity_headers(headers, sizeof(headers), type ? type : http_get_mime_type(path),
+                                         size);
+    if (len < 0 || (size_t)len >= sizeof(headers)) return NULL;
+    return cache_entry_create(path, http_path_hash(path), headers, len, size,
+                              size_class == CACHE_LARGE ? file_fd : -1);
+}
+
+// Offer a fully loaded file to the cache
+static void worker_cache_store(cache_t *cache, cache_entry_t *entry, int64_t mtime_ns, uint64_t ino) {
+    entry->mtime_ns = mtime_ns;
+    entry->ino = ino;
+    entry->checked_ms = worker_now_ms();
+    cache_insert(cache, entry);
+}
+
+// Read size bytes of fd from the start, returns 0 if all of them were read
+static int read_file(int fd, char *buffer, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(fd, buffer + done, size - done, done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        done += n;
+    }
+    return 0;
+}
+
+// Load an open regular file (st from fstat) into the cache outside a request: the
+// io_uring path's large files and the warm-up. Takes fd; returns 0 if it was cached.
+static int worker_cache_load(worker_t *worker, cache_t *cache, int vhost, const char *path, int fd,
+                             const struct stat *st) {
+    cache_entry_t *entry = worker_cache_entry(worker, cache, vhost, path, st->st_size, fd);
+    if (entry && entry->body && read_file(fd, entry->body, entry->size) != 0) {
+        cache_release(entry);
+        entry = NULL;
+    }
+    if (!entry || entry->fd != fd) close(fd);
+    if (!entry) return -1;
+    worker_cache_store(cache, entry, stat_mtime_ns(st), st->st_ino);
+    cache_release(entry);
+    return 0;
+}
+
+// Serve path with docroot_open + fstat + sendfile (epoll backend); a cacheable
+// file is read into a cache entry instead and sent from it. Threads waiting on
+// flight are released as soon as the file is cached or known not to be.
+static int serve_file_sync(worker_t *worker, connection_t *conn, const http_request_t *request,
+                           cache_t *cache, cache_flight_t **flight, int vhost, const char *path,
+                           size_t *bytes_sent) {
+    int with_body = request->method == HTTP_GET;
+    int file_fd = docroot_open(worker_docroot(worker, vhost), path, O_RDONLY);
+    if (file_fd < 0) {
+        int status = status_from_errno(errno);
+        worker_opened(worker, conn, path, status);
+        *bytes_sent = send_error(worker, conn, status, with_body);
+        return status;
+    }
+
+    struct stat st;
+    if (fstat(file_fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(file_fd);
+        worker_opened(worker, conn, path, 403);
+        *bytes_sent = send_error(worker, conn, 403, with_body);
+        return 403;
+    }
+    worker_opened(worker, conn, path, 200);
+
+    cache_entry_t *entry = with_body ? worker_cache_entry(worker, cache, vhost, path, st.st_size, file_fd) : NULL;
+    if (entry && entry->body && read_file(file_fd, entry->body, entry->size) != 0) {
+        cache_release(entry);
+        entry = NULL;
+    }
+    if (entry) {
+        if (entry->fd != file_fd) close(file_fd);
+        worker_cache_store(cache, entry, stat_mtime_ns(&st), st.st_ino);
+        int status = send_cached_file(worker, conn, entry, with_body, bytes_sent);
+        cache_release(entry);
+        return status;
+    }
+    cache_end_load(cache, flight);
+
+    ssize_t n = send_file_header(worker, conn, vhost, path, st.st_size, with_body && st.st_size > 0);
+    if (n > 0) *bytes_sent += n;
+    if (n >= 0 && with_body && st.st_size > 0) {
+        n = sendfile_all(worker, conn->fd, file_fd, 0, st.st_size);
+        if (n > 0) *bytes_sent += n;
+        if (n >= 0 && n < st.st_size) conn->keep_alive = 0;    // File shrank
+    }
+
+    close(file_fd);
+    return 200;
+}
+
+// Serve path from a mapped bundle: no open/stat, the entity headers are precomputed,
+// small bodies leave in the same sendmsg as the header and large ones with sendfile
+static int serve_file_bundle(worker_t *worker, connection_t *conn, const http_request_t *request,
+                             const bundle_t *bundle, const char *path, size_t *bytes_sent) {
+    int with_body = request->method == HTTP_GET;
+    const bundle_entry_t *entry = bundle_lookup(bundle, path, http_path_hash(path));
+    TRACE_PROBE2(cache_lookup, path, entry != NULL);
+    worker_trace_mark(worker, conn, TRACE_OPENED);
+    if (!entry) {
+        *bytes_sent = send_error(worker, conn, 404, with_body);
+        return 404;
+    }
+
+    int gzip = request->accept_gzip && bundle_has_variant(entry, BUNDLE_GZIP);
+    const bundle_variant_t *variant = &entry->variants[gzip ? BUNDLE_GZIP : BUNDLE_IDENTITY];
+
+    // Conditional request for the representation the client already has
+    char lines[256];
+    if (http_header_has_token(request->headers, "If-None-Match", variant->etag)) {
+        int len = http_format_status_lines(lines, sizeof(lines), 304, conn->keep_alive);
+        len += snprintf(lines + len, sizeof(lines) - len, "ETag: %s\r\n\r\n", variant->etag);
+        ssize_t n = send_all(worker, conn->fd, lines, len, 0);
+        if (n > 0) *bytes_sent += n;
+        worker_first_byte(worker, conn, 304);
+        return 304;
+    }
+
+    int len = http_format_status_lines(lines, sizeof(lines), 200, conn->keep_alive);
+    int inline_body = with_body && variant->body_size <= WORKER_BUNDLE_INLINE_MAX;
+    struct iovec iov[3] = {
+        { lines, len },
+        { (void *)bundle_data(bundle, variant->headers_offset), variant->headers_len },
+        { (void *)bundle_data(bundle, variant->body_offset), inline_body ? variant->body_size : 0 },
+    };
+    ssize_t n = sendmsg_all(worker, conn->fd, iov, 3, with_body && !inline_body);
+    if (n > 0) *bytes_sent += n;
+    worker_first_byte(worker, conn, 200);
+    if (n >= 0 && with_body && !inline_body) {
+        n = sendfile_all(worker, conn->fd, bundle->fd, variant->body_offset, variant->body_size);
+        if (n > 0) *bytes_sent += n;
+    }
+    return 200;
+}
+
+// Collect count completions from the thread ring in submission order (user_data = index)
+static int thread_ring_collect(worker_thread_t *thread, int *results, unsigned count) {
+    unsigned done = 0;
+    while (done < count) {
+        struct io_uring_cqe *cqe = uring_peek_cqe(&thread->ring);
+        if (!cqe) {
+            int ret = uring_submit_and_wait(&thread->ring, count - done, -1);
+            if (ret < 0 && ret != -EINTR) return -1;
+            continue;
+        }
+        if (cqe->user_data < count) results[cqe->user_data] = cqe->res;
+        uring_cqe_seen(&thread->ring);
+        done++;
+    }
+    return 0;
+}
+
+// Close the direct descriptor in slot 0
+static void thread_ring_close(worker_thread_t *thread) {
+    struct io_uring_sqe *sqe = uring_get_sqe(&thread->ring);
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->file_index = 1;
+    sqe->user_data = 0;
+
+    int result;
+    thread_ring_collect(thread, &result, 1);
+}
+
+// Move count bytes from the pipe to a non-blocking socket with splice(2), returns bytes moved or -1
+static ssize_t splice_all(worker_t *worker, int fd, int pipe_fd, size_t count) {
+    size_t moved = 0;
+    while (moved < count) {
+        ssize_t n = splice(pipe_fd, NULL, fd, NULL, count - moved, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (n > 0) {
+            moved += n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (wait_writable(worker, fd) != 0) return -1;
+        } else {
+            return -1;
+        }
+    }
+    return (ssize_t)moved;
+}
+
+// Drop what a failed send left in the thread's pipe
+static void thread_pipe_clear(worker_thread_t *thread) {
+    int left = 0;
+    while (ioctl(thread->pipe_fds[0], FIONREAD, &left) == 0 && left > 0) {
+        size_t len = (size_t)left < WORKER_FILE_CHUNK_SIZE ? (size_t)left : WORKER_FILE_CHUNK_SIZE;
+        if (read(thread->pipe_fds[0], thread->file_buffer, len) <= 0) break;
+    }
+}
+
+// Send up to len bytes of the file in slot 0 from offset to the socket without copying
+// them: file -> pipe linked to pipe -> socket in one submission, and what a full send
+// buffer did not take finished with splice(2). Returns bytes sent, 0 at end of file, -1 on error.
+static ssize_t thread_ring_splice(worker_t *worker, worker_thread_t *thread, int fd, off_t offset, size_t len) {
+    if (len > thread->pipe_size) len = thread->pipe_size;
+    if (uring_sq_space(&thread->ring) < 2) return -1;
+
+    struct io_uring_sqe *sqe = uring_get_sqe(&thread->ring);
+    sqe->opcode = IORING_OP_SPLICE;
+    sqe->fd = thread->pipe_fds[1];
+    sqe->off = (uint64_t)-1;
+    sqe->splice_fd_in = 0;
+    sqe->splice_off_in = offset;
+    sqe->splice_flags = SPLICE_F_FD_IN_FIXED | SPLICE_F_MOVE;
+    sqe->len = len;
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->user_data = 0;
+
+    // Cancelled when the file gave less than len (shrank), sent below instead
+    sqe = uring_get_sqe(&thread->ring);
+    sqe->opcode = IORING_OP_SPLICE;
+    sqe->fd = fd;
+    sqe->off = (uint64_t)-1;
+    sqe->splice_fd_in = thread->pipe_fds[0];
+    sqe->splice_off_in = (uint64_t)-1;
+    sqe->splice_flags = SPLICE_F_MOVE;
+    sqe->len = len;
+    sqe->user_data = 1;
+
+    int results[2] = { -EIO, -EIO };
+    if (thread_ring_collect(thread, results, 2) != 0) {
+        thread_pipe_clear(thread);
+        return -1;
+    }
+    if (results[0] <= 0) return results[0] == 0 ? 0 : -1;
+
+    size_t moved = results[0];
+    size_t sent = results[1] > 0 ? (size_t)results[1] : 0;
+    if (sent < moved && splice_all(worker, fd, thread->pipe_fds[0], moved - sent) != (ssize_t)(moved - sent)) {
+        thread_pipe_clear(thread);
+        return -1;
+    }
+    return (ssize_t)moved;
+}
+
+// Serve path with a linked openat2 -> statx -> read chain in one submission (io_uring
+// backend): the first chunk comes with the chain, the rest of a larger body is spliced
+// from the direct descriptor. A small cacheable file is copied into a cache entry on
+// the way. Falls back to serve_file_sync when the ring has no room for the chain.
+static int serve_file_uring(worker_t *worker, worker_thread_t *thread, connection_t *conn,
+                            const http_request_t *request, cache_t *cache, cache_flight_t **flight,
+                            int vhost, const char *path, size_t *bytes_sent) {
+    int with_body = request->method == HTTP_GET;
+    unsigned count = with_body ? 3 : 2;
+    if (uring_sq_space(&thread->ring) < count) {
+        return serve_file_sync(worker, conn, request, cache, flight, vhost, path, bytes_sent);
+    }
+
+    int root_fd = worker_docroot(worker, vhost)->root_fd;
+    const char *rel = path;
+    while (*rel == '/') rel++;
+
+    struct open_how how;
+    memset(&how, 0, sizeof(how));
+    how.flags = O_RDONLY;   // O_CLOEXEC is rejected for direct descriptors
+    how.resolve = RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS;
+    struct statx stx;
+
+    // openat2 into direct slot 0, confined to the document root like docroot_open
+    struct io_uring_sqe *sqe = uring_get_sqe(&thread->ring);
+    sqe->opcode = IORING_OP_OPENAT2;
+    sqe->fd = root_fd;
+    sqe->addr = (uint64_t)(uintptr_t)rel;
+    sqe->len = sizeof(how);
+    sqe->off = (uint64_t)(uintptr_t)&how;
+    sqe->file_index = 1;
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->user_data = 0;
+
+    // statx takes no direct descriptor, so this names the path: a file replaced in
+    // between can differ in size, and a body shorter than announced closes the connection
+    sqe = uring_get_sqe(&thread->ring);
+    sqe->opcode = IORING_OP_STATX;
+    sqe->fd = root_fd;
+    sqe->addr = (uint64_t)(uintptr_t)rel;
+    sqe->len = STATX_TYPE | STATX_SIZE | STATX_MTIME | STATX_INO;
+    sqe->off = (uint64_t)(uintptr_t)&stx;
+    sqe->flags = with_body ? IOSQE_IO_LINK : 0;
+    sqe->user_data = 1;
+
+    if (with_body) {
+        sqe = uring_get_sqe(&thread->ring);
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->fd = 0;
+        sqe->flags = IOSQE_FIXED_FILE;
+        sqe->addr = (uint64_t)(uintptr_t)thread->file_buffer;
+        sqe->len = WORKER_FILE_CHUNK_SIZE;
+        sqe->off = 0;
+        sqe->buf_index = 0;
+        sqe->user_data = 2;
+    }
+
+    int results[3] = { -EIO, -EIO, -EIO };
+    if (thread_ring_collect(thread, results, count) != 0) {
+        worker_opened(worker, conn, path, 500);
+        *bytes_sent = send_error(worker, conn, 500, with_body);
+        return 500;
+    }
+
+    if (results[0] < 0) {
+        int status = status_from_errno(-results[0]);
+        worker_opened(worker, conn, path, status);
+        *bytes_sent = send_error(worker, conn, status, with_body);
+        return status;
+    }
+
+    int status = 200;
+    if (results[1] < 0 || !S_ISREG(stx.stx_mode)) {
+        status = results[1] < 0 ? 500 : 403;
+    } else if (with_body && results[2] < 0) {
+        status = 500;
+    }
+    worker_opened(worker, conn, path, status);
+    if (status != 200) {
+        thread_ring_close(thread);
+        *bytes_sent = send_error(worker, conn, status, with_body);
+        return status;
+    }
+
+    size_t size = stx.stx_size;
+    cache_entry_t *entry = NULL;
+    if (with_body && cache_size_class(cache, size) == CACHE_LARGE) {
+        // Large files are cached from a regular descriptor (this one is a direct slot)
+        int fd = docroot_open(worker_docroot(worker, vhost), path, O_RDONLY);
+        struct stat st;
+        if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            worker_cache_load(worker, cache, vhost, path, fd, &st);
+        } else if (fd >= 0) {
+            close(fd);
+        }
+    } else if (with_body) {
+        entry = worker_cache_entry(worker, cache, vhost, path, size, -1);
+    }
+    if (!entry) cache_end_load(cache, flight);
+
+    ssize_t n = send_file_header(worker, conn, vhost, path, size, with_body && size > 0);
+    if (n > 0) *bytes_sent += n;
+
+    // First chunk from the chain (a cacheable file fits in it, and is cached before
+    // it is sent), the rest spliced chunk by chunk
+    int64_t mtime_ns = (int64_t)stx.stx_mtime.tv_sec * 1000000000 + stx.stx_mtime.tv_nsec;
+    size_t offset = 0;
+    if (with_body) offset = (size_t)results[2] < size ? (size_t)results[2] : size;
+    if (entry && offset == size) {
+        memcpy(entry->body, thread->file_buffer, size);
+        worker_cache_store(cache, entry, mtime_ns, stx.stx_ino);
+    }
+    cache_release(entry);
+    if (n >= 0 && offset > 0) {
+        n = send_all(worker, conn->fd, thread->file_buffer, offset, offset < size);
+        if (n > 0) *bytes_sent += n;
+    }
+    while (n >= 0 && with_body && offset < size) {
+        n = thread_ring_splice(worker, thread, conn->fd, offset, size - offset);
+        if (n <= 0) break;
+        *bytes_sent += n;
+        offset += n;
+    }
+
+    // The file shrank or a read failed: the body is shorter than its Content-Length,
+    // so the client can only tell where it ends by the connection closing
+    if (with_body && offset < size) conn->keep_alive = 0;
+    thread_ring_close(thread);
+    return 200;
+}
+
+// Charge a parsed request to its client's bucket (client_key is set at accept)
+static int worker_rate_allow(worker_t *worker, connection_t *conn) {
+    const server_config_t *config = worker_config(worker);
+    int rate = config_get_rate_limit_rps(config);
+    if (rate == 0) return 1;
+    return rate_limit_allow(conn->client_key, rate, config_get_rate_limit_burst(config), worker_now_ms());
+}
+
+// Parse and answer the request at the start of the connection buffer.
+// Returns 1 if the connection stays open for another request.
+static int worker_handle_request(worker_t *worker, worker_thread_t *thread, connection_t *conn) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    conn->first_byte_us = 0;
+
+    http_request_t request;
+    size_t bytes_sent = 0;
+    int status;
+    int vhost = -1;
+    const char *log_path = "-";
+    cache_flight_t *flight = NULL;     // Set while this thread loads a file others wait for
+
+    // The response must be written within TIMEOUT_SECONDS
+    worker_arm_timer(worker, conn, config_get_timeout(worker_config(worker)));
+    worker_trace_mark(worker, conn, TRACE_DEQUEUED);
+
+    // Draining after SIGTERM: answer what is in flight and close
+    int parsed = http_parse_request_arena(conn->buffer, &request, conn->arena) == 0;
+    conn->keep_alive = parsed && request.keep_alive && worker_running;
+    TRACE_PROBE3(parse_done, conn->fd, parsed, parsed ? request.path : NULL);
+    worker_trace_mark(worker, conn, TRACE_PARSED);
+    if (!parsed) {
+        status = 400;
+        request.method = HTTP_UNSUPPORTED;
+        bytes_sent = send_error(worker, conn, status, 1);
+    } else if (!worker_rate_allow(worker, conn)) {
+        // Over the client's rate: the prerendered 429, then the connection closes
+        status = 429;
+        log_path = request.path;
+        conn->keep_alive = 0;
+        ssize_t n = send_all(worker, conn->fd, worker->limit_response, worker->limit_response_len, 0);
+        if (n > 0) bytes_sent = n;
+        worker_first_byte(worker, conn, status);
+        stats_increment_rate_limited();
+    } else if (request.method == HTTP_UNSUPPORTED) {
+        status = 501;
+        log_path = request.path;
+        bytes_sent = send_error(worker, conn, status, 1);
+    } else {
+        log_path = request.path;
+
+        // Directories are served through their index.html
+        char path[MAX_PATH_LENGTH + 16];
+        size_t len = strlen(request.path);
+        snprintf(path, sizeof(path), "%s%s", request.path,
+                 request.path[len - 1] == '/' ? "index.html" : "");
+
+        // Virtual host from the hash computed while parsing (-1 = default root)
+        vhost = config_find_vhost(worker_config(worker), request.host, request.host_hash);
+
+        const bundle_t *bundle = worker_bundle(worker, vhost);
+        cache_t *cache = worker_cache(worker, vhost);
+        if (bundle) {
+            status = serve_file_bundle(worker, conn, &request, bundle, path, &bytes_sent);
+        } else if ((status = serve_file_cached(worker, conn, &request, cache, vhost, path, &bytes_sent,
+                                               &flight)) == 0) {
+            // Cache miss (or no cache): open the file, loading it into the cache if it fits
+            if (thread->ready) {
+                status = serve_file_uring(worker, thread, conn, &request, cache, &flight, vhost, path,
+                                          &bytes_sent);
+            } else {
+                status = serve_file_sync(worker, conn, &request, cache, &flight, vhost, path, &bytes_sent);
+            }
+            // Error responses leave the waiters to find the error themselves
+            cache_end_load(cache, &flight);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long elapsed_ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
+    TRACE_PROBE3(last_byte, conn->fd, status, bytes_sent);
+    if (worker->trace) {
+        worker_trace_mark(worker, conn, TRACE_LAST_BYTE);
+        trace_ring_record(worker->trace, &conn->trace, method_name(request.method), log_path,
+                          status, bytes_sent);
+        // A pipelined request behind this one starts from its own dequeue
+        memset(&conn->trace, 0, sizeof(conn->trace));
+    }
+
+    conn->requests_served++;
+    conn->bytes_sent += bytes_sent;
+
+    connection_resolve_peer(conn);
+    logger_log_access(conn->client_ip, method_name(request.method), log_path, status,
+                      bytes_sent, NULL, NULL);
+    stats_increment_request(status);
+    stats_add_bytes(bytes_sent);
+    stats_update_response_time(elapsed_ms);
+    if (vhost >= 0) stats_add_vhost_request(vhost, bytes_sent);
+
+    // Admission judges the server, not the client: the first request of a dispatch
+    // counts from when it was queued, and every request only up to its response header
+    uint64_t end_us = (uint64_t)end.tv_sec * 1000000 + end.tv_nsec / 1000;
+    uint64_t since_us = conn->queued_at_us ? conn->queued_at_us
+                                           : (uint64_t)start.tv_sec * 1000000 + start.tv_nsec / 1000;
+    uint64_t answered_us = conn->first_byte_us ? conn->first_byte_us : end_us;
+    conn->queued_at_us = 0;
+    admission_record_latency(&worker->admission,
+                             answered_us > since_us ? (long)((answered_us - since_us) / 1000) : 0);
+
+    http_free_request(&request);
+    return conn->keep_alive;
+}
+
+// Give the request arena back to the thread's pool before the connection leaves the thread
+static void connection_release_arena(worker_thread_t *thread, connection_t *conn) {
+    arena_pool_put(thread->arenas, conn->arena);
+    conn->arena = NULL;
+}
+
+// Drop the request at the start of the buffer, keeping pipelined bytes after it
+static void connection_consume(connection_t *conn, const char *request_end) {
+    size_t used = request_end - conn->buffer;
+    conn->buffer_len -= used;
+    memmove(conn->buffer, request_end, conn->buffer_len + 1);
+}
+
+// Read what is available and serve every complete request in the buffer
+static void worker_serve_connection(worker_t *worker, worker_thread_t *thread, connection_t *conn) {
+    int peer_closed = 0;
+    size_t pending = conn->buffer_len;
+    conn->arena = arena_pool_get(thread->arenas);
+    uint64_t sojourn_us = worker_now_us() - conn->queued_at_us;
+    admission_record_sojourn(&worker->admission, sojourn_us);
+    stats_record_queue_sojourn(sojourn_us);
+    TRACE_PROBE2(dequeue, conn->fd, sojourn_us);
+
+    memset(&conn->trace, 0, sizeof(conn->trace));
+    if (worker->trace) {
+        conn->trace.at_us[TRACE_QUEUED] = conn->queued_at_us;
+        if (conn->requests_served == 0) {
+            conn->trace.at_us[TRACE_ACCEPTED] = (uint64_t)conn->accepted_at.tv_sec * 1000000 +
+                                                conn->accepted_at.tv_nsec / 1000;
+        }
+    }
+
+    conn->state = CONN_STATE_PROCESSING;
+
+    // Bytes still held by the loop (io_uring) come before anything left in the socket
+    while (conn->recv_pending == 0) {
+        // Inline buffer full: continue in a large pooled buffer if one is free
+        if (conn->buffer_len >= conn->buffer_size - 1 &&
+            connection_pool_grow_buffer(worker->connections, conn) != 0) {
+            break;
+        }
+        ssize_t n = recv(conn->fd, conn->buffer + conn->buffer_len,
+                         conn->buffer_size - 1 - conn->buffer_len, MSG_DONTWAIT);
+        if (n > 0) {
+            conn->buffer_len += n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) peer_closed = 1;
+        break;
+    }
+    conn->buffer[conn->buffer_len] = '\0';
+
+    // Serve pipelined requests in order while the client keeps the connection open
+    char *end;
+    while ((end = strstr(conn->buffer, "\r\n\r\n")) != NULL) {
+        int keep = worker_handle_request(worker, thread, conn);
+        arena_reset(conn->arena);
+        if (!keep) {
+            connection_release_arena(thread, conn);
+            worker_close_connection(worker, conn);
+            return;
+        }
+        connection_consume(conn, end + 4);
+        pending = conn->buffer_len;
+    }
+
+    if (peer_closed) {
+        connection_release_arena(thread, conn);
+        worker_close_connection(worker, conn);
+        return;
+    }
+    if (conn->buffer_len >= conn->buffer_size - 1) {
+        // Header does not fit in the buffer
+        conn->keep_alive = 0;
+        send_error(worker, conn, 400, 1);
+        stats_increment_request(400);
+        connection_release_arena(thread, conn);
+        worker_close_connection(worker, conn);
+        return;
+    }
+
+    // Idle between requests, or a header started: keep the matching deadline.
+    // A header still arriving keeps the deadline armed when its first byte came.
+    if (conn->buffer_len == 0) {
+        worker_arm_timer(worker, conn, config_get_keepalive_timeout(worker_config(worker)));
+    } else if (pending == 0) {
+        worker_arm_timer(worker, conn, config_get_timeout(worker_config(worker)));
+    }
+    connection_release_arena(thread, conn);
+    worker_return_connection(worker, conn);
+}
+
+// Create the thread's arena pool and private ring (io_uring backend only)
+static void worker_thread_init(worker_t *worker, worker_thread_t *thread) {
+    memset(thread, 0, sizeof(worker_thread_t));
+    thread->ring.ring_fd = -1;
+    thread->pipe_fds[0] = thread->pipe_fds[1] = -1;
+    thread->index = __atomic_fetch_add(&worker->registered_threads, 1, __ATOMIC_RELAXED);
+    thread->arenas = arena_pool_create(WORKER_ARENAS_PER_THREAD, ARENA_DEFAULT_SIZE);
+    if (worker->backend != IO_BACKEND_IO_URING) return;
+
+    if (uring_init(&thread->ring, 8) < 0) return;
+
+    thread->file_buffer = aligned_alloc(4096, WORKER_FILE_CHUNK_SIZE);
+    struct iovec iov = { .iov_base = thread->file_buffer, .iov_len = WORKER_FILE_CHUNK_SIZE };
+    int sparse_slot = -1;
+    if (!thread->file_buffer ||
+        uring_register_buffers(&thread->ring, &iov, 1) < 0 ||
+        uring_register_files(&thread->ring, &sparse_slot, 1) < 0 ||
+        pipe2(thread->pipe_fds, O_CLOEXEC) != 0) {
+        free(thread->file_buffer);
+        thread->file_buffer = NULL;
+        uring_exit(&thread->ring);
+        return;
+    }
+
+    // Splice at most a chunk at a time: a larger request would block on the full pipe
+    int pipe_size = fcntl(thread->pipe_fds[1], F_SETPIPE_SZ, WORKER_FILE_CHUNK_SIZE);
+    if (pipe_size < 0) pipe_size = fcntl(thread->pipe_fds[1], F_GETPIPE_SZ);
+    thread->pipe_size = pipe_size > 0 && pipe_size < WORKER_FILE_CHUNK_SIZE ? (size_t)pipe_size
+                                                                          : WORKER_FILE_CHUNK_SIZE;
+    thread->ready = 1;
+}
+
+// Release the thread's ring and arenas
+static void worker_thread_cleanup(worker_thread_t *thread) {
+    if (thread->ring.ring_fd >= 0) uring_exit(&thread->ring);
+    if (thread->pipe_fds[0] >= 0) close(thread->pipe_fds[0]);
+    if (thread->pipe_fds[1] >= 0) close(thread->pipe_fds[1]);
+    free(thread->file_buffer);
+    arena_pool_destroy(thread->arenas);
+}
+
+// Thread pool routine: serve connections until the queue shuts down
+static void* worker_thread_main(void *arg) {
+    worker_t *worker = arg;
+    worker_thread_t thread;
+    worker_thread_init(worker, &thread);
+
+    connection_t *conn;
+    uint64_t idle_since = worker_now_us();
+    while ((conn = connection_queue_pop(worker->queue)) != NULL) {
+        uint64_t busy_since = worker_now_us();
+        worker_thread_enter(worker, &thread);
+        worker_serve_connection(worker, &thread, conn);
+        worker_thread_leave(worker, &thread);
+
+        // Busy serving it, idle from the previous one until the pop returned
+        uint64_t done = worker_now_us();
+        stats_add_thread_time(done - busy_since, busy_since - idle_since);
+        idle_since = done;
+    }
+
+    worker_thread_cleanup(&thread);
+    return NULL;
+}
+
+
+// ===== CACHE WARM-UP =====
+
+// Virtual host of a hot set entry by its first name (-1 = default root, -2 = no longer configured)
+static int worker_vhost_by_name(const server_config_t *config, const char *host) {
+    if (!host[0]) return -1;
+    for (int i = 0; i < config_get_num_vhosts(config); i++) {
+        if (strcmp(config_get_vhost_name(config, i), host) == 0) return i;
+    }
+    return -2;
+}
+
+// Whether shutdown asked the warm-up to stop
+static int worker_warmup_stopped(worker_t *worker) {
+    return !worker_running || __atomic_load_n(&worker->warmup_stop, __ATOMIC_RELAXED);
+}
+
+// Start readahead of a hot file (the page cache fills while the next ones are queued)
+static void worker_warmup_prefetch(worker_t *worker, const warmup_entry_t *hot) {
+    int vhost = worker_vhost_by_name(worker_config(worker), hot->host);
+    if (vhost < -1 || worker_bundle(worker, vhost)) return;
+    int fd = docroot_open(worker_docroot(worker, vhost), hot->path, O_RDONLY);
+    if (fd < 0) return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+}
+
+// Load a hot file into its cache if it fits without evicting, returns 0 if it was cached
+static int worker_warmup_load(worker_t *worker, const warmup_entry_t *hot) {
+    int vhost = worker_vhost_by_name(worker_config(worker), hot->host);
+    cache_t *cache = vhost < -1 ? NULL : worker_cache(worker, vhost);
+    if (!cache) return -1;
+
+    // A request may have loaded it already
+    cache_entry_t *entry = cache_lookup(cache, hot->path, http_path_hash(hot->path));
+    if (entry) {
+        cache_release(entry);
+        return 0;
+    }
+    int fd = docroot_open(worker_docroot(worker, vhost), hot->path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || !cache_has_room(cache, st.st_size)) {
+        close(fd);
+        return -1;
+    }
+    cache_add_frequency(cache, http_path_hash(hot->path), hot->frequency);
+    return worker_cache_load(worker, cache, vhost, hot->path, fd, &st);
+}
+
+// Warm-up thread: build the hot set, start readahead of all of it, then load the
+// hottest files into the caches while they have room. Requests are served meanwhile.
+static void* worker_warmup_main(void *arg) {
+    worker_t *worker = arg;
+    worker_thread_t thread;         // Only its configuration epoch slot is used
+    memset(&thread, 0, sizeof(thread));
+    thread.index = __atomic_fetch_add(&worker->registered_threads, 1, __ATOMIC_RELAXED);
+    setpriority(PRIO_PROCESS, gettid(), WORKER_WARMUP_NICE);
+
+    warmup_set_t *set = warmup_set_create(WARMUP_MAX_ENTRIES);
+    if (!set) return NULL;
+    worker_thread_enter(worker, &thread);
+    const server_config_t *config = worker_config(worker);
+    int from_snapshot = warmup_load(set, config_get_cache_snapshot(config));
+    int log_lines = config_get_cache_warmup_log_lines(config);
+    int from_log = log_lines > 0 ? warmup_replay_log(set, config_get_log_file(config), log_lines) : 0;
+    worker_thread_leave(worker, &thread);
+    warmup_sort(set);
+
+    for (int i = 0; i < set->count && !worker_warmup_stopped(worker); i++) {
+        worker_thread_enter(worker, &thread);
+        worker_warmup_prefetch(worker, &set->entries[i]);
+        worker_thread_leave(worker, &thread);
+    }
+    int loaded = 0;
+    for (int i = 0; i < set->count && !worker_warmup_stopped(worker); i++) {
+        worker_thread_enter(worker, &thread);
+        loaded += worker_warmup_load(worker, &set->entries[i]) == 0;
+        worker_thread_leave(worker, &thread);
+    }
+
+    if (set->count > 0) {
+        logger_log(LOG_INFO, "Worker %d: cache warm-up loaded %d of %d files (snapshot %d, access log %d)",
+                   getpid(), loaded, set->count, from_snapshot > 0 ? from_snapshot : 0,
+                   from_log > 0 ? from_log : 0);
+    }
+    warmup_set_destroy(set);
+    return NULL;
+}
+
+// Stop the warm-up thread and wait for it
+static void worker_warmup_join(worker_t *worker) {
+    if (!worker->warmup_started) return;
+    __atomic_store_n(&worker->warmup_stop, 1, __ATOMIC_RELAXED);
+    pthread_join(worker->warmup_thread, NULL);
+    worker->warmup_started = 0;
+}
+
+// Hot set being filled from the caches
+typedef struct {
+    warmup_set_t *set;
+    const char *host;
+} worker_hot_set_t;
+
+// cache_for_each callback: a file an LRU cache holds counts as one access
+static void worker_hot_file(void *arg, const char *path, unsigned frequency) {
+    worker_hot_set_t *hot = arg;
+    warmup_add(hot->set, hot->host, path, frequency > 0 ? frequency : 1);
+}
+
+// Save what the caches hold for the warm-up of the next start (CACHE_SNAPSHOT).
+// Every worker writes the whole file; they see the same traffic, the last one stays.
+static void worker_save_hot_set(worker_t *worker) {
+    const server_config_t *config = worker_config(worker);
+    const char *snapshot = config_get_cache_snapshot(config);
+    if (!snapshot[0]) return;
+
+    warmup_set_t *set = warmup_set_create(WARMUP_MAX_ENTRIES);
+    if (!set) return;
+    worker_hot_set_t hot = { set, "" };
+    cache_for_each(worker->cache, worker_hot_file, &hot);
+    for (int i = 0; i < config_get_num_vhosts(config); i++) {
+        hot.host = config_get_vhost_name(config, i);
+        cache_for_each(worker->vhost_caches[i], worker_hot_file, &hot);
+    }
+    warmup_sort(set);
+    if (set->count > 0 && warmup_save(set, snapshot) == 0) {
+        logger_log(LOG_INFO, "Worker %d: saved %d hot files to %s", getpid(), set->count, snapshot);
+    }
+    warmup_set_destroy(set);
+}
+
+
+// ===== WORKER LIFECYCLE =====
+
+// Install SIGTERM/SIGINT/SIGHUP/SIGUSR1 handlers (without SA_RESTART so waits return EINTR)
+static void worker_setup_signals(void) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = worker_signal_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGHUP, &sa, NULL);
+    sigaction(SIGUSR1, &sa, NULL);
+
+    // The parent may have them blocked (e.g. for a signalfd)
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGTERM);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGHUP);
+    sigaddset(&set, SIGUSR1);
+    pthread_sigmask(SIG_UNBLOCK, &set, NULL);
+
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, NULL);
+}
+
+// Open a document root: bundle files are mapped, directories opened as a docroot
+static int worker_open_root(const char *path, docroot_t **docroot, bundle_t **bundle) {
+    if (bundle_is_bundle(path)) {
+        *bundle = bundle_open(path);
+        return *bundle ? 0 : -1;
+    }
+    *docroot = docroot_create(path);
+    return *docroot ? 0 : -1;
+}
+
+// Run a worker process until SIGTERM/SIGINT
+int worker_run(const server_config_t *config, int listen_fd) {
+    int ret = -1;
+    worker_t worker;
+    memset(&worker, 0, sizeof(worker));
+    worker.config = config_duplicate(config);
+    worker.config_epoch = 1;
+    worker.thread_epochs = calloc(config_get_threads_per_worker(config) + 1, sizeof(uint64_t));
+    worker.listen_fd = listen_fd;
+    worker.epoll_fd = -1;
+    worker.ring.ring_fd = -1;
+    worker.backend = IO_BACKEND_EPOLL;
+    pthread_mutex_init(&worker.return_lock, NULL);
+    pthread_mutex_init(&worker.timer_lock, NULL);
+    timer_wheel_init(&worker.timers, WORKER_TIMER_TICK_MS, worker_now_ms());
+    admission_init(&worker.admission, config_get_max_queue_size(config), worker_now_ms());
+    worker_render_rejections(&worker);
+
+    worker_running = 1;
+    worker_setup_signals();
+
+    int roots_ok = worker_open_root(config_get_document_root(config), &worker.docroot, &worker.bundle) == 0;
+    for (int i = 0; i < config_get_num_vhosts(config); i++) {
+        if (worker_open_root(config_get_vhost_document_root(config, i), &worker.vhost_docroots[i],
+                             &worker.vhost_bundles[i]) != 0) {
+            roots_ok = 0;
+        }
+    }
+    worker.queue = connection_queue_create(config_get_max_queue_size(config));
+    worker.connections = connection_pool_create(WORKER_MAX_CONNECTIONS, WORKER_LARGE_BUFFERS);
+    worker.wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    worker_signal_fd = worker.wakeup_fd;
+    // Directory roots get a file cache of their share of CACHE_SIZE_MB
+    int caches_ok = 1;
+    if (worker.docroot && worker_cache_capacity(config, -1) > 0) {
+        worker.cache = cache_create(worker_cache_capacity(config, -1), config_get_cache_large_share(config),
+                                    config_get_cache_policy(config));
+        caches_ok = worker.cache != NULL;
+    }
+    for (int i = 0; i < config_get_num_vhosts(config); i++) {
+        if (!worker.vhost_docroots[i] || worker_cache_capacity(config, i) == 0) continue;
+        worker.vhost_caches[i] = cache_create(worker_cache_capacity(config, i),
+                                              config_get_cache_large_share(config),
+                                              config_get_cache_policy(config));
+        if (!worker.vhost_caches[i]) caches_ok = 0;
+    }
+    worker_limit_cache_files(&worker, config_get_threads_per_worker(config));
+    int trace_requests = config_get_trace_requests(config);
+    worker.trace = trace_ring_create(trace_requests);
+    if (!worker.config || !worker.thread_epochs || !roots_ok || !caches_ok || !worker.queue ||
+        !worker.connections || worker.wakeup_fd < 0 || (trace_requests > 0 && !worker.trace)) {
+        fprintf(stderr, "Worker %d: failed to initialize\n", getpid());
+        goto cleanup;
+    }
+
+    // Prefer io_uring when configured, fall back to epoll if the kernel refuses
+    if (config_get_io_backend(config) == IO_BACKEND_IO_URING) {
+        if (uring_loop_init(&worker) == 0) {
+            worker.backend = IO_BACKEND_IO_URING;
+        } else {
+            logger_log(LOG_WARNING, "Worker %d: io_uring unavailable (%s), using epoll",
+                       getpid(), strerror(errno));
+        }
+    }
+    if (worker.backend == IO_BACKEND_EPOLL && epoll_loop_init(&worker) != 0) {
+        goto cleanup;
+    }
+
+    // Only the event loop thread handles signals
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGTERM);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGHUP);
+    sigaddset(&block, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &block, &old);
+    worker.pool = thread_pool_create(config_get_threads_per_worker(config), worker_thread_main, &worker);
+    int has_cache = worker.cache != NULL;
+    for (int i = 0; i < config_get_num_vhosts(config); i++) has_cache |= worker.vhost_caches[i] != NULL;
+    if (worker.pool && has_cache &&
+        (config_get_cache_snapshot(config)[0] || config_get_cache_warmup_log_lines(config) > 0)) {
+        worker.warmup_started = pthread_create(&worker.warmup_thread, NULL, worker_warmup_main, &worker) == 0;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (!worker.pool) goto cleanup;
+
+    logger_log(LOG_INFO, "Worker %d started (%s backend, %d threads)", getpid(),
+               worker.backend == IO_BACKEND_IO_URING ? "io_uring" : "epoll",
+               worker.pool->num_threads);
+
+    if (worker.backend == IO_BACKEND_IO_URING) {
+        uring_loop_run(&worker);
+    } else {
+        epoll_loop_run(&worker);
+    }
+
+    // Let the threads finish what is queued and exit
+    connection_queue_shutdown(worker.queue, worker.pool->num_threads);
+    thread_pool_destroy(worker.pool);
+    worker.pool = NULL;
+    worker_warmup_join(&worker);
+    worker_save_hot_set(&worker);
+    ret = 0;
+
+    logger_log(LOG_INFO, "Worker %d stopped (%lu requests shed)", getpid(),
+               worker.admission.shed);
+
+cleanup:;
+
+    worker_warmup_join(&worker);
+    connection_t *conn = worker_take_returned(&worker);
+    while (conn) {
+        connection_t *next = conn->next;
+        worker_close_connection(&worker, conn);
+        conn = next;
+    }
+
+    if (worker.backend == IO_BACKEND_IO_URING) {
+        uring_loop_cleanup(&worker);
+    } else {
+        epoll_loop_cleanup(&worker);
+    }
+    worker_signal_fd = -1;
+    if (worker.wakeup_fd >= 0) close(worker.wakeup_fd);
+    connection_queue_destroy(worker.queue);
+    connection_pool_destroy(worker.connections);
+    trace_ring_destroy(worker.trace);
+    cache_destroy(worker.cache);
+    docroot_destroy(worker.docroot);
+    bundle_close(worker.bundle);
+    for (int i = 0; i < MAX_VHOSTS; i++) {
+        cache_destroy(worker.vhost_caches[i]);
+        docroot_destroy(worker.vhost_docroots[i]);
+        bundle_close(worker.vhost_bundles[i]);
+    }
+    pthread_mutex_destroy(&worker.return_lock);
+    pthread_mutex_destroy(&worker.timer_lock);
+    for (int i = 0; i < worker.num_retired; i++) config_destroy(worker.retired[i]);
+    config_destroy(worker.config);
+    free(worker.thread_epochs);
+    return ret;
+}
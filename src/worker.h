@@ -1 +1,137 @@
-// Interface worker 
\ No newline at end of file
+// Interface worker
+
+// cada processo worker tem um event loop (epoll ou io_uring) e um thread pool
+// o event loop aceita conexões e espera por dados, as threads servem os pedidos
+
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "config.h"
+#include "docroot.h"
+#include "bundle.h"
+#include "cache.h"
+#include "connection_queue.h"
+#include "connection_pool.h"
+#include "thread_pool.h"
+#include "uring.h"
+#include "timer_wheel.h"
+#include "admission.h"
+#include "warmup.h"
+
+// io_uring event loop sizing
+#define WORKER_URING_ENTRIES 256
+#define WORKER_RECV_BUFFERS 256                 // Provided recv buffers (power of two)
+#define WORKER_RECV_BUFFER_SIZE 4096
+#define WORKER_RECV_BUFFER_GROUP 0
+
+// Per-thread file transfer buffer (registered with the thread's ring)
+#define WORKER_FILE_CHUNK_SIZE (64 * 1024)
+
+// Bundle bodies up to this size go out with the header in one sendmsg,
+// larger ones with sendfile from the bundle file
+#define WORKER_BUNDLE_INLINE_MAX (16 * 1024)
+
+// Preallocated connections (and overflow buffers) per worker process
+#define WORKER_MAX_CONNECTIONS 1024
+#define WORKER_LARGE_BUFFERS 64
+
+// Descriptors kept free beyond the connections and two per thread (ring, file being
+// served): listen socket, eventfd, logs, document roots. What RLIMIT_NOFILE leaves
+// after them bounds the open files of the large cache entries.
+#define WORKER_RESERVED_FILES 64
+
+// Arenas preallocated per serving thread
+#define WORKER_ARENAS_PER_THREAD 4
+
+// Maximum events handled per epoll_wait call
+#define WORKER_MAX_EVENTS 64
+
+// Connection timer resolution, and the longest the event loop sleeps
+// (threads arm timers without waking it)
+#define WORKER_TIMER_TICK_MS 100
+#define WORKER_MAX_WAIT_MS 1000
+
+// Nice value of the cache warm-up thread (behind the serving threads)
+#define WORKER_WARMUP_NICE 10
+
+// Replaced configurations waiting for the threads to stop using them
+#define WORKER_MAX_RETIRED_CONFIGS 8
+
+// State of one worker process
+typedef struct {
+    server_config_t *config;        // Current version, read through worker_config()
+    int listen_fd;                  // Listening socket inherited from the master
+    io_backend_t backend;           // Backend in use (after fallback)
+    docroot_t *docroot;             // Document root anchor for file opens
+    docroot_t *vhost_docroots[MAX_VHOSTS];  // Roots of the [vhost] blocks (by index)
+    bundle_t *bundle;               // Mapped bundle when DOCUMENT_ROOT is a bundle file
+    bundle_t *vhost_bundles[MAX_VHOSTS];    // Same for the [vhost] blocks
+    cache_t *cache;                 // File cache of a directory DOCUMENT_ROOT (NULL = none)
+    cache_t *vhost_caches[MAX_VHOSTS];      // Same for the [vhost] blocks (their CACHE_SHARE)
+    connection_queue_t *queue;      // Connections ready to be served
+    connection_pool_t *connections; // Preallocated connection objects
+    thread_pool_t *pool;            // THREADS_PER_WORKER serving threads
+
+    // Connections handed back to the event loop by the threads
+    int wakeup_fd;                  // eventfd that wakes the event loop
+    pthread_mutex_t return_lock;    // Protects return_head and the recycled buffer ids
+    connection_t *return_head;
+    unsigned recycled_bids[WORKER_RECV_BUFFERS];   // Provided buffers released by a close
+    int num_recycled_bids;
+
+    // Connection deadlines (armed by the loop and the threads, expired by the loop)
+    pthread_mutex_t timer_lock;     // Protects timers
+    timer_wheel_t timers;
+
+    // Shutdown: stop accepting, let connections finish until the deadline
+    int draining;
+    uint64_t drain_deadline_ms;
+
+    // Load shedding before connections are queued, and the answer to clients over their rate
+    admission_t admission;
+    char shed_response[256];        // Prerendered 503 with Retry-After
+    size_t shed_response_len;
+    char limit_response[256];       // Prerendered 429 for clients over RATE_LIMIT_RPS
+    size_t limit_response_len;
+
+    // Background cache warm-up from the hot set of the previous run
+    pthread_t warmup_thread;
+    int warmup_started;
+    int warmup_stop;                // Set on shutdown, checked between files
+
+    // Timelines of the last TRACE_REQUESTS requests (NULL when off)
+    trace_ring_t *trace;
+
+    // Contention on return_lock and timer_lock (the queue and caches count their own)
+    unsigned long lock_waits;
+    unsigned long lock_wait_us;
+    uint64_t gauges_published_ms;   // Last stats_set_worker_gauges
+
+    // Configuration versions: threads read the current one without locks and
+    // the event loop frees a replaced one once every thread has moved past it
+    uint64_t config_epoch;          // Bumped on every publish (starts at 1)
+    uint64_t *thread_epochs;        // Epoch each thread (and the warm-up) entered at, 0 while idle
+    int registered_threads;         // Slots of thread_epochs in use
+    server_config_t *retired[WORKER_MAX_RETIRED_CONFIGS];
+    uint64_t retired_epoch[WORKER_MAX_RETIRED_CONFIGS];
+    int num_retired;
+
+    // epoll backend
+    int epoll_fd;
+
+    // io_uring backend
+    uring_t ring;
+    uring_buf_ring_t recv_buffers;  // Provided buffers selected by recv
+    int multishot_accept;           // Cleared if the kernel rejects multishot accept
+    uint64_t wakeup_value;          // Target of the pending eventfd read
+} worker_t;
+
+
+//WORKER API
+// Run a worker process until SIGTERM/SIGINT, then drain its connections for up to
+// TIMEOUT_SECONDS (SIGHUP reloads the in-place settings). Returns 0 on clean exit, -1 on error.
+int worker_run(const server_config_t *config, int listen_fd);
+
+#endif
@@ -0,0 +1,467 @@
+// Micro-benchmarks
+
+// mede os caminhos quentes de um pedido: parser HTTP, construção do cabeçalho de
+// resposta, MIME, descodificação de URLs, estatísticas partilhadas sob contenção
+// e o access log
+// os pedidos de teste imitam browsers reais (cabeçalhos completos, cookies longos,
+// rajadas em pipelining)
+// cada benchmark corre fixado a um CPU e reporta ns/op, alocações/op (malloc
+// intercetado) e ciclos/op via perf_event_open quando o kernel o permite
+//
+//   make bench                 todos os benchmarks
+//   ./benchmarks parse         só os que contêm "parse" no nome
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "config.h"
+#include "http.h"
+#include "arena.h"
+#include "stats.h"
+#include "logger.h"
+
+// Each measurement runs for about this long, the best of BENCH_ROUNDS is reported
+#define BENCH_TARGET_NS (200 * 1000000ULL)
+#define BENCH_ROUNDS 3
+
+// Requests in the pipelined burst
+#define BENCH_PIPELINE_DEPTH 16
+
+// Operations per thread in the contention benchmark
+#define BENCH_CONTENTION_OPS 2000000
+
+// Keeps results alive so the compiler cannot drop the benchmarked calls
+static volatile uintptr_t bench_sink;
+
+
+// ===== ALLOCATION COUNTING =====
+
+// glibc entry points behind malloc (replacing malloc is supported by glibc)
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static uint64_t bench_allocations;
+
+void *malloc(size_t size) {
+    __atomic_fetch_add(&bench_allocations, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    __atomic_fetch_add(&bench_allocations, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    __atomic_fetch_add(&bench_allocations, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+
+
+// ===== MEASUREMENT =====
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// User-space cycle counter of the calling thread, -1 if perf events are not allowed
+static int open_cycle_counter(void) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static int pin_to_cpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu % CPU_SETSIZE, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// A benchmark body: runs the operation iterations times
+typedef void (*bench_fn_t)(void *arg, uint64_t iterations);
+
+typedef struct {
+    double ns_per_op;
+    double allocs_per_op;
+    double cycles_per_op;       // < 0 when unavailable
+} bench_result_t;
+
+static int cycle_fd = -1;
+static const char *bench_filter = NULL;
+
+static void print_result(const char *name, const bench_result_t *result) {
+    char cycles[32] = "-";
+    if (result->cycles_per_op >= 0) snprintf(cycles, sizeof(cycles), "%.1f", result->cycles_per_op);
+    printf("%-40s %12.1f %12.2f %12s\n", name, result->ns_per_op, result->allocs_per_op, cycles);
+    fflush(stdout);
+}
+
+// Calibrate the iteration count, then keep the best of BENCH_ROUNDS runs
+static void bench_run(const char *name, bench_fn_t fn, void *arg) {
+    if (bench_filter && !strstr(name, bench_filter)) return;
+
+    uint64_t iterations = 16;
+    for (;;) {
+        uint64_t start = now_ns();
+        fn(arg, iterations);
+        uint64_t elapsed = now_ns() - start;
+        if (elapsed >= BENCH_TARGET_NS / 10 || iterations >= (1ULL << 32)) {
+            iterations = elapsed ? iterations * BENCH_TARGET_NS / elapsed : iterations * 10;
+            break;
+        }
+        iterations *= 4;
+    }
+    if (iterations == 0) iterations = 1;
+
+    bench_result_t best = { -1, 0, -1 };
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        uint64_t allocs = __atomic_load_n(&bench_allocations, __ATOMIC_RELAXED);
+        if (cycle_fd >= 0) {
+            ioctl(cycle_fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(cycle_fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+        uint64_t start = now_ns();
+        fn(arg, iterations);
+        uint64_t elapsed = now_ns() - start;
+        uint64_t cycles = 0;
+        if (cycle_fd >= 0) {
+            ioctl(cycle_fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(cycle_fd, &cycles, sizeof(cycles)) != sizeof(cycles)) cycles = 0;
+        }
+
+        bench_result_t result = {
+            .ns_per_op = (double)elapsed / iterations,
+            .allocs_per_op = (double)(__atomic_load_n(&bench_allocations, __ATOMIC_RELAXED) - allocs) / iterations,
+            .cycles_per_op = cycle_fd >= 0 ? (double)cycles / iterations : -1,
+        };
+        if (best.ns_per_op < 0 || result.ns_per_op < best.ns_per_op) best = result;
+    }
+    print_result(name, &best);
+}
+
+
+// ===== REQUEST CORPORA =====
+
+static const char *request_simple =
+    "GET /index.html HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "\r\n";
+
+static const char *request_browser =
+    "GET /assets/css/main.min.css?v=20240611 HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "Connection: keep-alive\r\n"
+    "sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\", \"Not-A.Brand\";v=\"99\"\r\n"
+    "sec-ch-ua-mobile: ?0\r\n"
+    "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 "
+    "(KHTML, like Gecko) Chrome/124.0.0.0 Safari/537.36\r\n"
+    "sec-ch-ua-platform: \"Windows\"\r\n"
+    "Accept: text/css,*/*;q=0.1\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "Sec-Fetch-Mode: no-cors\r\n"
+    "Sec-Fetch-Dest: style\r\n"
+    "Referer: https://www.example.com/products/category/shoes?page=2&sort=price\r\n"
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+    "Accept-Language: en-GB,en-US;q=0.9,en;q=0.8,pt;q=0.7\r\n"
+    "If-None-Match: \"5f2c1a9b3e7d4c60\"\r\n"
+    "\r\n";
+
+// Browser request with a ~4 KB Cookie header (analytics and session cookies)
+static char request_cookie[8192];
+
+// BENCH_PIPELINE_DEPTH browser requests back to back, as one read would return them
+static char request_burst[BENCH_PIPELINE_DEPTH * 1024];
+
+static void build_corpora(void) {
+    size_t len = snprintf(request_cookie, sizeof(request_cookie),
+                          "GET /account/orders HTTP/1.1\r\n"
+                          "Host: www.example.com\r\n"
+                          "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:125.0) Gecko/20100101 Firefox/125.0\r\n"
+                          "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+                          "Accept-Language: en-US,en;q=0.5\r\n"
+                          "Accept-Encoding: gzip, deflate, br\r\n"
+                          "Connection: keep-alive\r\n"
+                          "Cookie: ");
+    for (int i = 0; len < 4200; i++) {
+        len += snprintf(request_cookie + len, sizeof(request_cookie) - len,
+                        "%s_ga_%02d=GS1.1.17%08d.%d.1.17%08d.0.0.0",
+                        i ? "; " : "", i, i * 7919, i % 9, i * 104729);
+    }
+    snprintf(request_cookie + len, sizeof(request_cookie) - len, "\r\nUpgrade-Insecure-Requests: 1\r\n\r\n");
+
+    len = 0;
+    for (int i = 0; i < BENCH_PIPELINE_DEPTH; i++) {
+        const char *request = request_browser;
+        size_t n = strlen(request);
+        memcpy(request_burst + len, request, n);
+        len += n;
+    }
+    request_burst[len] = '\0';
+}
+
+
+// ===== HTTP BENCHMARKS =====
+
+static void bench_parse(void *arg, uint64_t iterations) {
+    const char *buffer = arg;
+    http_request_t request;
+    for (uint64_t i = 0; i < iterations; i++) {
+        if (http_parse_request(buffer, &request) == 0) {
+            bench_sink += request.path_hash;
+            http_free_request(&request);
+        }
+    }
+}
+
+static arena_t *bench_arena;
+
+static void bench_parse_arena(void *arg, uint64_t iterations) {
+    const char *buffer = arg;
+    http_request_t request;
+    for (uint64_t i = 0; i < iterations; i++) {
+        if (http_parse_request_arena(buffer, &request, bench_arena) == 0) {
+            bench_sink += request.path_hash;
+        }
+        arena_reset(bench_arena);
+    }
+}
+
+// The worker's pipelining loop: find the end of each header, parse, move on
+static void bench_parse_burst(void *arg, uint64_t iterations) {
+    (void)arg;
+    http_request_t request;
+    for (uint64_t i = 0; i < iterations; i++) {
+        const char *buffer = request_burst;
+        const char *end;
+        while ((end = strstr(buffer, "\r\n\r\n")) != NULL) {
+            if (http_parse_request_arena(buffer, &request, bench_arena) == 0) {
+                bench_sink += request.path_hash;
+            }
+            arena_reset(bench_arena);
+            buffer = end + 4;
+        }
+    }
+}
+
+static void bench_response_header(void *arg, uint64_t iterations) {
+    (void)arg;
+    for (uint64_t i = 0; i < iterations; i++) {
+        char *header = http_create_response_header(200, "text/html", 1024 + (i & 1023));
+        bench_sink += (uintptr_t)header;
+        free(header);
+    }
+}
+
+static void bench_response_header_arena(void *arg, uint64_t iterations) {
+    (void)arg;
+    for (uint64_t i = 0; i < iterations; i++) {
+        char *header = http_create_response_header_arena(bench_arena, 200, "text/html", 1024 + (i & 1023), 1);
+        bench_sink += (uintptr_t)header;
+        arena_reset(bench_arena);
+    }
+}
+
+static void bench_mime(void *arg, uint64_t iterations) {
+    (void)arg;
+    static const char *files[] = {
+        "/index.html", "/assets/app.js", "/css/site.min.css", "/img/logo.png",
+        "/photos/IMG_2041.JPG", "/fonts/inter.woff2", "/docs/manual.pdf", "/README",
+    };
+    for (uint64_t i = 0; i < iterations; i++) {
+        bench_sink += (uintptr_t)http_get_mime_type(files[i & 7]);
+    }
+}
+
+static void bench_url_decode(void *arg, uint64_t iterations) {
+    (void)arg;
+    char decoded[256];
+    for (uint64_t i = 0; i < iterations; i++) {
+        http_url_decode(decoded, "/search/r%C3%A9sum%C3%A9%20templates/caf%C3%A9%2Fbar%3Fq%3D1");
+        bench_sink += (unsigned char)decoded[i & 15];
+    }
+}
+
+static void bench_canonicalize(void *arg, uint64_t iterations) {
+    (void)arg;
+    char canonical[256];
+    uint32_t hash;
+    for (uint64_t i = 0; i < iterations; i++) {
+        http_canonicalize_path("/static//js/./vendor/../app.bundle.js?v=3", canonical, sizeof(canonical), &hash);
+        bench_sink += hash;
+    }
+}
+
+
+// ===== STATS CONTENTION =====
+
+typedef struct {
+    int cpu;
+    uint64_t ops;
+    pthread_barrier_t *barrier;
+} contention_arg_t;
+
+static void* contention_thread(void *arg) {
+    contention_arg_t *contention = arg;
+    pin_to_cpu(contention->cpu);
+    pthread_barrier_wait(contention->barrier);
+    for (uint64_t i = 0; i < contention->ops; i++) {
+        stats_increment_request(200);
+    }
+    return NULL;
+}
+
+// threads increment the shared counters at once; ns/op is wall time per increment of one thread
+static void bench_stats_contention(int threads) {
+    char name[64];
+    snprintf(name, sizeof(name), "stats_increment_request/%d-threads", threads);
+    if (bench_filter && !strstr(name, bench_filter)) return;
+
+    pthread_t ids[threads];
+    contention_arg_t args[threads];
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, threads + 1);
+    int ncpu = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    uint64_t allocs = __atomic_load_n(&bench_allocations, __ATOMIC_RELAXED);
+    for (int i = 0; i < threads; i++) {
+        args[i] = (contention_arg_t){ .cpu = i % (ncpu > 0 ? ncpu : 1), .ops = BENCH_CONTENTION_OPS,
+                                      .barrier = &barrier };
+        pthread_create(&ids[i], NULL, contention_thread, &args[i]);
+    }
+    uint64_t start = now_ns();
+    pthread_barrier_wait(&barrier);
+    for (int i = 0; i < threads; i++) pthread_join(ids[i], NULL);
+    uint64_t elapsed = now_ns() - start;
+    pthread_barrier_destroy(&barrier);
+
+    // Thread creation allocates too, so allocations are per increment over all threads
+    bench_result_t result = {
+        .ns_per_op = (double)elapsed / BENCH_CONTENTION_OPS,
+        .allocs_per_op = (double)(__atomic_load_n(&bench_allocations, __ATOMIC_RELAXED) - allocs) /
+                         ((double)BENCH_CONTENTION_OPS * threads),
+        .cycles_per_op = -1,
+    };
+    print_result(name, &result);
+}
+
+
+// ===== ACCESS LOG =====
+
+static void bench_access_log(void *arg, uint64_t iterations) {
+    (void)arg;
+    for (uint64_t i = 0; i < iterations; i++) {
+        logger_log_access("192.168.10.24", "GET", "/assets/css/main.min.css", 200, 18231,
+                          "https://www.example.com/", "Mozilla/5.0");
+    }
+}
+
+// The access log also echoes to stdout; that goes to /dev/null while measuring
+static void run_access_log_bench(void) {
+    if (bench_filter && !strstr("logger_log_access", bench_filter)) return;
+
+    char log_path[] = "/tmp/bench_access_XXXXXX";
+    int fd = mkstemp(log_path);
+    if (fd < 0) return;
+    close(fd);
+
+    server_config_t config;
+    config_init_defaults(&config);
+    snprintf(config.log_file, sizeof(config.log_file), "%s", log_path);
+    if (logger_init(&config) != 0) {
+        unlink(log_path);
+        return;
+    }
+
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    bench_result_t result = { 0, 0, -1 };
+    if (saved_stdout >= 0 && null_fd >= 0) {
+        dup2(null_fd, STDOUT_FILENO);
+        uint64_t iterations = 20000;
+        uint64_t allocs = __atomic_load_n(&bench_allocations, __ATOMIC_RELAXED);
+        uint64_t start = now_ns();
+        bench_access_log(NULL, iterations);
+        fflush(stdout);
+        uint64_t elapsed = now_ns() - start;
+        result.ns_per_op = (double)elapsed / iterations;
+        result.allocs_per_op = (double)(__atomic_load_n(&bench_allocations, __ATOMIC_RELAXED) - allocs) / iterations;
+        dup2(saved_stdout, STDOUT_FILENO);
+    }
+    if (saved_stdout >= 0) close(saved_stdout);
+    if (null_fd >= 0) close(null_fd);
+    logger_close();
+
+    // Rotation may have renamed the file
+    char rotated[sizeof(log_path) + 8];
+    for (int i = 0; i < 5; i++) {
+        snprintf(rotated, sizeof(rotated), "%s.%d", log_path, i);
+        unlink(rotated);
+    }
+    unlink(log_path);
+    print_result("logger_log_access", &result);
+}
+
+
+int main(int argc, char *argv[]) {
+    bench_filter = argc > 1 ? argv[1] : NULL;
+
+    if (pin_to_cpu(0) != 0) fprintf(stderr, "Could not pin to CPU 0, results will be noisier\n");
+    cycle_fd = open_cycle_counter();
+    if (cycle_fd < 0) fprintf(stderr, "perf_event_open unavailable, cycles/op not reported\n");
+
+    build_corpora();
+    bench_arena = arena_create(ARENA_DEFAULT_SIZE);
+    if (!bench_arena || stats_init(NULL) != 0) return EXIT_FAILURE;
+
+    printf("%-40s %12s %12s %12s\n", "benchmark", "ns/op", "allocs/op", "cycles/op");
+    bench_run("http_parse_request/simple", bench_parse, (void *)request_simple);
+    bench_run("http_parse_request/browser", bench_parse, (void *)request_browser);
+    bench_run("http_parse_request/cookie-4k", bench_parse, request_cookie);
+    bench_run("http_parse_request_arena/browser", bench_parse_arena, (void *)request_browser);
+    bench_run("http_parse_request_arena/cookie-4k", bench_parse_arena, request_cookie);
+    bench_run("http_parse_request_arena/pipelined-16", bench_parse_burst, NULL);
+    bench_run("http_create_response_header", bench_response_header, NULL);
+    bench_run("http_create_response_header_arena", bench_response_header_arena, NULL);
+    bench_run("http_get_mime_type", bench_mime, NULL);
+    bench_run("http_url_decode", bench_url_decode, NULL);
+    bench_run("http_canonicalize_path", bench_canonicalize, NULL);
+
+    int ncpu = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int counts[] = { 1, 2, 4, ncpu > 4 ? ncpu : 0 };
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        if (counts[i] > 0) bench_stats_contention(counts[i]);
+    }
+
+    run_access_log_bench();
+
+    if (cycle_fd >= 0) close(cycle_fd);
+    arena_destroy(bench_arena);
+    stats_cleanup();
+    return EXIT_SUCCESS;
+}
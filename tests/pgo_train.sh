@@ -0,0 +1,58 @@
+#!/bin/bash
+# Treino PGO
+
+# corre os binários instrumentados (make pgo) com o corpus tests/pgo_corpus.txt:
+# a raiz www/ e o mesmo conteúdo num bundle, com os backends epoll e io_uring,
+# em keep-alive, pipelining e uma conexão por pedido
+# o servidor termina com SIGTERM para os processos escreverem os perfis (.gcda)
+#
+#   tests/pgo_train.sh [segundos por cenário]
+#   não compila nada: espera ./server, ./bundle e ./test_concurrent já construídos
+
+set -e
+cd "$(dirname "$0")/.."
+
+DURATION=${1:-2}
+PORT=${PORT:-8098}
+CORPUS=tests/pgo_corpus.txt
+
+TMP=$(mktemp -d)
+SERVER_PID=
+stop_server() {
+    if [ -n "$SERVER_PID" ]; then
+        kill -TERM "$SERVER_PID" 2>/dev/null || true
+        wait "$SERVER_PID" 2>/dev/null || true
+        SERVER_PID=
+    fi
+}
+trap 'stop_server; rm -rf "$TMP"' EXIT
+
+./bundle www "$TMP/www.bundle" >/dev/null
+
+for root in "$PWD/www" "$TMP/www.bundle"; do
+    for backend in epoll io_uring; do
+        cat > "$TMP/train.conf" <<CONF
+PORT=$PORT
+DOCUMENT_ROOT=$root
+NUM_WORKERS=2
+THREADS_PER_WORKER=4
+IO_BACKEND=$backend
+LOG_FILE=$TMP/access.log
+LOG_LEVEL=warning
+CONF
+        ./server "$TMP/train.conf" > "$TMP/server.log" 2>&1 &
+        SERVER_PID=$!
+        sleep 0.5
+        if ! kill -0 "$SERVER_PID" 2>/dev/null; then
+            cat "$TMP/server.log" >&2
+            exit 1
+        fi
+
+        for args in "-c 16" "-c 4 -P 8" "-c 16 -C"; do
+            echo "training: $(basename "$root") $backend $args"
+            # shellcheck disable=SC2086
+            ./test_concurrent -p "$PORT" -f "$CORPUS" -r 2000 -d "$DURATION" -D 1 $args > /dev/null
+        done
+        stop_server
+    done
+done
@@ -0,0 +1,736 @@
+// Teste de carga concorrente
+
+// gerador de carga multi-thread para o servidor, numa só máquina Linux (loopback)
+// cada thread tem o seu epoll e as suas conexões e agenda pedidos a ritmo constante
+// (open loop): a latência conta desde o instante em que o pedido devia ter saído,
+// por isso um servidor lento não esconde os pedidos que ficaram à espera
+// (coordinated omission)
+// modos: keep-alive, pipelining (-P) e uma conexão por pedido (-C)
+// com -f repete um corpus de pedidos gravados em vez de um só GET
+// o resultado sai em JSON: débito, erros e percentis de latência (histograma HDR)
+//
+//   make load && ./test_concurrent -p 8080 -r 5000 -d 10 -t 2 -c 64
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#define LOAD_MAX_PIPELINE 64
+#define LOAD_MAX_REQUEST 1024
+#define LOAD_MAX_CORPUS 1024
+#define LOAD_READ_BUFFER (16 * 1024)
+#define LOAD_MAX_EVENTS 256
+#define LOAD_RECONNECT_DELAY_NS (100 * 1000000ULL)
+
+// HDR-style histogram of microseconds: exact below HIST_LINEAR, then HIST_HALF
+// sub-buckets per power of two (relative error below 0.2%)
+#define HIST_SUB_BITS 9
+#define HIST_HALF (1 << HIST_SUB_BITS)
+#define HIST_LINEAR (2 * HIST_HALF)
+#define HIST_MAX_SHIFT 34
+#define HIST_BUCKETS (HIST_LINEAR + HIST_MAX_SHIFT * HIST_HALF)
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    double sum;
+} histogram_t;
+
+// Command line
+typedef struct {
+    const char *address;
+    int port;
+    int threads;
+    int connections;
+    double rate;            // Requests per second, all threads together
+    double duration;        // Measured seconds
+    double warmup;          // Seconds sent but not recorded
+    double drain;           // Seconds to wait for responses after the last send
+    int pipeline;           // Requests in flight per connection
+    int close_mode;         // One connection per request
+    const char *path;
+    const char *host;
+    const char *corpus;     // File of recorded requests, NULL = GET path
+} load_options_t;
+
+// One client connection
+typedef struct {
+    int fd;                             // -1 when closed
+    int connecting;                     // Non-blocking connect in progress
+    int want_write;                     // EPOLLOUT registered
+    uint64_t retry_at;                  // Earliest reconnect after a failure
+    uint64_t intended[LOAD_MAX_PIPELINE];   // Intended send times of requests in flight
+    int head;
+    int inflight;
+    char *out;                          // Request bytes not yet written
+    size_t out_len;
+    size_t out_off;
+    char in[LOAD_READ_BUFFER];
+    size_t in_len;
+    int in_body;                        // Header parsed, reading the body
+    int until_eof;                      // No Content-Length: the body ends with the connection
+    uint64_t body_left;
+    int status;
+    uint64_t response_bytes;
+} load_conn_t;
+
+// One load generating thread
+typedef struct {
+    int index;
+    pthread_t thread;
+    int epoll_fd;
+    load_conn_t *conns;
+    int num_conns;
+    int next_conn;
+
+    // Request k is due at start_ns + k * interval_ns
+    uint64_t start_ns;
+    uint64_t interval_ns;
+    uint64_t record_from_ns;            // End of the warm-up
+    uint64_t end_ns;                    // No requests are due after this
+    uint64_t scheduled;                 // Requests due so far
+    uint64_t dispatched;                // Requests handed to a connection
+    int inflight;
+
+    histogram_t hist;
+    uint64_t completed;
+    uint64_t bytes;
+    uint64_t errors_connect;
+    uint64_t errors_read;
+    uint64_t errors_write;
+    uint64_t errors_status;
+    uint64_t timeouts;
+} load_thread_t;
+
+static load_options_t options = {
+    .address = "127.0.0.1",
+    .port = 8080,
+    .threads = 1,
+    .connections = 16,
+    .rate = 1000,
+    .duration = 10,
+    .warmup = 0,
+    .drain = 2,
+    .pipeline = 1,
+    .close_mode = 0,
+    .path = "/",
+    .host = "localhost",
+};
+
+static struct sockaddr_in server_addr;
+static char request_text[LOAD_MAX_REQUEST];
+
+// Requests sent in turn: request k of the global schedule is requests[k % num_requests]
+static char *requests[LOAD_MAX_CORPUS];
+static size_t request_lens[LOAD_MAX_CORPUS];
+static int num_requests;
+static size_t max_request_len;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+// ===== HISTOGRAM =====
+
+static int hist_index(uint64_t value) {
+    if (value < HIST_LINEAR) return (int)value;
+    int shift = 63 - __builtin_clzll(value) - HIST_SUB_BITS;
+    if (shift > HIST_MAX_SHIFT) return HIST_BUCKETS - 1;
+    return HIST_LINEAR + (shift - 1) * HIST_HALF + (int)((value >> shift) - HIST_HALF);
+}
+
+// Highest value that falls into bucket index
+static uint64_t hist_highest(int index) {
+    if (index < HIST_LINEAR) return index;
+    int shift = (index - HIST_LINEAR) / HIST_HALF + 1;
+    uint64_t top = (index - HIST_LINEAR) % HIST_HALF + HIST_HALF;
+    return ((top + 1) << shift) - 1;
+}
+
+static void hist_record(histogram_t *hist, uint64_t value) {
+    hist->counts[hist_index(value)]++;
+    if (hist->total == 0 || value < hist->min) hist->min = value;
+    if (value > hist->max) hist->max = value;
+    hist->total++;
+    hist->sum += value;
+}
+
+static void hist_merge(histogram_t *dst, const histogram_t *src) {
+    if (src->total == 0) return;
+    for (int i = 0; i < HIST_BUCKETS; i++) dst->counts[i] += src->counts[i];
+    if (dst->total == 0 || src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+    dst->total += src->total;
+    dst->sum += src->sum;
+}
+
+// Value at percentile (0-100]
+static uint64_t hist_percentile(const histogram_t *hist, double percentile) {
+    if (hist->total == 0) return 0;
+    uint64_t target = (uint64_t)(percentile / 100.0 * hist->total + 0.5);
+    if (target < 1) target = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += hist->counts[i];
+        if (seen >= target) {
+            uint64_t value = hist_highest(i);
+            return value < hist->max ? value : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+
+// ===== CONNECTIONS =====
+
+static void conn_set_events(load_thread_t *thread, load_conn_t *conn, int want_write) {
+    if (conn->want_write == want_write) return;
+    struct epoll_event ev = { .events = EPOLLIN | (want_write ? EPOLLOUT : 0), .data.ptr = conn };
+    epoll_ctl(thread->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+    conn->want_write = want_write;
+}
+
+// Drop the connection; requests still in flight are lost
+static void conn_close(load_thread_t *thread, load_conn_t *conn, uint64_t *lost_counter) {
+    if (conn->fd >= 0) close(conn->fd);
+    conn->fd = -1;
+    if (lost_counter) *lost_counter += conn->inflight;
+    thread->inflight -= conn->inflight;
+    conn->inflight = 0;
+    conn->head = 0;
+    conn->out_len = conn->out_off = 0;
+    conn->in_len = 0;
+    conn->in_body = 0;
+    conn->until_eof = 0;
+    conn->response_bytes = 0;
+}
+
+// Start a non-blocking connect
+static int conn_open(load_thread_t *thread, load_conn_t *conn, uint64_t now) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    conn->connecting = 0;
+    if (connect(fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) != 0) {
+        if (errno != EINPROGRESS) {
+            close(fd);
+            thread->errors_connect++;
+            conn->retry_at = now + LOAD_RECONNECT_DELAY_NS;
+            return -1;
+        }
+        conn->connecting = 1;
+    }
+
+    conn->fd = fd;
+    conn->want_write = conn->connecting;
+    struct epoll_event ev = { .events = EPOLLIN | (conn->connecting ? EPOLLOUT : 0), .data.ptr = conn };
+    if (epoll_ctl(thread->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        close(fd);
+        conn->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+// Write pending request bytes
+static void conn_flush(load_thread_t *thread, load_conn_t *conn) {
+    if (conn->connecting) return;
+    while (conn->out_off < conn->out_len) {
+        ssize_t n = send(conn->fd, conn->out + conn->out_off, conn->out_len - conn->out_off, MSG_NOSIGNAL);
+        if (n > 0) {
+            conn->out_off += n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            conn_set_events(thread, conn, 1);
+            return;
+        } else {
+            conn_close(thread, conn, &thread->errors_write);
+            return;
+        }
+    }
+    conn->out_len = conn->out_off = 0;
+    conn_set_events(thread, conn, 0);
+}
+
+// Queue one request that was due at intended
+static void conn_send(load_thread_t *thread, load_conn_t *conn, uint64_t intended) {
+    int slot = (conn->head + conn->inflight) % LOAD_MAX_PIPELINE;
+    conn->intended[slot] = intended;
+    conn->inflight++;
+    thread->inflight++;
+    if (conn->out_off == conn->out_len) conn->out_len = conn->out_off = 0;
+    int index = (int)((thread->dispatched * options.threads + thread->index) % num_requests);
+    memcpy(conn->out + conn->out_len, requests[index], request_lens[index]);
+    conn->out_len += request_lens[index];
+    conn_flush(thread, conn);
+}
+
+// A response finished: record the latency of the oldest request in flight
+static void conn_response_done(load_thread_t *thread, load_conn_t *conn, uint64_t now) {
+    if (conn->inflight == 0) {
+        thread->errors_read++;      // Response nobody asked for
+        return;
+    }
+    uint64_t intended = conn->intended[conn->head];
+    conn->head = (conn->head + 1) % LOAD_MAX_PIPELINE;
+    conn->inflight--;
+    thread->inflight--;
+
+    if (intended >= thread->record_from_ns) {
+        hist_record(&thread->hist, (now - intended) / 1000);
+        thread->completed++;
+        thread->bytes += conn->response_bytes;
+        if (conn->status < 200 || conn->status >= 400) thread->errors_status++;
+    }
+    conn->response_bytes = 0;
+    conn->in_body = 0;
+    conn->until_eof = 0;
+
+    if (options.close_mode) conn_close(thread, conn, NULL);
+}
+
+// Parse a response header at the start of conn->in, returns its length, 0 if incomplete, -1 if malformed
+static int conn_parse_header(load_conn_t *conn) {
+    char *end = memmem(conn->in, conn->in_len, "\r\n\r\n", 4);
+    if (!end) return conn->in_len == sizeof(conn->in) ? -1 : 0;
+    size_t header_len = end + 4 - conn->in;
+
+    if (conn->in_len < 12 || strncmp(conn->in, "HTTP/1.", 7) != 0) return -1;
+    conn->status = atoi(conn->in + 9);
+
+    conn->until_eof = 1;
+    conn->body_left = 0;
+    for (char *line = conn->in; line < end; ) {
+        char *next = memmem(line, end + 2 - line, "\r\n", 2);
+        if (!next) break;
+        if (strncasecmp(line, "Content-Length:", 15) == 0) {
+            conn->body_left = strtoull(line + 15, NULL, 10);
+            conn->until_eof = 0;
+        }
+        line = next + 2;
+    }
+    if (conn->status == 204 || conn->status == 304) conn->until_eof = 0;
+    return (int)header_len;
+}
+
+// Consume complete responses from the read buffer
+static void conn_process_input(load_thread_t *thread, load_conn_t *conn, uint64_t now) {
+    size_t used = 0;
+    while (conn->fd >= 0) {
+        if (!conn->in_body) {
+            // Parse in place at the start of the buffer
+            memmove(conn->in, conn->in + used, conn->in_len - used);
+            conn->in_len -= used;
+            used = 0;
+            int header_len = conn_parse_header(conn);
+            if (header_len < 0) {
+                conn_close(thread, conn, &thread->errors_read);
+                return;
+            }
+            if (header_len == 0) break;
+            used += header_len;
+            conn->response_bytes += header_len;
+            conn->in_body = 1;
+        }
+
+        size_t available = conn->in_len - used;
+        if (conn->until_eof) {
+            used += available;
+            conn->response_bytes += available;
+            break;
+        }
+        size_t take = available < conn->body_left ? available : conn->body_left;
+        used += take;
+        conn->response_bytes += take;
+        conn->body_left -= take;
+        if (conn->body_left > 0) break;
+        conn_response_done(thread, conn, now);
+    }
+
+    if (conn->fd < 0) return;
+    memmove(conn->in, conn->in + used, conn->in_len - used);
+    conn->in_len -= used;
+}
+
+// Read what the socket has
+static void conn_read(load_thread_t *thread, load_conn_t *conn, uint64_t now) {
+    for (;;) {
+        ssize_t n = recv(conn->fd, conn->in + conn->in_len, sizeof(conn->in) - conn->in_len, 0);
+        if (n > 0) {
+            conn->in_len += n;
+            conn_process_input(thread, conn, now);
+            if (conn->fd < 0) return;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+
+        // End of stream completes a body without Content-Length, anything else in flight is lost
+        if (n == 0 && conn->in_body && conn->until_eof) conn_response_done(thread, conn, now);
+        if (conn->fd >= 0) conn_close(thread, conn, &thread->errors_read);
+        return;
+    }
+}
+
+static void conn_handle_event(load_thread_t *thread, load_conn_t *conn, uint32_t events, uint64_t now) {
+    if (conn->fd < 0) return;
+    if (conn->connecting && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err != 0) {
+            // Count the failed connect once, or once per request that was waiting on it
+            thread->errors_connect += conn->inflight ? conn->inflight : 1;
+            conn->retry_at = now + LOAD_RECONNECT_DELAY_NS;
+            conn_close(thread, conn, NULL);
+            return;
+        }
+        conn->connecting = 0;
+    }
+    if (events & EPOLLOUT) conn_flush(thread, conn);
+    if (conn->fd >= 0 && (events & (EPOLLIN | EPOLLHUP | EPOLLERR))) conn_read(thread, conn, now);
+}
+
+// Next connection able to take a request (round robin), NULL if all are busy
+static load_conn_t* pick_connection(load_thread_t *thread, uint64_t now) {
+    int depth = options.close_mode ? 1 : options.pipeline;
+    for (int i = 0; i < thread->num_conns; i++) {
+        load_conn_t *conn = &thread->conns[thread->next_conn];
+        thread->next_conn = (thread->next_conn + 1) % thread->num_conns;
+
+        if (conn->fd < 0) {
+            if (conn->retry_at > now || conn_open(thread, conn, now) != 0) continue;
+            return conn;
+        }
+        if (!options.close_mode && conn->inflight < depth) return conn;
+    }
+    return NULL;
+}
+
+
+// ===== LOAD THREAD =====
+
+static void* load_thread_main(void *arg) {
+    load_thread_t *thread = arg;
+    struct epoll_event events[LOAD_MAX_EVENTS];
+    int use_pwait2 = 1;
+
+    // Keep-alive connections are opened before the clock starts
+    if (!options.close_mode) {
+        for (int i = 0; i < thread->num_conns; i++) conn_open(thread, &thread->conns[i], now_ns());
+    }
+
+    uint64_t deadline = thread->end_ns + (uint64_t)(options.drain * 1e9);
+    for (;;) {
+        uint64_t now = now_ns();
+
+        // Everything due by now is owed, whether or not a connection is free
+        while (thread->start_ns + thread->scheduled * thread->interval_ns <= now &&
+               thread->start_ns + thread->scheduled * thread->interval_ns < thread->end_ns) {
+            thread->scheduled++;
+        }
+        while (thread->dispatched < thread->scheduled) {
+            load_conn_t *conn = pick_connection(thread, now);
+            if (!conn) break;
+            conn_send(thread, conn, thread->start_ns + thread->dispatched * thread->interval_ns);
+            thread->dispatched++;
+        }
+
+        uint64_t next_due = thread->start_ns + thread->scheduled * thread->interval_ns;
+        int sending = next_due < thread->end_ns;
+        if (!sending && thread->dispatched == thread->scheduled && thread->inflight == 0) break;
+        if (now >= deadline) break;
+
+        // Sleep until the next request is due (or a reconnect can be tried)
+        uint64_t wait_ns = sending ? next_due - now : deadline - now;
+        if (thread->dispatched < thread->scheduled && wait_ns > LOAD_RECONNECT_DELAY_NS / 10) {
+            wait_ns = LOAD_RECONNECT_DELAY_NS / 10;
+        }
+        int n;
+        if (use_pwait2) {
+            struct timespec timeout = { .tv_sec = wait_ns / 1000000000ULL, .tv_nsec = wait_ns % 1000000000ULL };
+            n = epoll_pwait2(thread->epoll_fd, events, LOAD_MAX_EVENTS, &timeout, NULL);
+            if (n < 0 && errno == ENOSYS) {
+                use_pwait2 = 0;
+                continue;
+            }
+        } else {
+            n = epoll_wait(thread->epoll_fd, events, LOAD_MAX_EVENTS, (int)((wait_ns + 999999) / 1000000));
+        }
+        now = now_ns();
+        for (int i = 0; i < n; i++) {
+            conn_handle_event(thread, events[i].data.ptr, events[i].events, now);
+        }
+    }
+
+    // Requests never sent or never answered before the deadline
+    thread->timeouts += (thread->scheduled - thread->dispatched) + thread->inflight;
+    for (int i = 0; i < thread->num_conns; i++) conn_close(thread, &thread->conns[i], NULL);
+    return NULL;
+}
+
+
+// ===== REPORT =====
+
+static void print_report(load_thread_t *threads, double elapsed) {
+    histogram_t *total = calloc(1, sizeof(histogram_t));
+    if (!total) return;
+    uint64_t completed = 0, bytes = 0, connect = 0, read_errors = 0, write_errors = 0, status = 0, timeouts = 0;
+    for (int i = 0; i < options.threads; i++) {
+        hist_merge(total, &threads[i].hist);
+        completed += threads[i].completed;
+        bytes += threads[i].bytes;
+        connect += threads[i].errors_connect;
+        read_errors += threads[i].errors_read;
+        write_errors += threads[i].errors_write;
+        status += threads[i].errors_status;
+        timeouts += threads[i].timeouts;
+    }
+
+    printf("{\n");
+    if (options.corpus) {
+        printf("  \"target\": \"http://%s:%d\",\n", options.address, options.port);
+        printf("  \"corpus\": \"%s\",\n", options.corpus);
+        printf("  \"corpus_requests\": %d,\n", num_requests);
+    } else {
+        printf("  \"target\": \"http://%s:%d%s\",\n", options.address, options.port, options.path);
+    }
+    printf("  \"mode\": \"%s\",\n", options.close_mode ? "close" : "keep-alive");
+    printf("  \"pipeline\": %d,\n", options.close_mode ? 1 : options.pipeline);
+    printf("  \"threads\": %d,\n", options.threads);
+    printf("  \"connections\": %d,\n", options.connections);
+    printf("  \"rate\": %.1f,\n", options.rate);
+    printf("  \"duration_s\": %.3f,\n", elapsed);
+    printf("  \"warmup_s\": %.3f,\n", options.warmup);
+    printf("  \"requests\": %lu,\n", (unsigned long)completed);
+    printf("  \"throughput_rps\": %.1f,\n", elapsed > 0 ? completed / elapsed : 0.0);
+    printf("  \"bytes\": %lu,\n", (unsigned long)bytes);
+    printf("  \"errors\": { \"connect\": %lu, \"read\": %lu, \"write\": %lu, \"status\": %lu, \"timeout\": %lu },\n",
+           (unsigned long)connect, (unsigned long)read_errors, (unsigned long)write_errors,
+           (unsigned long)status, (unsigned long)timeouts);
+    printf("  \"latency_us\": {\n");
+    printf("    \"min\": %lu,\n", (unsigned long)(total->total ? total->min : 0));
+    printf("    \"mean\": %.1f,\n", total->total ? total->sum / total->total : 0.0);
+    const double percentiles[] = { 50, 75, 90, 99, 99.9, 99.99 };
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+        printf("    \"p%g\": %lu,\n", percentiles[i], (unsigned long)hist_percentile(total, percentiles[i]));
+    }
+    printf("    \"max\": %lu\n", (unsigned long)total->max);
+    printf("  }\n");
+    printf("}\n");
+    free(total);
+}
+
+// Add one request to the rotation (the text is kept, not copied)
+static int add_request(char *text, size_t len) {
+    if (num_requests == LOAD_MAX_CORPUS) {
+        fprintf(stderr, "Corpus has more than %d requests\n", LOAD_MAX_CORPUS);
+        return -1;
+    }
+    requests[num_requests] = text;
+    request_lens[num_requests] = len;
+    num_requests++;
+    if (len > max_request_len) max_request_len = len;
+    return 0;
+}
+
+// Load recorded requests: each is its request line and headers, one per line
+// (LF or CRLF), ended by a blank line; lines starting with '#' between requests
+// are comments. HEAD requests are not supported (their Content-Length has no body).
+static int load_corpus(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        return -1;
+    }
+
+    char line[LOAD_MAX_REQUEST];
+    char current[LOAD_MAX_REQUEST];
+    size_t len = 0;
+    int ret = 0;
+    int at_eof = 0;
+    while (ret == 0 && !at_eof) {
+        at_eof = fgets(line, sizeof(line), file) == NULL;
+        size_t n = at_eof ? 0 : strcspn(line, "\r\n");
+        if (!at_eof && len == 0 && line[0] == '#') continue;
+
+        if (n > 0) {
+            if (len + n + 2 > sizeof(current)) {
+                fprintf(stderr, "%s: request longer than %d bytes\n", path, LOAD_MAX_REQUEST);
+                ret = -1;
+                break;
+            }
+            memcpy(current + len, line, n);
+            memcpy(current + len + n, "\r\n", 2);
+            len += n + 2;
+            continue;
+        }
+        if (len == 0) continue;
+
+        // Blank line or end of file: the request is complete
+        const char *close_header = options.close_mode ? "Connection: close\r\n" : "";
+        size_t total = len + strlen(close_header) + 2;
+        char *text = malloc(total + 1);
+        if (!text) {
+            ret = -1;
+            break;
+        }
+        snprintf(text, total + 1, "%.*s%s\r\n", (int)len, current, close_header);
+        if (add_request(text, total) != 0) {
+            free(text);
+            ret = -1;
+        }
+        len = 0;
+    }
+    fclose(file);
+
+    if (ret == 0 && num_requests == 0) {
+        fprintf(stderr, "%s: no requests\n", path);
+        ret = -1;
+    }
+    return ret;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -a ADDRESS   server address (default 127.0.0.1)\n"
+            "  -p PORT      server port (default 8080)\n"
+            "  -t THREADS   load threads (default 1)\n"
+            "  -c CONNS     connections, split across threads (default 16)\n"
+            "  -r RATE      requests per second in total, constant (default 1000)\n"
+            "  -d SECONDS   measured duration (default 10)\n"
+            "  -w SECONDS   warm-up before measuring (default 0)\n"
+            "  -D SECONDS   wait for responses after the last send (default 2)\n"
+            "  -P DEPTH     pipelined requests per keep-alive connection (default 1)\n"
+            "  -C           new connection per request (Connection: close)\n"
+            "  -u PATH      request path (default /)\n"
+            "  -H HOST      Host header (default localhost)\n"
+            "  -f FILE      replay the recorded requests in FILE in turn instead of GET PATH\n",
+            program);
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+    while ((opt = getopt(argc, argv, "a:p:t:c:r:d:w:D:P:Cu:H:f:h")) != -1) {
+        switch (opt) {
+            case 'a': options.address = optarg; break;
+            case 'p': options.port = atoi(optarg); break;
+            case 't': options.threads = atoi(optarg); break;
+            case 'c': options.connections = atoi(optarg); break;
+            case 'r': options.rate = atof(optarg); break;
+            case 'd': options.duration = atof(optarg); break;
+            case 'w': options.warmup = atof(optarg); break;
+            case 'D': options.drain = atof(optarg); break;
+            case 'P': options.pipeline = atoi(optarg); break;
+            case 'C': options.close_mode = 1; break;
+            case 'u': options.path = optarg; break;
+            case 'H': options.host = optarg; break;
+            case 'f': options.corpus = optarg; break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (options.threads < 1 || options.connections < options.threads || options.rate <= 0 ||
+        options.duration <= 0 || options.warmup < 0 || options.drain < 0 ||
+        options.pipeline < 1 || options.pipeline > LOAD_MAX_PIPELINE) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(options.port);
+    if (inet_pton(AF_INET, options.address, &server_addr.sin_addr) != 1) {
+        fprintf(stderr, "Invalid address: %s\n", options.address);
+        return EXIT_FAILURE;
+    }
+
+    if (options.corpus) {
+        if (load_corpus(options.corpus) != 0) return EXIT_FAILURE;
+    } else {
+        int len = snprintf(request_text, sizeof(request_text), "GET %s HTTP/1.1\r\nHost: %s\r\n%s\r\n",
+                           options.path, options.host, options.close_mode ? "Connection: close\r\n" : "");
+        if (len < 0 || len >= (int)sizeof(request_text)) {
+            fprintf(stderr, "Request too long\n");
+            return EXIT_FAILURE;
+        }
+        add_request(request_text, len);
+    }
+
+    load_thread_t *threads = calloc(options.threads, sizeof(load_thread_t));
+    if (!threads) return EXIT_FAILURE;
+
+    // Threads share the schedule: each takes every threads-th slot of the global rate
+    uint64_t interval = (uint64_t)(1e9 / options.rate * options.threads);
+    uint64_t start = now_ns() + 100 * 1000000ULL;
+    uint64_t record_from = start + (uint64_t)(options.warmup * 1e9);
+    uint64_t end = record_from + (uint64_t)(options.duration * 1e9);
+    int ret = EXIT_SUCCESS;
+    int started = 0;
+
+    for (int i = 0; i < options.threads; i++) {
+        load_thread_t *thread = &threads[i];
+        thread->index = i;
+        thread->num_conns = options.connections / options.threads +
+                            (i < options.connections % options.threads ? 1 : 0);
+        thread->conns = calloc(thread->num_conns, sizeof(load_conn_t));
+        thread->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        thread->start_ns = start + interval * i / options.threads;
+        thread->interval_ns = interval;
+        thread->record_from_ns = record_from;
+        thread->end_ns = end;
+        if (!thread->conns || thread->epoll_fd < 0) {
+            perror("load thread");
+            ret = EXIT_FAILURE;
+            break;
+        }
+        for (int c = 0; c < thread->num_conns; c++) {
+            thread->conns[c].fd = -1;
+            thread->conns[c].out = malloc(max_request_len * LOAD_MAX_PIPELINE);
+            if (!thread->conns[c].out) ret = EXIT_FAILURE;
+        }
+        if (ret != EXIT_SUCCESS || pthread_create(&thread->thread, NULL, load_thread_main, thread) != 0) {
+            ret = EXIT_FAILURE;
+            break;
+        }
+        started++;
+    }
+
+    for (int i = 0; i < started; i++) pthread_join(threads[i].thread, NULL);
+    if (ret == EXIT_SUCCESS) print_report(threads, options.duration);
+
+    for (int i = 0; i < options.threads; i++) {
+        for (int c = 0; threads[i].conns && c < threads[i].num_conns; c++) free(threads[i].conns[c].out);
+        free(threads[i].conns);
+        if (threads[i].epoll_fd > 0) close(threads[i].epoll_fd);
+    }
+    free(threads);
+    for (int i = 0; i < num_requests; i++) {
+        if (requests[i] != request_text) free(requests[i]);
+    }
+    return ret;
+}
@@ -0,0 +1,49 @@
+#!/bin/bash
+# Teste de carga
+
+# arranca o servidor com a raiz www/ e corre o gerador de carga (tests/test_concurrent.c)
+# nos modos keep-alive, pipelining e uma conexão por pedido, a ritmo constante
+# imprime um objeto JSON com o resultado de cada cenário
+#
+#   tests/test_load.sh [pedidos/s] [segundos]
+#   PORT, WORKERS, THREADS e LOAD_THREADS mudam a configuração usada
+
+set -e
+cd "$(dirname "$0")/.."
+
+RATE=${1:-2000}
+DURATION=${2:-5}
+PORT=${PORT:-8099}
+
+make server load >/dev/null
+
+TMP=$(mktemp -d)
+cat > "$TMP/load.conf" <<CONF
+PORT=$PORT
+DOCUMENT_ROOT=$PWD/www
+NUM_WORKERS=${WORKERS:-2}
+THREADS_PER_WORKER=${THREADS:-8}
+LOG_FILE=$TMP/access.log
+LOG_LEVEL=warning
+CONF
+
+./server "$TMP/load.conf" > "$TMP/server.log" 2>&1 &
+SERVER_PID=$!
+trap 'kill $SERVER_PID 2>/dev/null; wait $SERVER_PID 2>/dev/null; rm -rf "$TMP"' EXIT
+sleep 0.5
+if ! kill -0 $SERVER_PID 2>/dev/null; then
+    cat "$TMP/server.log" >&2
+    exit 1
+fi
+
+SCENARIOS=("keep-alive:-c 32" "pipeline:-c 8 -P 8" "close:-c 32 -C")
+echo "{"
+for i in "${!SCENARIOS[@]}"; do
+    name=${SCENARIOS[$i]%%:*}
+    args=${SCENARIOS[$i]#*:}
+    printf '"%s": ' "$name"
+    # shellcheck disable=SC2086
+    ./test_concurrent -p "$PORT" -t "${LOAD_THREADS:-1}" -r "$RATE" -d "$DURATION" -w 1 $args
+    [ "$i" -lt $((${#SCENARIOS[@]} - 1)) ] && echo ","
+done
+echo "}"